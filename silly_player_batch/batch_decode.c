@@ -0,0 +1,118 @@
+//decode many files concurrently, one line per file on stdout
+//usage: silly_player_batch [-j workers] [-n max in-flight] [-l list file ('-': stdin)] [files...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "silly_player.h"
+
+typedef struct batch_summary {
+	long files;
+	long failed;
+	double media;
+	double decode_time;
+}batch_summary;
+
+static void on_result(void *userdata, const silly_batch_result *result)
+{
+	batch_summary *summary = (batch_summary *)userdata;
+
+	++summary->files;
+	if (result->status < 0) {
+		++summary->failed;
+		printf("%ld\tERROR(%d)\t%s\n", result->index, result->status, result->filename);
+		return;
+	}
+
+	summary->media += result->duration;
+	summary->decode_time += result->decode_time;
+	printf("%ld\t%.3f s\t%.1fx\t%s\n", result->index,
+		result->duration,
+		result->decode_time > 0.0 ? result->duration / result->decode_time : 0.0,
+		result->filename);
+}
+
+//one path per line, streamed: the list may be far larger than what's in flight
+static void submit_list(silly_batch_t *batch, const char *list)
+{
+	FILE *fp = strcmp(list, "-") == 0 ? stdin : fopen(list, "r");
+	char line[1024];
+	size_t len;
+
+	if (!fp) {
+		fprintf(stderr, "could not open list file: %s\n", list);
+		return;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		len = strlen(line);
+		while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+		if (len > 0)
+			silly_batch_submit(batch, line, NULL);
+	}
+
+	if (fp != stdin)
+		fclose(fp);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-j workers] [-n max in-flight] [-l list file ('-': stdin)] [files...]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+	silly_batch_params params;
+	batch_summary summary;
+	silly_batch_t *batch;
+	const char *list = NULL;
+	int i, first_file = argc;
+
+	memset(&params, 0, sizeof(params));
+	memset(&summary, 0, sizeof(summary));
+
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+			params.workers = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			params.max_inflight = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+			list = argv[++i];
+		} else if (argv[i][0] == '-' && argv[i][1] != 0) {
+			usage(argv[0]);
+			return 1;
+		} else {
+			first_file = i;
+			break;
+		}
+	}
+	if (!list && first_file >= argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	params.spec.channels = SA_CH_LAYOUT_STEREO;
+	params.spec.format = SA_SAMPLE_FMT_FLT;
+	params.spec.samplerate = 0;
+	params.spec.samples = 0;
+	params.on_result = on_result;
+	params.userdata = &summary;
+
+	batch = silly_batch_create(&params);
+	if (!batch) {
+		fprintf(stderr, "silly_batch_create() failed.\n");
+		return 1;
+	}
+
+	if (list)
+		submit_list(batch, list);
+	for (i = first_file; i < argc; ++i)
+		silly_batch_submit(batch, argv[i], NULL);
+
+	silly_batch_destroy(batch); //waits for everything submitted
+
+	fprintf(stderr, "%ld files, %ld failed, %.1f media-s decoded, %.1f s of decoding\n",
+		summary.files, summary.failed, summary.media, summary.decode_time);
+	return summary.failed ? 2 : 0;
+}
@@ -0,0 +1,112 @@
+//playback clock jitter harness: how smoothly does silly_player_time() advance while a device plays?
+//usage: bench_clock [audio file] [seconds] [tempo]   (default: res/choosing_48000_mono.mp3 10 1.0)
+//
+//the clock is sampled about every millisecond from this thread and fitted to a line against the wall
+//clock. 'slope' should be the tempo, 'jitter' is the distance to the line (RMS / worst), 'steps' the
+//largest advance between two samples beyond what the wall clock explains. a stepping clock (one value
+//per device callback) shows a worst jitter of half a callback; backward steps should never happen.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavutil/log.h>
+
+#include "c99defs.h"
+#include "silly_player.h"
+#include "util/platform.h"
+
+#define DEFAULT_SECONDS 10
+#define SETTLE_MS 500 //the start (device & ring filling up) isn't measured
+
+typedef struct clock_sample {
+	double wall;
+	double clock;
+}clock_sample;
+
+int main(int argc, char *argv[])
+{
+	const char *filename = argc > 1 ? argv[1] : "res/choosing_48000_mono.mp3";
+	int seconds = argc > 2 ? atoi(argv[2]) : DEFAULT_SECONDS;
+	float tempo = argc > 3 ? (float)atof(argv[3]) : 1.0f;
+	silly_player_t *player;
+	silly_audiospec desired, obtained;
+	clock_sample *samples;
+	int capacity = seconds * 2000, count = 0, backward = 0, i;
+	double sw = 0.0, sc = 0.0, sww = 0.0, swc = 0.0, slope, offset;
+	double rms = 0.0, worst = 0.0, step = 0.0, d;
+	uint64_t start, end;
+
+	SDL_SetMainReady();
+	av_log_set_level(AV_LOG_QUIET);
+
+	if (seconds <= 0 || tempo <= 0.0f) {
+		fprintf(stderr, "usage: %s [audio file] [seconds] [tempo]\n", argv[0]);
+		return 1;
+	}
+
+	samples = malloc(sizeof(clock_sample) * capacity);
+	player = silly_player_create();
+	if (!samples || !player) return 1;
+
+	desired.channels = SA_CH_LAYOUT_STEREO;
+	desired.format = SA_SAMPLE_FMT_S16;
+	desired.samplerate = 0;
+	desired.samples = 1024;
+	silly_player_set_tempo(player, tempo);
+	if (silly_player_open(player, filename, &desired, &obtained, false) != 0) {
+		fprintf(stderr, "%s: could not open.\n", filename);
+		silly_player_destroy(player);
+		free(samples);
+		return 1;
+	}
+
+	os_sleep_ms(SETTLE_MS);
+	start = os_gettime_ns();
+	end = start + (uint64_t)seconds * 1000000000;
+	while (count < capacity && os_gettime_ns() < end) {
+		samples[count].clock = silly_player_time(player);
+		samples[count].wall = (double)(os_gettime_ns() - start) / 1000000000.0;
+		++count;
+		os_sleep_ms(1);
+	}
+	silly_player_destroy(player);
+
+	if (count < 2) {
+		fprintf(stderr, "no samples.\n");
+		free(samples);
+		return 1;
+	}
+
+	//least squares line clock = offset + slope * wall
+	for (i = 0; i < count; ++i) {
+		sw += samples[i].wall;
+		sc += samples[i].clock;
+		sww += samples[i].wall * samples[i].wall;
+		swc += samples[i].wall * samples[i].clock;
+	}
+	slope = (count * swc - sw * sc) / (count * sww - sw * sw);
+	offset = (sc - slope * sw) / count;
+
+	for (i = 0; i < count; ++i) {
+		d = samples[i].clock - (offset + slope * samples[i].wall);
+		rms += d * d;
+		worst = max(worst, fabs(d));
+		if (i > 0) {
+			d = (samples[i].clock - samples[i - 1].clock) - slope * (samples[i].wall - samples[i - 1].wall);
+			step = max(step, d);
+			if (samples[i].clock < samples[i - 1].clock)
+				++backward;
+		}
+	}
+	rms = sqrt(rms / count);
+
+	printf("%s: %d Hz, %d frames per callback (%.1f ms), tempo %.2f\n", filename, obtained.samplerate,
+		obtained.samples, obtained.samplerate ? 1000.0 * obtained.samples / obtained.samplerate : 0.0, tempo);
+	printf("%d samples over %.2f s: slope %.4f  jitter %.3f ms RMS / %.3f ms worst  largest step %.3f ms  %d backward\n",
+		count, samples[count - 1].wall, slope, rms * 1000.0, worst * 1000.0, step * 1000.0, backward);
+
+	free(samples);
+	return 0;
+}
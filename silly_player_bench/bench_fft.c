@@ -0,0 +1,99 @@
+//FFT benchmark: the windowed real FFT of the spectrum analyzer (fft.c) at sizes 512 .. 8192, scalar/SSE2/AVX2
+//usage: bench_fft [milliseconds per case]   (default: 200)
+//
+//the input is synthetic (a few sines & noise), the transform doesn't care. 'max diff' is the largest
+//magnitude difference to the scalar kernels, relative to the size. 'load' is what a 60 spectra/s
+//analyzer costs one core at that size.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+
+#include "c99defs.h"
+#include "fft.h"
+#include "util/platform.h"
+
+#define DEFAULT_MS 200
+#define SPECTRA_PER_SECOND 60
+
+static void make_input(float *x, int size)
+{
+	int i;
+
+	srand(1);
+	for (i = 0; i < size; ++i)
+		x[i] = 0.5f * sinf(i * 0.0731f) + 0.25f * sinf(i * 0.9113f + 1.0f) + 0.1f * ((float)rand() / RAND_MAX - 0.5f);
+}
+
+//transforms of 'size' in 'ms', return ns per transform
+static double bench_size(const SampleKernels *kernels, int size, int ms, const float *x, float *power)
+{
+	RealFFT fft;
+	uint64_t start, ns, until;
+	long count = 0;
+
+	fft_init(&fft, size);
+	fft.kernels = kernels;
+	fft_power(&fft, x, power); //warm up
+
+	start = os_gettime_ns();
+	until = start + (uint64_t)ms * 1000000;
+	do {
+		int i;
+		for (i = 0; i < 16; ++i)
+			fft_power(&fft, x, power);
+		count += 16;
+	} while ((ns = os_gettime_ns()) < until);
+
+	fft_free(&fft);
+	return (double)(ns - start) / count;
+}
+
+int main(int argc, char *argv[])
+{
+	int ms = argc > 1 ? atoi(argv[1]) : DEFAULT_MS;
+	float *x = malloc(sizeof(float) * FFT_SIZE_MAX);
+	float *ref = malloc(sizeof(float) * (FFT_SIZE_MAX / 2 + 1));
+	float *power = malloc(sizeof(float) * (FFT_SIZE_MAX / 2 + 1));
+	int size, cpu, k;
+
+	SDL_SetMainReady();
+
+	if (ms <= 0 || !x || !ref || !power) {
+		fprintf(stderr, "usage: %s [milliseconds per case]\n", argv[0]);
+		return 1;
+	}
+
+	make_input(x, FFT_SIZE_MAX);
+	printf("real FFT + Hann window + power, best kernels: %s\n", sample_kernels()->name);
+	for (size = FFT_SIZE_MIN; size <= FFT_SIZE_MAX; size *= 2) {
+		RealFFT fft;
+
+		fft_init(&fft, size);
+		fft.kernels = sample_kernels_for(SAMPLE_CPU_SCALAR);
+		fft_power(&fft, x, ref);
+		fft_free(&fft);
+
+		for (cpu = SAMPLE_CPU_SCALAR; cpu < SAMPLE_CPU_COUNT; ++cpu) {
+			const SampleKernels *kernels = sample_kernels_for(cpu);
+			double ns, diff = 0.0;
+
+			if (!kernels)
+				continue;
+
+			ns = bench_size(kernels, size, ms, x, power);
+			for (k = 0; k <= size / 2; ++k)
+				diff = max(diff, fabs(sqrt(power[k]) - sqrt(ref[k])) / size);
+
+			printf("%5d  %-7s %9.2f us  %8.0f transforms/s  %6.2f ns/point  load %6.3f%% of a core  max diff %.1e\n",
+				size, kernels->name, ns / 1e3, 1e9 / ns, ns / size, ns * SPECTRA_PER_SECOND / 1e9 * 100.0, diff);
+		}
+	}
+
+	free(x);
+	free(ref);
+	free(power);
+	return 0;
+}
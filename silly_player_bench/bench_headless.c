@@ -0,0 +1,122 @@
+//headless decode benchmark: parse -> decode -> swr as fast as the CPU allows
+//usage: bench_headless [directory or files...]   (default: res)
+//
+//for every file the media duration is divided by the wall time needed to decode it,
+//which gives the speed-up factor over real-time playback.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavutil/log.h>
+
+#include "c99defs.h"
+#include "silly_player.h"
+#include "util/dstr.h"
+#include "util/platform.h"
+
+typedef struct decode_stats {
+	int64_t bytes;
+	int frames;
+}decode_stats;
+
+static int count_pcm(void *userdata, const uint8_t *pcm, int size)
+{
+	decode_stats *stats = (decode_stats *)userdata;
+
+	UNUSED_PARAMETER(pcm);
+	stats->bytes += size;
+	++stats->frames;
+	return 0;
+}
+
+static void bench_file(silly_player_t *player, const char *filename)
+{
+	silly_audiospec desired, obtained;
+	decode_stats stats = { 0, 0 };
+	uint64_t start;
+	double wall, media;
+	int bytes_per_second, ret;
+
+	desired.channels = SA_CH_LAYOUT_STEREO;
+	desired.format = SA_SAMPLE_FMT_S16;
+	desired.samplerate = 0;
+	desired.samples = 1024;
+
+	start = os_gettime_ns();
+	if (silly_player_open_headless(player, filename, &desired, &obtained) != 0) {
+		fprintf(stderr, "%s: could not open.\n", filename);
+		return;
+	}
+	ret = silly_player_decode(player, count_pcm, &stats);
+	silly_player_close(player);
+	wall = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+	bytes_per_second = obtained.samplerate
+		* SA_CH_LAYOUT_CHANNELS(obtained.channels)
+		* (obtained.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+	media = bytes_per_second > 0 ? (double)stats.bytes / bytes_per_second : 0.0;
+
+	printf("%8.2f media-s  %7.3f wall-s  %8.1f x real time  %7d frames  %s%s\n",
+		media, wall,
+		wall > 0.0 ? media / wall : 0.0,
+		stats.frames,
+		filename,
+		ret < 0 ? "  (ERROR)" : "");
+}
+
+static bool is_media_file(const char *name)
+{
+	const char *ext = strrchr(name, '.');
+
+	return ext && (astrcmpi(ext, ".mp3") == 0 || astrcmpi(ext, ".mp4") == 0
+		|| astrcmpi(ext, ".m4a") == 0 || astrcmpi(ext, ".wav") == 0);
+}
+
+static void bench_path(silly_player_t *player, const char *path)
+{
+	struct dstr filename = { 0 };
+	struct os_dirent *ent;
+	os_dir_t *dir;
+
+	dir = os_opendir(path);
+	if (!dir) { //a file
+		bench_file(player, path);
+		return;
+	}
+
+	//a directory: every media file in it
+	while ((ent = os_readdir(dir)) != NULL) {
+		if (ent->directory || !is_media_file(ent->d_name))
+			continue;
+
+		dstr_printf(&filename, "%s/%s", path, ent->d_name);
+		bench_file(player, filename.array);
+	}
+	os_closedir(dir);
+	dstr_free(&filename);
+}
+
+int main(int argc, char *argv[])
+{
+	silly_player_t *player;
+	int i;
+
+	SDL_SetMainReady();
+	av_log_set_level(AV_LOG_QUIET);
+
+	player = silly_player_create();
+	if (!player) {
+		fprintf(stderr, "silly_player_create() failed.\n");
+		return 1;
+	}
+
+	if (argc < 2)
+		bench_path(player, "res");
+	for (i = 1; i < argc; ++i)
+		bench_path(player, argv[i]);
+
+	silly_player_destroy(player);
+	return 0;
+}
@@ -0,0 +1,100 @@
+//multi-instance scaling benchmark: N players decoding side by side in one process
+//usage: bench_instances <audio file> [max instances] [seconds per run]
+//
+//every run doubles the number of players (1, 2, 4, ... max). each device is paced in
+//real time, so a healthy run reports a real-time factor of ~1.0 per instance; the CPU
+//column shows what the extra instances cost.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavutil/log.h>
+
+#include "c99defs.h"
+#include "silly_player.h"
+#include "util/platform.h"
+
+#define DEFAULT_MAX_INSTANCES 16
+#define DEFAULT_SECONDS 5
+
+static void bench_run(const char *filename, int instances, int seconds)
+{
+	silly_player_t **players;
+	silly_audiospec desired, obtained;
+	os_cpu_usage_info_t *cpu;
+	uint64_t start;
+	double wall, media = 0.0, usage;
+	int i, opened = 0;
+
+	players = calloc(instances, sizeof(silly_player_t *));
+	if (!players) return;
+
+	desired.channels = SA_CH_LAYOUT_STEREO;
+	desired.format = SA_SAMPLE_FMT_S16;
+	desired.samplerate = 0;
+	desired.samples = 1024;
+
+	for (i = 0; i < instances; ++i) {
+		players[i] = silly_player_create();
+		if (!players[i]) {
+			fprintf(stderr, "silly_player_create() failed for instance %d.\n", i);
+			break;
+		}
+		if (silly_player_open(players[i], filename, &desired, &obtained, true) != 0) {
+			fprintf(stderr, "silly_player_open() failed for instance %d.\n", i);
+			silly_player_destroy(players[i]);
+			players[i] = NULL;
+			break;
+		}
+		++opened;
+	}
+
+	cpu = os_cpu_usage_info_start();
+	start = os_gettime_ns();
+	os_sleep_ms(seconds * 1000);
+	wall = (double)(os_gettime_ns() - start) / 1000000000.0;
+	usage = os_cpu_usage_info_query(cpu);
+	os_cpu_usage_info_destroy(cpu);
+
+	for (i = 0; i < opened; ++i) {
+		double t = silly_player_time(players[i]);
+		if (t > 0.0) media += t;
+	}
+
+	printf("%4d instances  %8.2f media-s  %6.2f wall-s  %8.2f media-s/s  %5.2f x real time/instance  %6.1f%% cpu\n",
+		opened, media, wall,
+		media / wall,
+		opened ? media / wall / opened : 0.0,
+		usage);
+
+	for (i = 0; i < opened; ++i)
+		silly_player_destroy(players[i]);
+	free(players);
+}
+
+int main(int argc, char *argv[])
+{
+	int max_instances = DEFAULT_MAX_INSTANCES;
+	int seconds = DEFAULT_SECONDS;
+	int n;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <audio file> [max instances] [seconds per run]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2) max_instances = atoi(argv[2]);
+	if (argc > 3) seconds = atoi(argv[3]);
+	if (max_instances <= 0) max_instances = DEFAULT_MAX_INSTANCES;
+	if (seconds <= 0) seconds = DEFAULT_SECONDS;
+
+	SDL_SetMainReady();
+	//no sound card needed (and no noise), override with SDL_AUDIODRIVER
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	av_log_set_level(AV_LOG_QUIET);
+
+	for (n = 1; n <= max_instances; n *= 2)
+		bench_run(argv[1], n, seconds);
+
+	return 0;
+}
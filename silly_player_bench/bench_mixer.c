@@ -0,0 +1,105 @@
+//mixer benchmark: cost of the device callback for 1, 2, 4 ... N voices on one silly_mixer
+//usage: bench_mixer <audio file> [max voices] [seconds per run]
+//
+//voices decode on their own threads, the callback only copies, scales, pans & sums them.
+//the budget is one device buffer (~5 ms: 256 frames @ 48 kHz), a callback taking longer glitches.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavutil/log.h>
+
+#include "c99defs.h"
+#include "sample_conv.h"
+#include "silly_player.h"
+#include "util/platform.h"
+
+#define DEFAULT_MAX_VOICES 128
+#define DEFAULT_SECONDS 3
+#define BUFFER_FRAMES 256
+
+static void bench_run(silly_mixer_t *mixer, const char *filename, int voices, int seconds)
+{
+	silly_player_t **players;
+	silly_mixerstats stats;
+	int i, opened = 0;
+
+	players = calloc(voices, sizeof(silly_player_t *));
+	if (!players) return;
+
+	for (i = 0; i < voices; ++i) {
+		players[i] = silly_player_create();
+		if (!players[i]) {
+			fprintf(stderr, "silly_player_create() failed for voice %d.\n", i);
+			break;
+		}
+		if (silly_player_open_voice(players[i], mixer, filename, true) != 0) {
+			fprintf(stderr, "silly_player_open_voice() failed for voice %d.\n", i);
+			silly_player_destroy(players[i]);
+			players[i] = NULL;
+			break;
+		}
+		silly_player_set_volume(players[i], 1.0f / voices);
+		silly_player_set_pan(players[i], voices > 1 ? -1.0f + 2.0f * i / (voices - 1) : 0.0f);
+		++opened;
+	}
+
+	//skip the start (rings filling up), then measure
+	os_sleep_ms(500);
+	silly_mixer_stats(mixer, &stats);
+	os_sleep_ms(seconds * 1000);
+	silly_mixer_stats(mixer, &stats);
+
+	printf("%4d voices  %6ld callbacks  avg %7.3f ms  max %7.3f ms  %6.2f us/voice  %5.1f%% of %.2f ms budget\n",
+		opened, stats.callbacks, stats.callback_avg_ms, stats.callback_max_ms,
+		opened ? stats.callback_avg_ms * 1000.0 / opened : 0.0,
+		stats.buffer_ms > 0.0 ? 100.0 * stats.callback_max_ms / stats.buffer_ms : 0.0,
+		stats.buffer_ms);
+
+	for (i = 0; i < opened; ++i)
+		silly_player_destroy(players[i]);
+	free(players);
+}
+
+int main(int argc, char *argv[])
+{
+	silly_mixer_t *mixer;
+	silly_audiospec desired, obtained;
+	int max_voices = DEFAULT_MAX_VOICES;
+	int seconds = DEFAULT_SECONDS;
+	int n;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <audio file> [max voices] [seconds per run]\n", argv[0]);
+		return 1;
+	}
+	if (argc > 2) max_voices = atoi(argv[2]);
+	if (argc > 3) seconds = atoi(argv[3]);
+	if (max_voices <= 0) max_voices = DEFAULT_MAX_VOICES;
+	if (seconds <= 0) seconds = DEFAULT_SECONDS;
+
+	SDL_SetMainReady();
+	//no sound card needed (and no noise), override with SDL_AUDIODRIVER
+	SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+	av_log_set_level(AV_LOG_QUIET);
+
+	desired.channels = SA_CH_LAYOUT_STEREO;
+	desired.format = SA_SAMPLE_FMT_FLT;
+	desired.samplerate = 48000;
+	desired.samples = BUFFER_FRAMES;
+
+	mixer = silly_mixer_create(&desired, &obtained);
+	if (!mixer) {
+		fprintf(stderr, "silly_mixer_create() failed.\n");
+		return 1;
+	}
+
+	printf("%s: %d Hz, %d frames a callback, kernels: %s\n",
+		argv[1], obtained.samplerate, obtained.samples, sample_kernels()->name);
+	for (n = 1; n <= max_voices; n *= 2)
+		bench_run(mixer, argv[1], n, seconds);
+
+	silly_mixer_destroy(mixer);
+	return 0;
+}
@@ -0,0 +1,230 @@
+//packet queue micro benchmark: SPSC ring (packet_queue.c) vs. the old AVPacketList queue
+//usage: bench_packet_queue [packets]
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+
+#include "c99defs.h"
+#include "packet_queue.h"
+
+#define DEFAULT_PACKETS 2000000
+#define PAYLOAD_SIZE 512	//about one compressed audio packet
+
+/** ************** the AVPacketList queue the ring replaced ************** */
+typedef struct ListQueue{
+	AVPacketList *first_pkt, *last_pkt;
+	int nb_packets;
+	int size;
+	long nb_allocs;		//AVPacketList nodes & payload copies (written by the producer only)
+	SDL_mutex *mutex;
+	SDL_cond *cond;
+}ListQueue;
+
+static void list_queue_init(ListQueue *q)
+{
+	memset(q, 0, sizeof(ListQueue));
+	q->mutex = SDL_CreateMutex();
+	q->cond = SDL_CreateCond();
+}
+
+static void list_queue_destroy(ListQueue *q)
+{
+	SDL_DestroyCond(q->cond);
+	SDL_DestroyMutex(q->mutex);
+}
+
+static int list_queue_put(ListQueue *q, AVPacket *pkt)
+{
+	AVPacketList *pktList;
+	uint8_t *data = pkt->data;
+	if (av_dup_packet(pkt) != 0)
+		return -1;
+	if (pkt->data != data)
+		++q->nb_allocs;
+
+	pktList = av_malloc(sizeof(AVPacketList));
+	if (!pktList) return -1;
+	++q->nb_allocs;
+	pktList->pkt = *pkt;
+	pktList->next = NULL;
+
+	SDL_LockMutex(q->mutex);
+	if (!q->last_pkt) q->first_pkt = pktList;
+	else q->last_pkt->next = pktList;
+	q->last_pkt = pktList;
+	q->nb_packets++;
+	q->size += pktList->pkt.size;
+	SDL_CondSignal(q->cond);
+	SDL_UnlockMutex(q->mutex);
+	return 0;
+}
+
+static int list_queue_get(ListQueue *q, AVPacket *pkt)
+{
+	AVPacketList *pktList;
+
+	SDL_LockMutex(q->mutex);
+	while (!(pktList = q->first_pkt))
+		SDL_CondWait(q->cond, q->mutex);
+
+	q->first_pkt = pktList->next;
+	if (!q->first_pkt)
+		q->last_pkt = NULL;
+	q->nb_packets--;
+	q->size -= pktList->pkt.size;
+	*pkt = pktList->pkt;
+	av_free(pktList);
+	SDL_UnlockMutex(q->mutex);
+	return 1;
+}
+
+/** ************** producer threads ************** */
+static int nb_packets = DEFAULT_PACKETS;
+
+//a refcounted packet like the demuxer's, its payload starts with its own buffer & data pointers
+//so the consumer can tell it got the very same buffer back (moved by reference, not copied).
+//the payload is allocated in the producer for both queues alike, it's not counted as a queue allocation
+//(out of memory: a blank packet, counted as an error by check_packet())
+static void make_packet(AVPacket *pkt, int i)
+{
+	if (av_new_packet(pkt, PAYLOAD_SIZE) == 0) {
+		memcpy(pkt->data, &pkt->buf, sizeof(pkt->buf));
+		memcpy(pkt->data + sizeof(pkt->buf), &pkt->data, sizeof(pkt->data));
+	} else {
+		av_init_packet(pkt);
+		pkt->data = NULL;
+		pkt->size = 0;
+	}
+	pkt->pts = i;
+}
+
+//return 0 if 'pkt' is packet 'i' with the buffer & data it was put with
+static int check_packet(AVPacket *pkt, int i)
+{
+	AVBufferRef *buf;
+	uint8_t *data;
+
+	if (pkt->pts != i || !pkt->data || pkt->size < PAYLOAD_SIZE)
+		return -1;
+	memcpy(&buf, pkt->data, sizeof(buf));
+	memcpy(&data, pkt->data + sizeof(buf), sizeof(data));
+	return buf == pkt->buf && data == pkt->data ? 0 : -1;
+}
+
+static int ring_producer(void *arg)
+{
+	PacketQueue *q = (PacketQueue *)arg;
+	AVPacket pkt;
+	int i;
+
+	for (i = 0; i < nb_packets; ++i) {
+		make_packet(&pkt, i);
+		packet_queue_put(q, &pkt);
+	}
+	return 0;
+}
+
+static int list_producer(void *arg)
+{
+	ListQueue *q = (ListQueue *)arg;
+	AVPacket pkt;
+	int i;
+
+	for (i = 0; i < nb_packets; ++i) {
+		make_packet(&pkt, i);
+		list_queue_put(q, &pkt);
+	}
+	return 0;
+}
+
+/** ************** runs ************** */
+static double seconds_since(Uint64 start)
+{
+	return (double)(SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency();
+}
+
+//allocs: what the queue itself allocated (nodes, copied payloads), nothing of the producer's packets
+static void report(const char *name, double sec, long allocs, int errors)
+{
+	printf("%-8s %10d packets  %8.3f s  %8.1f ns/packet  %8.2f Mpackets/s  %8ld allocs  %s\n",
+		name, nb_packets, sec,
+		sec * 1e9 / nb_packets,
+		nb_packets / sec / 1e6,
+		allocs,
+		errors ? "OUT OF ORDER / COPIED" : "ok, moved by reference");
+}
+
+static void bench_ring()
+{
+	PacketQueue q;
+	SDL_Thread *producer;
+	AVPacket pkt;
+	Uint64 start;
+	long allocs;
+	int i, errors = 0;
+
+	if (packet_queue_init(&q) != 0) {
+		fprintf(stderr, "packet_queue_init() failed.\n");
+		return;
+	}
+
+	allocs = bnum_total_allocs();
+	start = SDL_GetPerformanceCounter();
+	producer = SDL_CreateThread(ring_producer, "RING_PRODUCER", &q);
+	for (i = 0; i < nb_packets; ++i) {
+		packet_queue_get(&q, &pkt, 1, NULL);
+		if (check_packet(&pkt, i) != 0) ++errors;
+		av_packet_unref(&pkt);
+	}
+	SDL_WaitThread(producer, NULL);
+	//bmalloc'd shells & payloads copied with av_packet_ref()
+	report("ring", seconds_since(start), bnum_total_allocs() - allocs + q.nb_copied, errors);
+
+	packet_queue_destroy(&q);
+}
+
+static void bench_list()
+{
+	ListQueue q;
+	SDL_Thread *producer;
+	AVPacket pkt;
+	Uint64 start;
+	int i, errors = 0;
+
+	list_queue_init(&q);
+
+	start = SDL_GetPerformanceCounter();
+	producer = SDL_CreateThread(list_producer, "LIST_PRODUCER", &q);
+	for (i = 0; i < nb_packets; ++i) {
+		list_queue_get(&q, &pkt);
+		if (check_packet(&pkt, i) != 0) ++errors;
+		av_packet_unref(&pkt);
+	}
+	SDL_WaitThread(producer, NULL);
+	report("list", seconds_since(start), q.nb_allocs, errors);
+
+	list_queue_destroy(&q);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1)
+		nb_packets = atoi(argv[1]);
+	if (nb_packets <= 0)
+		nb_packets = DEFAULT_PACKETS;
+
+	SDL_SetMainReady();
+	if (SDL_Init(0) != 0) {
+		fprintf(stderr, "SDL_Init() error: %s\n", SDL_GetError());
+		return 1;
+	}
+
+	printf("ring capacity: %d slots\n", PACKET_QUEUE_CAPACITY);
+	bench_list();
+	bench_ring();
+
+	SDL_Quit();
+	return 0;
+}
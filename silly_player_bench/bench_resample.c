@@ -0,0 +1,159 @@
+//resampler benchmark: cost & quality of the tiers of silly_player_set_resampler() (resample.c)
+//usage: bench_resample [seconds]   (default: 10)
+//
+//a stereo float sine is resampled in chunks of one mp3 frame like the decoder does, for a few rate pairs
+//& tones (1 kHz, and 15 kHz close to the band edge where short filters alias). 'ns/sample' is per
+//output frame, THD+N is everything but the tone: the tone (amplitude & phase, so the filter delay doesn't
+//matter) is fitted by least squares to the output, the rest is distortion, noise & aliasing.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/log.h>
+
+#include "c99defs.h"
+#include "resample.h"
+#include "silly_player_params.h"
+#include "util/bmem.h"
+#include "util/platform.h"
+
+#define DEFAULT_SECONDS 10
+#define CHUNK_FRAMES 1152
+#define AMPLITUDE 0.89f		//-1 dBFS
+#define EDGE_MS 50			//the start & the end (filter ramps) are left out of THD+N
+#define BENCH_PI 3.14159265358979
+
+typedef struct rate_case {
+	int in_rate;
+	int out_rate;
+	double tone;
+}rate_case;
+
+static const rate_case cases[] = {
+	{ 44100, 48000, 1000.0 },
+	{ 44100, 48000, 15000.0 },
+	{ 48000, 44100, 1000.0 },
+	{ 48000, 44100, 15000.0 },
+	{ 48000, 16000, 1000.0 },
+};
+
+static const struct {
+	int quality;
+	const char *name;
+} tiers[] = {
+	{ SA_RESAMPLE_FAST, "fast" },
+	{ SA_RESAMPLE_DEFAULT, "default" },
+	{ SA_RESAMPLE_HIGH, "high" },
+	{ SA_RESAMPLE_SPEEX, "speex" },
+};
+
+//THD+N of the left channel of 'frames' frames at 'rate' holding a tone of 'tone' Hz, in dB
+static double thd_n(const float *pcm, int frames, int rate, double tone)
+{
+	int from = rate * EDGE_MS / 1000, to = frames - from;
+	double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+	double a, b, det, signal = 0.0, residual = 0.0;
+	int i;
+
+	if (to - from < rate / 10)
+		return 0.0;
+
+	//y ~ a sin + b cos: the normal equations
+	for (i = from; i < to; ++i) {
+		double w = 2.0 * BENCH_PI * tone * i / rate;
+		double s = sin(w), c = cos(w), y = pcm[2 * i];
+		ss += s * s; cc += c * c; sc += s * c;
+		ys += y * s; yc += y * c;
+	}
+	det = ss * cc - sc * sc;
+	a = (ys * cc - yc * sc) / det;
+	b = (yc * ss - ys * sc) / det;
+
+	for (i = from; i < to; ++i) {
+		double w = 2.0 * BENCH_PI * tone * i / rate;
+		double fit = a * sin(w) + b * cos(w);
+		double r = pcm[2 * i] - fit;
+		signal += fit * fit;
+		residual += r * r;
+	}
+	return residual > 0.0 ? 10.0 * log10(residual / signal) : -200.0;
+}
+
+static void bench_tier(int quality, const char *name, const rate_case *c, const float *in, int in_frames)
+{
+	int capacity = (int)((int64_t)in_frames * c->out_rate / c->in_rate) + CHUNK_FRAMES * 4;
+	float *out = bmalloc(sizeof(float) * 2 * capacity);
+	Resampler *r;
+	uint64_t start, ns;
+	int i, n, got, out_frames = 0;
+
+	r = resampler_open(quality,
+		AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, c->out_rate,
+		AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, c->in_rate);
+	if (!r) {
+		printf("  %-8s (could not open)\n", name);
+		bfree(out);
+		return;
+	}
+
+	start = os_gettime_ns();
+	for (i = 0; i < in_frames; i += n) {
+		const uint8_t *src = (const uint8_t *)(in + (size_t)i * 2);
+		uint8_t *dst = (uint8_t *)(out + (size_t)out_frames * 2);
+
+		n = min(CHUNK_FRAMES, in_frames - i);
+		got = resampler_convert(r, &dst, capacity - out_frames, &src, n);
+		if (got < 0)
+			break;
+		out_frames += got;
+	}
+	while (out_frames < capacity) {
+		uint8_t *dst = (uint8_t *)(out + (size_t)out_frames * 2);
+		if ((got = resampler_convert(r, &dst, capacity - out_frames, NULL, 0)) <= 0)
+			break;
+		out_frames += got;
+	}
+	ns = os_gettime_ns() - start;
+
+	printf("  %-8s %6.2f ns/sample  THD+N %7.1f dB  (%d frames out)\n", name,
+		out_frames ? (double)ns / out_frames : 0.0, thd_n(out, out_frames, c->out_rate, c->tone), out_frames);
+
+	resampler_free(&r);
+	bfree(out);
+}
+
+int main(int argc, char *argv[])
+{
+	int seconds = argc > 1 ? atoi(argv[1]) : DEFAULT_SECONDS;
+	size_t i, t;
+
+	SDL_SetMainReady();
+	av_log_set_level(AV_LOG_QUIET);
+
+	if (seconds <= 0) {
+		fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+		const rate_case *c = &cases[i];
+		int frames = c->in_rate * seconds;
+		float *in = bmalloc(sizeof(float) * 2 * frames);
+		int k;
+
+		for (k = 0; k < frames; ++k) {
+			float v = AMPLITUDE * (float)sin(2.0 * BENCH_PI * c->tone * k / c->in_rate);
+			in[2 * k] = v;
+			in[2 * k + 1] = v;
+		}
+
+		printf("%d -> %d Hz, %.0f Hz tone, %d s:\n", c->in_rate, c->out_rate, c->tone, seconds);
+		for (t = 0; t < sizeof(tiers) / sizeof(tiers[0]); ++t)
+			bench_tier(tiers[t].quality, tiers[t].name, c, in, frames);
+		bfree(in);
+	}
+	return 0;
+}
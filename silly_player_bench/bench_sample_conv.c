@@ -0,0 +1,292 @@
+//sample format conversion benchmark: swr_convert() vs. the kernels of sample_conv.c (scalar/SSE2/AVX2)
+//usage: bench_sample_conv [files...]   (default: res/choosing_44100_mono.mp3 res/choosing_48000_mono.mp3)
+//
+//every file is decoded once, the (mono) signal feeds every channel of the stereo & surround cases.
+//conversions run in chunks of one mp3 frame like the decoder does, 'max diff' is against swr.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/log.h>
+#include <libswresample/swresample.h>
+
+#include "c99defs.h"
+#include "sample_conv.h"
+#include "util/darray.h"
+#include "util/platform.h"
+
+#define CHUNK_FRAMES 1152
+#define REPEAT 20
+
+typedef struct conv_case {
+	const char *name;
+	enum AVSampleFormat in_fmt;
+	int64_t in_layout;
+	enum AVSampleFormat out_fmt;
+	int64_t out_layout;
+}conv_case;
+
+#define MONO AV_CH_LAYOUT_MONO
+#define STEREO AV_CH_LAYOUT_STEREO
+
+static const conv_case cases[] = {
+	{ "fltp->flt stereo", AV_SAMPLE_FMT_FLTP, STEREO, AV_SAMPLE_FMT_FLT, STEREO },
+	{ "flt->fltp stereo", AV_SAMPLE_FMT_FLT, STEREO, AV_SAMPLE_FMT_FLTP, STEREO },
+	{ "s16->flt stereo", AV_SAMPLE_FMT_S16, STEREO, AV_SAMPLE_FMT_FLT, STEREO },
+	{ "flt->s16 stereo", AV_SAMPLE_FMT_FLT, STEREO, AV_SAMPLE_FMT_S16, STEREO },
+	{ "flt mono->stereo", AV_SAMPLE_FMT_FLT, MONO, AV_SAMPLE_FMT_FLT, STEREO },
+	{ "flt stereo->mono", AV_SAMPLE_FMT_FLT, STEREO, AV_SAMPLE_FMT_FLT, MONO },
+	{ "fltp stereo->mono", AV_SAMPLE_FMT_FLTP, STEREO, AV_SAMPLE_FMT_FLT, MONO },
+	{ "fltp 5.1->stereo", AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_5POINT1, AV_SAMPLE_FMT_FLT, STEREO },
+	{ "fltp 7.1->stereo", AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_7POINT1, AV_SAMPLE_FMT_FLT, STEREO },
+	{ "fltp 7.1->5.1", AV_SAMPLE_FMT_FLTP, AV_CH_LAYOUT_7POINT1, AV_SAMPLE_FMT_FLT, AV_CH_LAYOUT_5POINT1 },
+};
+
+#define IN_CHANNELS(c) av_get_channel_layout_nb_channels((c)->in_layout)
+#define OUT_CHANNELS(c) av_get_channel_layout_nb_channels((c)->out_layout)
+
+/** ************** input ************** */
+typedef DARRAY(float) float_array;
+
+//decode the whole file to mono float
+static int load_file(const char *filename, float_array *pcm, int *samplerate)
+{
+	AVFormatContext *fmt_ctx = NULL;
+	AVCodecContext *codec_ctx = NULL;
+	AVCodec *codec;
+	SwrContext *swr = NULL;
+	AVFrame *frame = av_frame_alloc();
+	AVPacket pkt;
+	int stream, got_frame, ret = -1;
+
+	if (avformat_open_input(&fmt_ctx, filename, NULL, NULL) != 0)
+		goto done;
+	if (avformat_find_stream_info(fmt_ctx, NULL) < 0)
+		goto done;
+	stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+	if (stream < 0)
+		goto done;
+
+	codec_ctx = avcodec_alloc_context3(codec);
+	if (avcodec_copy_context(codec_ctx, fmt_ctx->streams[stream]->codec) != 0
+		|| avcodec_open2(codec_ctx, codec, NULL) < 0)
+		goto done;
+
+	*samplerate = codec_ctx->sample_rate;
+	swr = swr_alloc_set_opts(NULL,
+		AV_CH_LAYOUT_MONO, AV_SAMPLE_FMT_FLT, codec_ctx->sample_rate,
+		av_get_default_channel_layout(codec_ctx->channels), codec_ctx->sample_fmt, codec_ctx->sample_rate,
+		0, NULL);
+	if (!swr || swr_init(swr) < 0)
+		goto done;
+
+	av_init_packet(&pkt);
+	while (av_read_frame(fmt_ctx, &pkt) >= 0) {
+		AVPacket left = pkt;
+
+		while (pkt.stream_index == stream && left.size > 0) {
+			int used = avcodec_decode_audio4(codec_ctx, frame, &got_frame, &left);
+			if (used < 0)
+				break;
+			left.data += used;
+			left.size -= used;
+
+			if (got_frame) {
+				uint8_t *out;
+				size_t old = pcm->num;
+
+				darray_resize(sizeof(float), &pcm->da, old + frame->nb_samples);
+				out = (uint8_t *)(pcm->array + old);
+				darray_resize(sizeof(float), &pcm->da, old + swr_convert(swr, &out, frame->nb_samples,
+					(const uint8_t **)frame->data, frame->nb_samples));
+			}
+		}
+		av_packet_unref(&pkt);
+	}
+	ret = pcm->num ? 0 : -1;
+
+done:
+	swr_free(&swr);
+	avcodec_free_context(&codec_ctx);
+	avformat_close_input(&fmt_ctx);
+	av_frame_free(&frame);
+	return ret;
+}
+
+//plane pointers of 'buf' at frame 'frame'
+static void seek_planes(uint8_t **dst, uint8_t **buf, enum AVSampleFormat fmt, int channels, int frame)
+{
+	int planar = av_sample_fmt_is_planar(fmt);
+	int step = av_get_bytes_per_sample(fmt) * (planar ? 1 : channels);
+	int i;
+
+	for (i = 0; i < (planar ? channels : 1); ++i)
+		dst[i] = buf[i] + (size_t)frame * step;
+}
+
+static float get_sample(uint8_t **buf, enum AVSampleFormat fmt, int channels, int ch, int frame)
+{
+	int planar = av_sample_fmt_is_planar(fmt);
+	int index = planar ? frame : frame * channels + ch;
+	uint8_t *plane = buf[planar ? ch : 0];
+
+	if (av_get_packed_sample_fmt(fmt) == AV_SAMPLE_FMT_S16)
+		return ((int16_t *)plane)[index] / 32768.0f;
+	return ((float *)plane)[index];
+}
+
+static void set_sample(uint8_t **buf, enum AVSampleFormat fmt, int channels, int ch, int frame, float v)
+{
+	int planar = av_sample_fmt_is_planar(fmt);
+	int index = planar ? frame : frame * channels + ch;
+	uint8_t *plane = buf[planar ? ch : 0];
+
+	if (av_get_packed_sample_fmt(fmt) == AV_SAMPLE_FMT_S16)
+		((int16_t *)plane)[index] = (int16_t)lrintf(fmaxf(-32768.0f, fminf(32767.0f, v * 32768.0f)));
+	else
+		((float *)plane)[index] = v;
+}
+
+/** ************** runs ************** */
+//one pass over the file: swr if 'swr', the kernels in 'conv' otherwise. return ns
+static uint64_t run_pass(SwrContext *swr, const SampleConv *conv, const conv_case *c,
+	uint8_t **in, uint8_t **out, int frames)
+{
+	uint8_t *in_at[8], *out_at[8];
+	uint64_t start = os_gettime_ns();
+	int i, n;
+
+	for (i = 0; i < frames; i += n) {
+		n = frames - i < CHUNK_FRAMES ? frames - i : CHUNK_FRAMES;
+		seek_planes(in_at, in, c->in_fmt, IN_CHANNELS(c), i);
+		seek_planes(out_at, out, c->out_fmt, OUT_CHANNELS(c), i);
+		if (swr)
+			swr_convert(swr, out_at, n, (const uint8_t **)in_at, n);
+		else
+			sample_conv_run(conv, out_at, (const uint8_t **)in_at, n);
+	}
+	return os_gettime_ns() - start;
+}
+
+static double max_diff(uint8_t **a, uint8_t **b, const conv_case *c, int frames)
+{
+	double diff = 0.0;
+	int i, ch;
+
+	for (i = 0; i < frames; ++i) {
+		for (ch = 0; ch < OUT_CHANNELS(c); ++ch) {
+			double d = fabs(get_sample(a, c->out_fmt, OUT_CHANNELS(c), ch, i)
+				- get_sample(b, c->out_fmt, OUT_CHANNELS(c), ch, i));
+			if (d > diff) diff = d;
+		}
+	}
+	return diff;
+}
+
+static void bench_case(const conv_case *c, const float *pcm, int frames, int samplerate)
+{
+	uint8_t **in = NULL, **out_swr = NULL, **out = NULL;
+	SwrContext *swr;
+	SampleConv conv;
+	uint64_t ns;
+	double swr_ns = 0.0;
+	int i, ch, cpu, r;
+
+	av_samples_alloc_array_and_samples(&in, NULL, IN_CHANNELS(c), frames, c->in_fmt, 0);
+	av_samples_alloc_array_and_samples(&out_swr, NULL, OUT_CHANNELS(c), frames, c->out_fmt, 0);
+	av_samples_alloc_array_and_samples(&out, NULL, OUT_CHANNELS(c), frames, c->out_fmt, 0);
+	for (i = 0; i < frames; ++i) {
+		for (ch = 0; ch < IN_CHANNELS(c); ++ch)
+			set_sample(in, c->in_fmt, IN_CHANNELS(c), ch, i, ch ? pcm[i] * -0.5f : pcm[i]);
+	}
+
+	printf("%-18s", c->name);
+
+	swr = swr_alloc_set_opts(NULL,
+		c->out_layout, c->out_fmt, samplerate,
+		c->in_layout, c->in_fmt, samplerate,
+		0, NULL);
+	if (swr && swr_init(swr) >= 0) {
+		ns = 0;
+		for (r = 0; r < REPEAT; ++r)
+			ns += run_pass(swr, NULL, c, in, out_swr, frames);
+		swr_ns = (double)ns / REPEAT / frames;
+		printf("  swr %6.2f ns/frame", swr_ns);
+	}
+	swr_free(&swr);
+
+	if (!sample_conv_setup(&conv, c->in_fmt, c->in_layout, samplerate, c->out_fmt, c->out_layout, samplerate)) {
+		printf("  (no kernel)\n");
+		goto done;
+	}
+
+	for (cpu = SAMPLE_CPU_SCALAR; cpu < SAMPLE_CPU_COUNT; ++cpu) {
+		double kernel_ns;
+
+		conv.kernels = sample_kernels_for(cpu);
+		if (!conv.kernels)
+			continue;
+
+		ns = 0;
+		for (r = 0; r < REPEAT; ++r)
+			ns += run_pass(NULL, &conv, c, in, out, frames);
+		kernel_ns = (double)ns / REPEAT / frames;
+
+		printf("  %s %6.2f ns/frame (x%4.1f, max diff %.1e)", conv.kernels->name,
+			kernel_ns, kernel_ns > 0.0 ? swr_ns / kernel_ns : 0.0,
+			max_diff(out_swr, out, c, frames));
+	}
+	printf("\n");
+
+done:
+	av_freep(&in[0]);
+	av_freep(&in);
+	av_freep(&out_swr[0]);
+	av_freep(&out_swr);
+	av_freep(&out[0]);
+	av_freep(&out);
+}
+
+static void bench_file(const char *filename)
+{
+	float_array pcm;
+	int samplerate = 0;
+	size_t i;
+
+	da_init(pcm);
+	if (load_file(filename, &pcm, &samplerate) != 0) {
+		fprintf(stderr, "%s: could not decode.\n", filename);
+		da_free(pcm);
+		return;
+	}
+
+	printf("%s: %d frames @ %d Hz, best kernels: %s\n",
+		filename, (int)pcm.num, samplerate, sample_kernels()->name);
+	for (i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i)
+		bench_case(&cases[i], pcm.array, (int)pcm.num, samplerate);
+
+	da_free(pcm);
+}
+
+int main(int argc, char *argv[])
+{
+	int i;
+
+	SDL_SetMainReady();
+	av_log_set_level(AV_LOG_QUIET);
+	av_register_all();
+
+	if (argc < 2) {
+		bench_file("res/choosing_44100_mono.mp3");
+		bench_file("res/choosing_48000_mono.mp3");
+	}
+	for (i = 1; i < argc; ++i)
+		bench_file(argv[i]);
+
+	return 0;
+}
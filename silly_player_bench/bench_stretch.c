@@ -0,0 +1,194 @@
+//time-stretch benchmark: can one core stretch N streams in real time? (stretch.c, scalar/SSE2/AVX2)
+//usage: bench_stretch [audio file] [streams] [seconds]   (default: res/choosing_48000_mono.mp3 32 10)
+//
+//the file is decoded once (decoding is bench_headless's business), every stream stretches it as stereo
+//float at its own tempo between 0.5x and 2.0x, fed in mp3 frames like the decode thread does.
+//all streams run on this one thread: 'load' is the share of the core they need to keep up.
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/log.h>
+#include <libswresample/swresample.h>
+
+#include "c99defs.h"
+#include "sample_conv.h"
+#include "stretch.h"
+#include "util/darray.h"
+#include "util/platform.h"
+
+#define DEFAULT_STREAMS 32
+#define DEFAULT_SECONDS 10
+#define CHUNK_FRAMES 1152
+
+typedef DARRAY(float) float_array;
+
+//one stretched stream: the file looped, read 'tempo' times faster than played
+typedef struct stream {
+	TimeStretch st;
+	float tempo;
+	int in_frame;		//next frame of the file to feed
+	int64_t out_frames;
+}stream;
+
+//decode the whole file to interleaved stereo float
+static int load_file(const char *filename, float_array *pcm, int *samplerate)
+{
+	AVFormatContext *fmt_ctx = NULL;
+	AVCodecContext *codec_ctx = NULL;
+	AVCodec *codec;
+	SwrContext *swr = NULL;
+	AVFrame *frame = av_frame_alloc();
+	AVPacket pkt;
+	int stream, got_frame, ret = -1;
+
+	if (avformat_open_input(&fmt_ctx, filename, NULL, NULL) != 0)
+		goto done;
+	if (avformat_find_stream_info(fmt_ctx, NULL) < 0)
+		goto done;
+	stream = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+	if (stream < 0)
+		goto done;
+
+	codec_ctx = avcodec_alloc_context3(codec);
+	if (avcodec_copy_context(codec_ctx, fmt_ctx->streams[stream]->codec) != 0
+		|| avcodec_open2(codec_ctx, codec, NULL) < 0)
+		goto done;
+
+	*samplerate = codec_ctx->sample_rate;
+	swr = swr_alloc_set_opts(NULL,
+		AV_CH_LAYOUT_STEREO, AV_SAMPLE_FMT_FLT, codec_ctx->sample_rate,
+		av_get_default_channel_layout(codec_ctx->channels), codec_ctx->sample_fmt, codec_ctx->sample_rate,
+		0, NULL);
+	if (!swr || swr_init(swr) < 0)
+		goto done;
+
+	av_init_packet(&pkt);
+	while (av_read_frame(fmt_ctx, &pkt) >= 0) {
+		AVPacket left = pkt;
+
+		while (pkt.stream_index == stream && left.size > 0) {
+			int used = avcodec_decode_audio4(codec_ctx, frame, &got_frame, &left);
+			if (used < 0)
+				break;
+			left.data += used;
+			left.size -= used;
+
+			if (got_frame) {
+				uint8_t *out;
+				size_t old = pcm->num;
+
+				darray_resize(sizeof(float), &pcm->da, old + frame->nb_samples * 2);
+				out = (uint8_t *)(pcm->array + old);
+				darray_resize(sizeof(float), &pcm->da, old + 2 * swr_convert(swr, &out, frame->nb_samples,
+					(const uint8_t **)frame->data, frame->nb_samples));
+			}
+		}
+		av_packet_unref(&pkt);
+	}
+	ret = pcm->num ? 0 : -1;
+
+done:
+	swr_free(&swr);
+	avcodec_free_context(&codec_ctx);
+	avformat_close_input(&fmt_ctx);
+	av_frame_free(&frame);
+	return ret;
+}
+
+//pull one block out of the stream, feeding it as needed
+static void stream_step(stream *s, const float_array *pcm, uint8_t *buf, int buf_size)
+{
+	int file_frames = (int)(pcm->num / 2);
+	double clock;
+	int size, n;
+
+	while ((size = stretch_read(&s->st, buf, buf_size, s->tempo, &clock)) == 0) {
+		n = min(CHUNK_FRAMES, file_frames - s->in_frame);
+		stretch_write(&s->st, (const uint8_t *)(pcm->array + (size_t)s->in_frame * 2), n * 2 * sizeof(float),
+			(double)s->in_frame / s->st.samplerate);
+		s->in_frame = (s->in_frame + n) % file_frames;
+	}
+	s->out_frames += size / (2 * sizeof(float));
+}
+
+static void bench_kernels(const SampleKernels *kernels, const float_array *pcm, int samplerate, int streams, int seconds)
+{
+	stream *s = calloc(streams, sizeof(stream));
+	uint8_t buf[CHUNK_FRAMES * 2 * sizeof(float)];
+	int64_t target = (int64_t)samplerate * seconds;
+	uint64_t start, ns;
+	double load;
+	int i, done = 0;
+
+	if (!s) return;
+
+	for (i = 0; i < streams; ++i) {
+		stretch_init(&s[i].st, samplerate, 2, false);
+		s[i].st.kernels = kernels;
+		s[i].tempo = streams > 1 ? 0.5f + 1.5f * i / (streams - 1) : 1.5f;
+		s[i].in_frame = (int)((pcm->num / 2) * i / streams);
+	}
+
+	//round robin, like that many decode threads sharing one core
+	start = os_gettime_ns();
+	while (done < streams) {
+		done = 0;
+		for (i = 0; i < streams; ++i) {
+			if (s[i].out_frames >= target)
+				++done;
+			else
+				stream_step(&s[i], pcm, buf, sizeof(buf));
+		}
+	}
+	ns = os_gettime_ns() - start;
+
+	//'seconds' of audio for each stream took 'ns' of one core
+	load = (double)ns / 1e9 / seconds;
+	printf("%-7s %d streams x %d s: %7.1f ms  %6.2f us per stream-second  load %5.1f%% of a core  (%s, ~%d streams/core)\n",
+		kernels->name, streams, seconds, ns / 1e6, ns / 1e3 / streams / seconds, load * 100.0,
+		load < 1.0 ? "real time" : "too slow", load > 0.0 ? (int)(streams / load) : 0);
+
+	for (i = 0; i < streams; ++i)
+		stretch_free(&s[i].st);
+	free(s);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *filename = argc > 1 ? argv[1] : "res/choosing_48000_mono.mp3";
+	int streams = argc > 2 ? atoi(argv[2]) : DEFAULT_STREAMS;
+	int seconds = argc > 3 ? atoi(argv[3]) : DEFAULT_SECONDS;
+	float_array pcm;
+	int samplerate = 0, cpu;
+
+	SDL_SetMainReady();
+	av_log_set_level(AV_LOG_QUIET);
+	av_register_all();
+
+	if (streams <= 0 || seconds <= 0) {
+		fprintf(stderr, "usage: %s [audio file] [streams] [seconds]\n", argv[0]);
+		return 1;
+	}
+
+	da_init(pcm);
+	if (load_file(filename, &pcm, &samplerate) != 0) {
+		fprintf(stderr, "%s: could not decode.\n", filename);
+		da_free(pcm);
+		return 1;
+	}
+
+	printf("%s: %d frames @ %d Hz, tempo 0.5x .. 2.0x, best kernels: %s\n",
+		filename, (int)(pcm.num / 2), samplerate, sample_kernels()->name);
+	for (cpu = SAMPLE_CPU_SCALAR; cpu < SAMPLE_CPU_COUNT; ++cpu) {
+		const SampleKernels *kernels = sample_kernels_for(cpu);
+		if (kernels)
+			bench_kernels(kernels, &pcm, samplerate, streams, seconds);
+	}
+
+	da_free(pcm);
+	return 0;
+}
@@ -7,13 +7,13 @@
 #include "silly_player_params.h"
 #include "silly_player_internal.h"
 #include "audio.h"
+#include "playlist.h"
+#include "sample_conv.h"
+#include "util/platform.h"
 
 #define CONVERT_FMT_SWR
 //#define SHOW_AUDIO_FRAME
 
-extern int global_exit;
-extern int active;
-
 static float cmid(float x, float min, float max){
     return (x<min) ? min : ((x>max) ? max: x);
 }
@@ -22,65 +22,142 @@ static float cmid(float x, float min, float max){
 //@param[in] is: 
 //@param[out] audio_buf: would be filled with the frame decoded
 //@param[in] audio_buf_size: size of audio_buf in bytes
+//@param[in] block: wait for packets (headless) or give up at once (device callback)
 //
-//return: bytes of the frame decoded
-static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int audio_buf_size){
-    int pkt_consumed, data_size = 0;
+//return: bytes of the frame decoded, 0 at the end of stream
+static int audio_decode_track_frame(VideoState *is, uint8_t *audio_buf, int audio_buf_size, int block){
+    int pkt_consumed, out_samples, data_size = 0;
+    int nb_channels = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels);
+    enum AVSampleFormat out_format = is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+    int out_frame_bytes = nb_channels * av_get_bytes_per_sample(out_format);
+    int out_count = (int)(is->audio_buf_capacity / out_frame_bytes); //frames out_buffer holds
+    long serial;
 
-    //data_size: bytes of frame decoded
-    data_size = av_samples_get_buffer_size(NULL,
-		is->audiospec.channels == SA_CH_LAYOUT_MONO ? av_get_channel_layout_nb_channels(AV_CH_LAYOUT_MONO) : av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO),
-        is->audio_ctx->frame_size,
-		is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT,
-        1);
+    //a seek made the rest of the current packet (or the end of stream) stale
+    if(is->audio_pkt_serial != packet_queue_serial(&is->audioq)){
+        is->audio_pkt_size = 0;
+        is->audio_pkt_eof = false;
+    }
 
     for(;;){
         //step 1. is->audio_pkt_ptr  ====>  is->audio_frame  ==ת==>  is->out_buffer
         //  1.1 is->audio_pkt_ptr꣬step 2.ȡһAVPacket *
         //  1.2 is->audio_pkt_ptrδ꣬ٽһis->audio_frame
-        while(is->audio_pkt_size > 0){
+        while(is->audio_pkt_size > 0 || is->audio_pkt_eof){
             int got_frame = 0;
             pkt_consumed = avcodec_decode_audio4(is->audio_ctx, &is->audio_frame, &got_frame, is->audio_pkt_ptr);  //pkt_consumed: how many bytes of packet consumed
 
-            if(pkt_consumed < 0){
-                is->audio_pkt_size = 0;
-                break;
-            }
-            is->audio_pkt_data += pkt_consumed;
-            is->audio_pkt_size -= pkt_consumed;
-
-            if(got_frame){
-                /*ATTENTION:
-                    swr_convert(..., in_count)
-                    in_count: number of input samples available in one channel
-                    so half of data_size is provided here. HOLY SHIT!!!
-                */
-                if(swr_convert(is->swr_ctx, &is->out_buffer, MAX_AUDIO_FRAME_SIZE, (const uint8_t **)is->audio_frame.data, is->audio_frame.nb_samples) < 0){
-                    fprintf(stderr, "swr_convert: error while converting.\n");
-                    return -1;
+            if(is->audio_pkt_eof){
+                //draining: hand out what the codec & the resampler still hold, then it's the end
+                if(pkt_consumed < 0 || !got_frame){
+                    if((is->audio_conv.kind == SAMPLE_CONV_NONE || is->audio_conv_held)
+                        && (out_samples = resampler_convert(is->resampler, &is->out_buffer, out_count, NULL, 0)) > 0){
+                        data_size = min(av_samples_get_buffer_size(NULL, nb_channels, out_samples, out_format, 1), audio_buf_size);
+                        memcpy(audio_buf, is->out_buffer, data_size);
+
+                        is->audio_buf_clock = is->audio_clock;
+                        is->audio_clock += (double)data_size / (double)(out_frame_bytes * is->audiospec.samplerate);
+                        return data_size;
+                    }
+                    //...unless the next track is queued: it follows at once, see playlist.c
+                    if(playlist_switch(is)){
+                        is->audio_pkt_eof = false;
+                        is->audio_pkt_size = 0;
+                        //crossfaded: what was decoded of it ahead goes first
+                        if((data_size = playlist_fade_tail(is, audio_buf, audio_buf_size)) > 0){
+                            return data_size;
+                        }
+                        break;
+                    }
+                    return 0;
+                }
+            }else{
+                if(pkt_consumed < 0){
+                    is->audio_pkt_size = 0;
+                    break;
+                }
+                is->audio_pkt_data += pkt_consumed;
+                is->audio_pkt_size -= pkt_consumed;
+
+                if(!got_frame){ //the codec wants more input, don't repeat the last frame
+                    continue;
                 }
-                memcpy(audio_buf, is->out_buffer, data_size);
             }
 
-			is->current_clock = is->audio_clock;
-			is->audio_clock += (double)data_size / (double)((is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4) * (is->audiospec.channels == SA_CH_LAYOUT_MONO ? 1 : 2) * is->audio_ctx->frame_size);
+            //nothing to resample: convert straight into audio_buf, no swr & no extra copy.
+            //a frame bigger than audio_buf goes through the resampler, it keeps what doesn't fit
+            if(is->audio_conv.kind != SAMPLE_CONV_NONE && !is->audio_conv_held
+                && is->audio_frame.format == is->audio_ctx->sample_fmt
+                && is->audio_frame.channels == is->audio_ctx->channels
+                && is->audio_frame.sample_rate == is->audio_ctx->sample_rate
+                && is->audio_frame.nb_samples <= audio_buf_size / out_frame_bytes){
+                out_samples = is->audio_frame.nb_samples;
+                sample_conv_run(&is->audio_conv, &audio_buf, (const uint8_t **)is->audio_frame.extended_data, out_samples);
+                data_size = out_samples * out_frame_bytes;
+
+                is->audio_buf_clock = is->audio_clock;
+                is->audio_clock += (double)data_size / (double)(out_frame_bytes * is->audiospec.samplerate);
+                return data_size;
+            }
+
+            /*ATTENTION:
+                swr_convert(..., in_count)
+                in_count: number of input samples available in one channel
+                so half of data_size is provided here. HOLY SHIT!!!
+            */
+            out_samples = resampler_convert(is->resampler, &is->out_buffer, out_count, (const uint8_t **)is->audio_frame.extended_data, is->audio_frame.nb_samples);
+            if(out_samples < 0){
+                fprintf(stderr, "resampler_convert: error while converting.\n");
+                return -1;
+            }
+            //out_buffer is full: the resampler keeps the rest for the next call, both buffers grow before it
+            is->audio_conv_held = out_samples == out_count;
+            if(is->audio_conv_held){
+                is->audio_buf_want = max(is->audio_buf_want,
+                    (size_t)(out_samples + resampler_out_frames(is->resampler, 0)) * out_frame_bytes);
+            }
+            //what was actually converted: the last frame may be short, some codecs have no fixed frame_size
+            data_size = av_samples_get_buffer_size(NULL, nb_channels, out_samples, out_format, 1);
+            if(data_size > audio_buf_size)
+                data_size = audio_buf_size;
+            memcpy(audio_buf, is->out_buffer, data_size);
+
+			is->audio_buf_clock = is->audio_clock;
+			is->audio_clock += (double)data_size / (double)((is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4) * SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) * is->audiospec.samplerate);
 
             return data_size;
         }
 
         //step 2. ´PacketQueueȡһAVPacket *
-        if(is->audio_pkt_ptr->data){
-            av_free_packet(is->audio_pkt_ptr); //free on destroy ???
-        }
-        if(global_exit){
+        av_packet_unref(is->audio_pkt_ptr); //drop our reference, the shell is reused
+        if(is->exit){
             return -2;
         }
 
-        if(packet_queue_get(&is->audioq, is->audio_pkt_ptr, 1) < 0){
-            return -3;
+        //never sleep inside the device callback: no packet yet means silence
+        for(;;){
+            if(packet_queue_get(&is->audioq, is->audio_pkt_ptr, block, &serial) <= 0){
+                return -3;
+            }
+            if(serial == packet_queue_serial(&is->audioq)){
+                break;
+            }
+            av_packet_unref(is->audio_pkt_ptr); //queued before a seek
+        }
+
+        //first packet after a seek: drop whatever the codec & resampler still hold
+        if(serial != is->audio_pkt_serial){
+            playlist_flushed(is, serial);
+            if(is->audio_pkt_serial){
+                avcodec_flush_buffers(is->audio_ctx);
+                resampler_reset(is->resampler);
+                is->audio_conv_held = false;
+            }
+            is->audio_pkt_serial = serial;
         }
         is->audio_pkt_data = is->audio_pkt_ptr->data;
         is->audio_pkt_size = is->audio_pkt_ptr->size;
+        is->audio_pkt_eof = !is->audio_pkt_ptr->data && !is->audio_pkt_ptr->size; //see parse_eof()
 
         if(is->audio_pkt_ptr->pts != AV_NOPTS_VALUE){ //???why
             //fprintf(stderr, "is->audio_clock=%f\n", is->audio_clock);
@@ -89,59 +166,671 @@ static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int audio_buf_
     }
 }
 
+//decode one frame of the stream, with the next track mixed in during a crossfade (see playlist.c)
+static int audio_decode_mixed_frame(VideoState *is, uint8_t *audio_buf, int audio_buf_size, int block){
+    int data_size = playlist_fade_tail(is, audio_buf, audio_buf_size);
+
+    if(data_size <= 0){
+        data_size = audio_decode_track_frame(is, audio_buf, audio_buf_size, block);
+    }
+    if(data_size > 0){
+        playlist_fade_mix(is, audio_buf, data_size, is->audio_buf_clock);
+    }
+    return data_size;
+}
+
+//decode one block of PCM, time-stretched once the tempo is not 1 (see stretch.c).
+//audio_buf_clock stays in media time, audio_buf_tempo tells how fast it runs
+static int audio_decode_stretched_frame(VideoState *is, uint8_t *audio_buf, int audio_buf_size, int block){
+    float tempo = is->tempo;
+    int data_size;
+    double clock;
+
+    is->audio_buf_tempo = 1.0f;
+
+    //back at tempo 1: play out what the stretcher holds (unless a seek made it stale), then straight through again
+    if(is->stretch_active && tempo == 1.0f){
+        if(is->stretch_serial == packet_queue_serial(&is->audioq) && stretch_drain(&is->stretch)
+            && (data_size = stretch_read(&is->stretch, audio_buf, audio_buf_size, tempo, &clock)) > 0){
+            is->audio_buf_clock = clock;
+            is->audio_buf_tempo = is->stretch.out_tempo;
+            return data_size;
+        }
+        is->stretch_active = false;
+    }
+
+    if(!is->stretch_active){
+        if(tempo == 1.0f){
+            return audio_decode_mixed_frame(is, audio_buf, audio_buf_size, block);
+        }
+        if(!is->stretch.hann){
+            //the budget may have shrunk since silly_player_set_tempo(): back to tempo 1
+            if(!audio_mem_fits(is, stretch_bytes_for(is->audiospec.samplerate, SA_CH_LAYOUT_CHANNELS(is->audiospec.channels)))){
+                fprintf(stderr, "time-stretch: over the memory budget, tempo back to 1.\n");
+                is->tempo = 1.0f;
+                return audio_decode_mixed_frame(is, audio_buf, audio_buf_size, block);
+            }
+            if(stretch_init(&is->stretch, is->audiospec.samplerate,
+                SA_CH_LAYOUT_CHANNELS(is->audiospec.channels), is->audiospec.format == SA_SAMPLE_FMT_S16) != 0){
+                return audio_decode_mixed_frame(is, audio_buf, audio_buf_size, block);
+            }
+        }
+        stretch_reset(&is->stretch);
+        is->stretch_active = true;
+        is->stretch_serial = is->audio_pkt_serial;
+    }
+
+    //the stretcher buffers a few segments: feed it until a hop is out
+    for(;;){
+        if((data_size = stretch_read(&is->stretch, audio_buf, audio_buf_size, tempo, &clock)) > 0){
+            is->audio_buf_clock = clock;
+            is->audio_buf_tempo = is->stretch.out_tempo;
+            return data_size;
+        }
+
+        data_size = audio_decode_mixed_frame(is, audio_buf, audio_buf_size, block);
+        if(data_size > 0){
+            if(is->audio_pkt_serial != is->stretch_serial){ //seeked: start over, straight through at tempo 1
+                stretch_reset(&is->stretch);
+                is->stretch_serial = is->audio_pkt_serial;
+                if(tempo == 1.0f){
+                    is->stretch_active = false;
+                    return data_size;
+                }
+            }
+            stretch_write(&is->stretch, audio_buf, data_size, is->audio_buf_clock);
+        }else if(data_size < 0 || !stretch_drain(&is->stretch)){
+            if(data_size == 0){
+                is->stretch_active = false; //flushed, starts over if playing goes on
+            }
+            return data_size; //end of stream once the stretcher is flushed too
+        }
+    }
+}
+
+//the spectrum analyzer asked for, turned off if it doesn't fit the memory budget (the one it replaces is freed first)
+static long audio_spectrum_request(VideoState *is){
+    long request = os_atomic_load_long(&is->spectrum_request);
+    size_t want, held;
+
+    if(!request || request == is->spectrum.config){
+        return request;
+    }
+    want = spectrum_bytes_for(SPECTRUM_REQUEST_FFT_SIZE(request), is->spectrum.channels);
+    held = spectrum_bytes(&is->spectrum);
+    if(want > held && !audio_mem_fits(is, want - held)){
+        fprintf(stderr, "spectrum: over the memory budget, turned off.\n");
+        os_atomic_compare_swap_long(&is->spectrum_request, request, 0);
+        return 0;
+    }
+    return request;
+}
+
+//decode one block of PCM as it will be played (before the volume), measuring it on the way (see meter.c, spectrum.c)
+static int audio_decode_frame(VideoState *is, uint8_t *audio_buf, int audio_buf_size, int block){
+    int data_size = audio_decode_stretched_frame(is, audio_buf, audio_buf_size, block);
+
+    if(data_size > 0){
+        meter_update(&is->meter, audio_buf, data_size, is->audio_pkt_serial, is->audio_buf_clock, is->audio_buf_tempo);
+        spectrum_update(&is->spectrum, audio_spectrum_request(is),
+            audio_buf, data_size, is->audio_pkt_serial, is->audio_buf_clock, is->audio_buf_tempo);
+    }
+    return data_size;
+}
+
+//conversion of a decoder's output to is->audiospec (the stream opened, or a queued track)
+//return 0 on success, negative on error
+int audio_conv_open(VideoState *is, AVCodecContext *codec_ctx, Resampler **resampler, SampleConv *conv){
+    //the layout the file declares (5.1 side or back...), the default one for its channel count if it has none
+    int64_t in_layout = codec_ctx->channel_layout
+        && av_get_channel_layout_nb_channels(codec_ctx->channel_layout) == codec_ctx->channels
+        ? (int64_t)codec_ctx->channel_layout : av_get_default_channel_layout(codec_ctx->channels);
+    int64_t out_layout = sa_av_channel_layout(is->audiospec.channels);
+
+    //of the tier asked for by silly_player_set_resampler()
+    *resampler = resampler_open(is->resample_quality,
+        out_layout,                                             //out_ch_layout
+        is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT,      //out_sample_fmt
+        is->audiospec.samplerate,                               //out_sample_rate
+        in_layout,                                              //in_ch_layout
+        codec_ctx->sample_fmt,                                  //in_sample_fmt
+        codec_ctx->sample_rate                                  //in_sample_rate
+        );
+    if(!*resampler){
+        return -1;
+    }
+
+    //same samplerate: plain format/channel conversions & the common surround downmixes are done by our
+    //kernels, see sample_conv.c
+    sample_conv_setup(conv,
+        codec_ctx->sample_fmt, in_layout, codec_ctx->sample_rate,
+        is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT,
+        out_layout,
+        is->audiospec.samplerate);
+    return 0;
+}
+
+//drop samples waiting for the fetcher & the taps, they belong to the position before a seek.
+//we're the producer and can't touch the head: mark where the stale data ends, the reader skips it
+void audio_fetch_flush(VideoState *is){
+    if(is->active_fetch){
+        audio_ring_discard(&is->audio_fetch_ring);
+    }
+    if(is->tap_active){
+        audio_ring_discard(&is->tap_source);
+    }
+}
+
+//publish the playback clock: from now on the device plays 'span' sec of media from 'clock' at 'speed'.
+//audio_callback() or audio_pause() only, both under the device lock (one writer at a time), readers see it through clock_seq
+static void audio_clock_publish(VideoState *is, double clock, double span, float speed){
+    os_atomic_inc_long(&is->clock_seq);
+    is->clock_base = clock;
+    is->clock_time = os_gettime_ns();
+    is->clock_span = span;
+    is->clock_speed = speed;
+    os_atomic_inc_long(&is->clock_seq);
+}
+
+//stop/restart the output. a voice has no device: its mixer skips it while paused
+void audio_pause(VideoState *is, bool pause_on){
+    if(is->audio_dev){
+        //the API & parse threads both pause: the device lock keeps them (and the callback) from
+        //publishing the clock at the same time
+        SDL_LockAudioDevice(is->audio_dev);
+        SDL_PauseAudioDevice(is->audio_dev, pause_on);
+
+        //the callback is stopped: the clock holds where it is
+        if(pause_on && !is->pause_on && is->clock_time){
+            audio_clock_publish(is, get_audio_clock(is), 0.0, 0.0f);
+            is->clock_pending = false;
+        }
+        is->pause_on = pause_on;
+        SDL_UnlockAudioDevice(is->audio_dev);
+        return;
+    }
+    is->pause_on = pause_on;
+}
+
+//the first decoded frame of a seek is about to be handed to the device
+//@param[in] serial: audioq serial of that frame
+static void seek_latency_update(VideoState *is, long serial){
+    long seek_serial = os_atomic_load_long(&is->seek_serial);
+
+    if(seek_serial && serial == seek_serial){
+        is->seek_latency = (double)(os_gettime_ns() - is->seek_req_time) / 1000000.0;
+        os_atomic_compare_swap_long(&is->seek_serial, seek_serial, 0);
+    }
+}
+
+static int audio_bytes_per_second(VideoState *is){
+    return is->audiospec.samplerate
+        * SA_CH_LAYOUT_CHANNELS(is->audiospec.channels)
+        * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+}
+
+//bytes held by the buffers of the player, sampled without locking: any thread
+void audio_memstats(VideoState *is, silly_memstats *stats){
+    memset(stats, 0, sizeof(silly_memstats));
+    stats->budget = is->mem_budget;
+    stats->decode = (int64_t)is->audio_buf_capacity * 2 + is->fade_buf_capacity + is->fade_pcm.capacity;
+    stats->stretch = stretch_bytes(&is->stretch);
+    stats->analysis = meter_bytes(&is->meter) + spectrum_bytes(&is->spectrum);
+    stats->pcm_ring = is->pcm_ring.capacity;
+    stats->fetch = is->audio_fetch_ring.capacity;
+    stats->taps = os_atomic_load_long(&is->tap_bytes);
+    stats->packets = os_atomic_load_long(&is->audioq.size) + (is->audioq.slots ? PACKET_QUEUE_CAPACITY * sizeof(PacketSlot) : 0);
+    stats->total = stats->decode + stats->stretch + stats->analysis + stats->pcm_ring + stats->fetch + stats->taps + stats->packets;
+}
+
+//bytes left of the memory budget, SIZE_MAX without one
+static size_t audio_mem_left(VideoState *is){
+    silly_memstats stats;
+
+    if(is->mem_budget <= 0){
+        return SIZE_MAX;
+    }
+    audio_memstats(is, &stats);
+    return stats.total < stats.budget ? (size_t)(stats.budget - stats.total) : 0;
+}
+
+//whether 'bytes' more fit the memory budget: the stretcher & the spectrum analyzer, allocated on demand
+bool audio_mem_fits(VideoState *is, size_t bytes){
+    return bytes <= audio_mem_left(is);
+}
+
+//capacity for a ring of 'want' bytes under the memory budget: what audio_ring_init() would allocate,
+//halved while it's over what's left, but not below 'least' bytes. return 0 if even that doesn't fit
+size_t audio_ring_grant(VideoState *is, size_t want, size_t least){
+    size_t left = audio_mem_left(is);
+    size_t capacity = 1;
+
+    if(is->mem_budget <= 0){
+        return want;
+    }
+    while(capacity < want){
+        capacity <<= 1;
+    }
+    while(capacity > left && capacity / 2 >= least){
+        capacity >>= 1;
+    }
+    if(capacity > left){
+        fprintf(stderr, "memory budget: %lu bytes left, a ring needs %lu.\n", (unsigned long)left, (unsigned long)capacity);
+        return 0;
+    }
+    return capacity;
+}
+
+//decoder, between two frames (nothing handed out of them): grow audio_buf & out_buffer to audio_buf_want.
+//a frame is never cut, so a bigger one than the codec announced may go over the budget
+static void audio_buf_reserve(VideoState *is){
+    if(is->audio_buf_want <= is->audio_buf_capacity){
+        return;
+    }
+    if(2 * (is->audio_buf_want - is->audio_buf_capacity) > audio_mem_left(is)){
+        fprintf(stderr, "memory budget: a decoded frame of %lu bytes goes over it.\n", (unsigned long)is->audio_buf_want);
+    }
+    is->audio_buf = brealloc(is->audio_buf, is->audio_buf_want);
+    is->out_buffer = brealloc(is->out_buffer, is->audio_buf_want);
+    is->audio_buf_capacity = is->audio_buf_want;
+}
+
+//allocate audio_buf & out_buffer for one frame of the codec in the device format, invoke once the device is open.
+//frame_size is 0 when the frames of a codec vary: they start at AUDIO_FRAME_FRAMES and grow on a bigger one
+//return 0 on success, negative if the memory budget can't hold them
+int audio_buf_open(VideoState *is){
+    AVCodecContext *codec_ctx = is->audio_ctx;
+    int64_t frames = codec_ctx->frame_size > 0 ? codec_ctx->frame_size : AUDIO_FRAME_FRAMES;
+    size_t frame_bytes = (size_t)SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+    size_t bytes;
+
+    //at the device rate, with what the resampler may hold on top
+    if(codec_ctx->sample_rate > 0){
+        frames = (frames * is->audiospec.samplerate + codec_ctx->sample_rate - 1) / codec_ctx->sample_rate;
+    }
+    bytes = (size_t)(frames + AUDIO_FRAME_SLACK) * frame_bytes;
+
+    if(2 * bytes > audio_mem_left(is)){
+        fprintf(stderr, "memory budget: %lld bytes can't hold a decoded frame (%lu bytes).\n",
+            (long long)is->mem_budget, (unsigned long)(2 * bytes));
+        return -1;
+    }
+    is->audio_buf_want = bytes;
+    is->audio_conv_held = false;
+    audio_buf_reserve(is);
+    return 0;
+}
+
+void audio_buf_close(VideoState *is){
+    bfree(is->audio_buf);
+    bfree(is->out_buffer);
+    is->audio_buf = NULL;
+    is->out_buffer = NULL;
+    is->audio_buf_capacity = 0;
+    is->audio_buf_want = 0;
+}
+
+//a chunk in pcm_ring: this header, then 'size' bytes of PCM
+typedef struct PcmChunk{
+    long serial; //audioq serial the PCM was decoded from
+    long track; //playlist track it belongs to (0: the file opened)
+    int size;
+    double clock; //pts of the first byte (in sec)
+    float tempo; //media seconds per second of PCM (time-stretch)
+}PcmChunk;
+
+//size the ring for the latency target, invoke before the decode thread & the device start.
+//under a memory budget the target shrinks to what the ring can get
+int audio_ring_open(VideoState *is, int device_buffer_bytes){
+    size_t target = (size_t)audio_bytes_per_second(is) * is->pcm_latency_ms / 1000;
+    size_t frame_bytes = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+    size_t chunk_max = max((size_t)device_buffer_bytes, (size_t)4096 / frame_bytes * frame_bytes); //whole frames
+    size_t capacity;
+
+    //the device must always find a full buffer once we're running
+    if(target < (size_t)device_buffer_bytes * 2){
+        target = (size_t)device_buffer_bytes * 2;
+    }
+    capacity = audio_ring_grant(is, target + chunk_max + sizeof(PcmChunk),
+        (size_t)device_buffer_bytes * 2 + chunk_max + sizeof(PcmChunk));
+    if(!capacity){
+        return -1;
+    }
+    is->pcm_target = min(target, capacity - chunk_max - sizeof(PcmChunk));
+    is->pcm_chunk_max = chunk_max;
+    is->pcm_chunk_left = 0;
+    is->pcm_stale_left = 0;
+    is->pcm_chunk_clock = 0;
+    is->pcm_chunk_serial = 0;
+    is->pcm_decoder_waiting = false;
+    is->pcm_eos_serial = 0;
+    is->underruns = 0;
+
+    //room for one more chunk beyond the target
+    if(audio_ring_init(&is->pcm_ring, capacity) != 0){
+        return -1;
+    }
+    if(os_event_init(&is->pcm_room_event, OS_EVENT_TYPE_AUTO) != 0){
+        audio_ring_free(&is->pcm_ring);
+        return -2;
+    }
+    return 0;
+}
+
+void audio_ring_close(VideoState *is){
+    if(is->pcm_room_event){
+        os_event_destroy(is->pcm_room_event);
+        is->pcm_room_event = NULL;
+    }
+    audio_ring_free(&is->pcm_ring);
+}
+
+//decode thread: wait until the ring is below the latency target. return false when quitting
+static bool audio_ring_wait_room(VideoState *is){
+    while(audio_ring_used(&is->pcm_ring) >= is->pcm_target){
+        if(is->exit){
+            return false;
+        }
+
+        os_atomic_set_bool(&is->pcm_decoder_waiting, true);
+        if(audio_ring_used(&is->pcm_ring) >= is->pcm_target && !is->exit){
+            //the callback signals once it has read; the timeout covers a paused device & close
+            os_event_timedwait(is->pcm_room_event, 100);
+        }
+        os_atomic_set_bool(&is->pcm_decoder_waiting, false);
+    }
+    return !is->exit;
+}
+
+//decode thread: packets --> frames --> chunks of PCM in is->pcm_ring
+int audio_decode_thread(void *arg){
+    VideoState *is = (VideoState *)arg;
+    int audio_size, bytes_per_second = audio_bytes_per_second(is);
+    size_t offset, size;
+    PcmChunk chunk;
+
+    os_set_thread_name("silly_audio_decode");
+
+    while(!is->exit){
+        audio_buf_reserve(is);
+        audio_size = audio_decode_frame(is, is->audio_buf, (int)is->audio_buf_capacity, 1);
+        if(audio_size <= 0){
+            if(is->audioq.abort_request){
+                break;
+            }
+            if(audio_size == 0){
+                //end of stream (see parse_finished()): all is in the ring, tell the parse thread
+                //and sleep on audioq until a seek
+                is->audio_pkt_eof = false;
+                os_atomic_set_long(&is->pcm_eos_serial, is->audio_pkt_serial);
+                packet_queue_wakeup(&is->audioq);
+            }
+            continue; //decoding error: skip the frame
+        }
+
+        //cut the frame into chunks the callback can take in one go
+        for(offset = 0; offset < (size_t)audio_size; offset += size){
+            size = min((size_t)audio_size - offset, is->pcm_chunk_max);
+
+            if(!audio_ring_wait_room(is)){
+                return 0;
+            }
+            if(is->audio_pkt_serial != packet_queue_serial(&is->audioq)){
+                break; //a seek came in while we were waiting, the rest is stale
+            }
+
+            chunk.serial = is->audio_pkt_serial;
+            chunk.track = is->track_decoded;
+            chunk.size = (int)size;
+            chunk.clock = is->audio_buf_clock + (double)offset / bytes_per_second * is->audio_buf_tempo;
+            chunk.tempo = is->audio_buf_tempo;
+            audio_ring_write(&is->pcm_ring, &chunk, sizeof(chunk));
+            audio_ring_write(&is->pcm_ring, is->audio_buf + offset, size);
+        }
+    }
+
+    return 0;
+}
+
 #define PRINT_TOTAL_SAMPLES 0
 #if PRINT_TOTAL_SAMPLES == 1
 static int total_samples = 0; //total sample number (1 sample: audio data of all channels)
 #endif
 
-//'len' bytes should be fed to 'stream'
+//copy 'size' bytes of PCM to the device applying the volume, frame i of the block gets 'gain + i * step'.
+//at unity it's a straight copy
+static void audio_apply_volume(VideoState *is, uint8_t *dst, const uint8_t *src, size_t size, float gain, float step){
+    int channels = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels);
+
+    if(gain == 1.0f && step == 0.0f){
+        memcpy(dst, src, size);
+    }else if(is->audiospec.format == SA_SAMPLE_FMT_S16){
+        sample_kernels()->gain_s16((int16_t *)dst, (const int16_t *)src, (int)(size / (2 * channels)), channels, gain, step);
+    }else{
+        sample_kernels()->gain_flt((float *)dst, (const float *)src, (int)(size / (4 * channels)), channels, gain, step);
+    }
+}
+
+//a callback wrote 'span' sec of media from 'clock' (span 0: silence). SDL double buffers: the device starts
+//playing what the previous callback wrote when it asks for the next block, so that one is heard now
+static void audio_clock_update(VideoState *is, double clock, double span, float speed){
+    if(is->clock_pending){
+        audio_clock_publish(is, is->clock_pending_base, is->clock_pending_span, is->clock_pending_speed);
+    }
+
+    if(span > 0.0){
+        is->clock_pending_base = clock;
+        is->clock_pending_span = span;
+        is->clock_pending_speed = speed;
+        is->clock_pending = true;
+    }else if(is->clock_pending){
+        //silence: the clock holds at the end of what was written
+        is->clock_pending_base += is->clock_pending_span;
+        is->clock_pending_span = 0.0;
+    }
+}
+
+//'len' bytes should be fed to 'stream'.
+//the PCM is ready in is->pcm_ring (see audio_decode_thread()), nothing is decoded or waited for here
 void audio_callback(void *userdata, uint8_t *stream, int len){
     VideoState *is = (VideoState *)userdata;
+	int bytes_per_second = audio_bytes_per_second(is);
+	int frame_bytes = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
 	size_t actual_len;
-	int audio_size;
+	const uint8_t *pcm;
+	uint8_t split[AUDIO_FRAME_BYTES_MAX];
+	PcmChunk chunk;
+	double block_clock = 0.0, block_span = 0.0;
+	float block_speed = 1.0f;
 
-	if(!active)
+	//a volume change ramps linearly over this callback, so it never clicks
+	float gain = is->volume_applied;
+	float target = is->volume;
+	float step = len >= frame_bytes ? (target - gain) / (float)(len / frame_bytes) : 0.0f;
+
+	if(!is->active){
+		SDL_memset(stream, 0, len);  //SDL 2.0
 		return;
+	}
 
 #if PRINT_TOTAL_SAMPLES == 1
-	total_samples += (len / (is->audiospec.channels == SA_CH_LAYOUT_MONO ? 1 : 2) / (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4));
+	total_samples += (len / SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) / (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4));
 	fprintf(stderr, "%lf: total samples: %d\n", (float)av_gettime() / 1000000.0, total_samples);
 #endif
 
-    SDL_memset(stream, 0, len);  //SDL 2.0
-
-    //take 'len' bytes from 'is->audio_buf' to 'stream'.
-    //NOTE: if there's not enough in 'is-audio_buf', audio_decode_frame() more to fill it!
+    //take 'len' bytes from 'is->pcm_ring' to 'stream'
     while(len > 0){
-        if(is->audio_buf_index >= is->audio_buf_size){  //we have sent all our data(in audio buf), decode more
-            audio_size = audio_decode_frame(is, is->audio_buf, sizeof(is->audio_buf));
-            if(audio_size < 0){  //error, output silence
-                is->audio_buf_size = SDL_AUDIO_BUFFER_SIZE;
-                memset(is->audio_buf, 0, is->audio_buf_size);
-            }else{
-                is->audio_buf_size = audio_size;
+        if(is->pcm_stale_left > 0){
+            //payload of a stale chunk, dropped as it arrives (like a live one is played)
+            is->pcm_stale_left -= audio_ring_read(&is->pcm_ring, NULL, is->pcm_stale_left);
+            if(is->pcm_stale_left > 0){
+                break; //the rest is not published yet
             }
-            is->audio_buf_index = 0;
+        }
+        if(is->pcm_chunk_left == 0){  //next chunk
+            if(audio_ring_used(&is->pcm_ring) < sizeof(chunk)){
+                //ring ran dry: the decode thread fell behind, the rest is silence.
+                //(not before the first chunk after open/seek, nor at the end of stream)
+                if(!is->exit_parse && is->pcm_chunk_serial == packet_queue_serial(&is->audioq)){
+                    os_atomic_inc_long(&is->underruns);
+                }
+                break;
+            }
+            audio_ring_read(&is->pcm_ring, &chunk, sizeof(chunk));
+
+            if(chunk.serial != packet_queue_serial(&is->audioq)){  //decoded before a seek, throw it away
+                is->pcm_stale_left = chunk.size;
+                audio_fetch_flush(is);
+                continue;
+            }
+            is->pcm_chunk_left = chunk.size;
+            is->pcm_chunk_clock = chunk.clock;
+            is->pcm_chunk_tempo = chunk.tempo;
+            is->pcm_chunk_serial = chunk.serial;
+            is->track_played = chunk.track;
+
+            seek_latency_update(is, chunk.serial);
         }
 
-        //there're data left in audio buf, feed to stream
-		actual_len = min(is->audio_buf_size - is->audio_buf_index, len);
-		SDL_MixAudio(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, actual_len, SDL_MIX_MAXVOLUME);
-		
-		if (is->active_fetch) {
-			pthread_mutex_lock(&is->audio_fetch_buffer_mutex);
-			circlebuf_push_back(&is->audio_fetch_buffer, (uint8_t *)is->audio_buf + is->audio_buf_index, actual_len);
-			pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
+        //the payload may still be on its way (the header is published first).
+        //read it in place: the only pass over the samples is the copy (with volume) to 'stream'.
+        //whole frames only, so the fetch & tap rings stay frame aligned (a frame split by the wrap comes alone)
+		actual_len = min(audio_ring_peek_frames(&is->pcm_ring, &pcm, frame_bytes, split), min(is->pcm_chunk_left, (size_t)len));
+		if(actual_len == 0){
+			os_atomic_inc_long(&is->underruns);
+			break;
 		}
+		if(block_span == 0.0){
+			block_clock = is->pcm_chunk_clock;
+			block_speed = is->pcm_chunk_tempo;
+		}
+		block_span += (double)actual_len / bytes_per_second * is->pcm_chunk_tempo;
+		audio_apply_volume(is, stream, pcm, actual_len, gain, step);
+		gain += step * (float)(actual_len / frame_bytes);
+
+		//fetching & taps get the samples before the volume
+		if (is->active_fetch && audio_ring_avail(&is->audio_fetch_ring) >= actual_len) {
+			//never wait for the fetcher: a block that doesn't fit is dropped whole
+			audio_ring_write(&is->audio_fetch_ring, pcm, actual_len);
+		}
+		if (os_atomic_load_long(&is->tap_count) > 0
+			&& audio_ring_avail(&is->tap_source) >= actual_len) {
+			//same for the taps, whole blocks only: the tap thread must stay frame aligned
+			audio_ring_write(&is->tap_source, pcm, actual_len);
+		}
+		audio_ring_read(&is->pcm_ring, NULL, actual_len);
+
+		is->pcm_chunk_left -= actual_len;
+		is->pcm_chunk_clock += (double)actual_len / bytes_per_second * is->pcm_chunk_tempo;
+		is->current_clock = is->pcm_chunk_clock;
 
-		len -= actual_len;
+		len -= (int)actual_len;
 		stream += actual_len;
-		is->audio_buf_index += actual_len;
+    }
+    is->volume_applied = target;
+    audio_clock_update(is, block_clock, block_span, block_speed);
+
+    //underrun / end of stream: silence
+    if(len > 0){
+        SDL_memset(stream, 0, len);
+    }
+
+    //only pay for the events when the decode thread / the fetcher / the tap thread is actually asleep
+    if(os_atomic_load_bool(&is->pcm_decoder_waiting)){
+        os_event_signal(is->pcm_room_event);
+    }
+    if(os_atomic_load_bool(&is->audio_fetch_waiting)){
+        os_event_signal(is->audio_fetch_event);
+    }
+    if(os_atomic_load_bool(&is->tap_waiting)){
+        os_event_signal(is->tap_event);
+    }
+    //end of stream: the parse thread waits for the ring to be played out
+    if(os_atomic_load_bool(&is->pcm_drain_waiting) && audio_ring_used(&is->pcm_ring) == 0){
+        packet_queue_wakeup(&is->audioq);
     }
 }
 
+//headless: make sure audio_buf holds PCM not handed out yet, decoding the next frame if needed.
+//unlike audio_callback() it waits for the parse thread instead of playing silence.
+//return bytes left in audio_buf (from audio_buf_index), 0 at the end of stream, negative on error/close
+int audio_decode_next(VideoState *is){
+    int audio_size;
+
+    if(is->audio_buf_serial != packet_queue_serial(&is->audioq)){  //decoded before a seek, throw it away
+        is->audio_buf_index = is->audio_buf_size;
+    }
+
+    if(is->audio_buf_index >= is->audio_buf_size){
+        audio_buf_reserve(is);
+        audio_size = audio_decode_frame(is, is->audio_buf, (int)is->audio_buf_capacity, 1);
+        if(audio_size <= 0){
+            is->audio_buf_size = 0;
+            is->audio_buf_index = 0;
+            return audio_size;
+        }
+        is->audio_buf_size = audio_size;
+        is->audio_buf_serial = is->audio_pkt_serial;
+        is->audio_buf_index = 0;
+        is->current_clock = is->audio_buf_clock;
+        is->track_played = is->track_decoded;
+
+        seek_latency_update(is, is->audio_buf_serial);
+    }
+
+    return (int)(is->audio_buf_size - is->audio_buf_index);
+}
+
+//headless: copy up to 'len' bytes of PCM to 'stream'
+//return bytes copied, 0 at the end of stream, negative on error/close
+int audio_decode_pcm(VideoState *is, uint8_t *stream, int len){
+    int written = 0, avail;
+    size_t actual_len;
+
+    while(len > 0){
+        avail = audio_decode_next(is);
+        if(avail <= 0){
+            return written > 0 ? written : avail;
+        }
+
+        actual_len = min((size_t)avail, (size_t)len);
+        memcpy(stream, (uint8_t *)is->audio_buf + is->audio_buf_index, actual_len);
+
+        len -= actual_len;
+        stream += actual_len;
+        written += actual_len;
+        is->audio_buf_index += actual_len;
+    }
+    return written;
+}
+
+//position being heard: the block the device plays (see audio_clock_update()), interpolated with the
+//time since it started. takes no lock from any thread, but spins while a callback publishes.
+//headless & before the first block is heard: the position handed out
 double get_audio_clock(VideoState *is) {
-  double pts;
-  pts = is->current_clock; /* maintained in the audio thread */
-  return pts;
+    double base, span, elapsed;
+    uint64_t time;
+    float speed;
+    long seq;
+
+    if(is->headless){
+        return is->current_clock;
+    }
+
+    do{
+        while((seq = os_atomic_load_long(&is->clock_seq)) & 1)
+            ; //being published, a few stores
+        base = is->clock_base;
+        time = is->clock_time;
+        span = is->clock_span;
+        speed = is->clock_speed;
+        os_atomic_thread_fence_acquire(); //the copies above stay before the re-check
+    }while(os_atomic_load_long(&is->clock_seq) != seq);
+
+    if(!time){
+        return is->current_clock;
+    }
+
+    elapsed = (double)(os_gettime_ns() - time) / 1000000000.0 * speed;
+    return base + (elapsed < span ? elapsed : span);
 }
@@ -3,5 +3,18 @@
 #include <stdint.h>
 #include "silly_player_internal.h"
 
+int audio_ring_open(VideoState *is, int device_buffer_bytes);
+void audio_ring_close(VideoState *is);
+size_t audio_ring_grant(VideoState *is, size_t want, size_t least);
+int audio_buf_open(VideoState *is);
+void audio_buf_close(VideoState *is);
+void audio_memstats(VideoState *is, silly_memstats *stats);
+bool audio_mem_fits(VideoState *is, size_t bytes);
+int audio_decode_thread(void *arg);
 void audio_callback(void *userdata, uint8_t *stream, int len);
+int audio_conv_open(VideoState *is, AVCodecContext *codec_ctx, Resampler **resampler, SampleConv *conv);
+void audio_fetch_flush(VideoState *is);
+void audio_pause(VideoState *is, bool pause_on);
+int audio_decode_next(VideoState *is);
+int audio_decode_pcm(VideoState *is, uint8_t *stream, int len);
 double get_audio_clock(VideoState *is);
\ No newline at end of file
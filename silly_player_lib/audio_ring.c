@@ -0,0 +1,118 @@
+#include "c99defs.h"
+#include "audio_ring.h"
+
+int audio_ring_init(AudioRing *r, size_t min_capacity){
+    size_t capacity = 1;
+
+    memset(r, 0, sizeof(AudioRing));
+    while(capacity < min_capacity){
+        capacity <<= 1;
+    }
+
+    r->data = bmalloc(capacity);
+    if(!r->data){
+        return -1;
+    }
+    r->capacity = capacity;
+    return 0;
+}
+
+void audio_ring_free(AudioRing *r){
+    bfree(r->data);
+    memset(r, 0, sizeof(AudioRing));
+}
+
+size_t audio_ring_write(AudioRing *r, const void *data, size_t size){
+    long tail = r->tail; //only the producer writes tail
+    size_t pos = (size_t)tail & (r->capacity - 1);
+    size_t first;
+
+    if(size > audio_ring_avail(r)){
+        size = audio_ring_avail(r);
+    }
+
+    first = size < r->capacity - pos ? size : r->capacity - pos;
+    memcpy(r->data + pos, data, first);
+    memcpy(r->data, (const uint8_t *)data + first, size - first);
+
+    os_atomic_set_long(&r->tail, (long)((unsigned long)tail + size)); //publish
+    return size;
+}
+
+size_t audio_ring_read(AudioRing *r, void *data, size_t size){
+    long head = r->head; //only the consumer writes head
+    size_t pos = (size_t)head & (r->capacity - 1);
+    size_t first;
+
+    if(size > audio_ring_used(r)){
+        size = audio_ring_used(r);
+    }
+
+    if(data){
+        first = size < r->capacity - pos ? size : r->capacity - pos;
+        memcpy(data, r->data + pos, first);
+        memcpy((uint8_t *)data + first, r->data, size - first);
+    }
+
+    os_atomic_set_long(&r->head, (long)((unsigned long)head + size)); //hand the bytes back
+    return size;
+}
+
+size_t audio_ring_peek(AudioRing *r, const uint8_t **data){
+    size_t pos = (size_t)r->head & (r->capacity - 1);
+    size_t used = audio_ring_used(r);
+
+    *data = r->data + pos;
+    return used < r->capacity - pos ? used : r->capacity - pos;
+}
+
+size_t audio_ring_peek_frames(AudioRing *r, const uint8_t **data, size_t frame_bytes, uint8_t *split){
+    size_t pos = (size_t)r->head & (r->capacity - 1);
+    size_t used = audio_ring_used(r);
+    size_t contiguous = r->capacity - pos;
+
+    *data = r->data + pos;
+    if(used < frame_bytes){
+        return 0;
+    }
+    if(contiguous >= frame_bytes){
+        contiguous = used < contiguous ? used : contiguous;
+        return contiguous - contiguous % frame_bytes;
+    }
+
+    //the frame wraps around
+    memcpy(split, r->data + pos, contiguous);
+    memcpy(split + contiguous, r->data, frame_bytes - contiguous);
+    *data = split;
+    return frame_bytes;
+}
+
+void audio_ring_discard(AudioRing *r){
+    os_atomic_set_long(&r->discard, r->tail);
+    os_atomic_inc_long(&r->discards);
+}
+
+bool audio_ring_skip_stale(AudioRing *r){
+    long discards = os_atomic_load_long(&r->discards);
+    unsigned long stale;
+
+    if(discards == r->discards_seen){
+        return false;
+    }
+    r->discards_seen = discards;
+
+    //already read past the mark if the difference "wraps"
+    stale = (unsigned long)os_atomic_load_long(&r->discard) - (unsigned long)r->head;
+    if(stale <= audio_ring_used(r)){
+        audio_ring_read(r, NULL, stale);
+    }
+    return true;
+}
+
+void audio_ring_reset(AudioRing *r){
+    r->head = 0;
+    r->tail = 0;
+    r->discard = 0;
+    r->discards = 0;
+    r->discards_seen = 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "c99defs.h"
+
+#include "packet_queue.h" //CACHE_LINE_SIZE
+#include "util/bmem.h"
+#include "util/threading.h"
+
+//bounded single-producer/single-consumer byte ring for decoded PCM.
+//the decode thread is the only producer, the device callback the only consumer.
+//neither side ever takes a lock: positions are published with atomic stores
+//after the bytes are in place, like the slots of PacketQueue.
+typedef struct AudioRing{
+    uint8_t *data; //'capacity' bytes, allocated once
+    size_t capacity; //power of 2
+
+    //head & tail keep growing, byte index is (x & (capacity-1))
+    char pad0[CACHE_LINE_SIZE];
+    volatile long head; //next byte to read (written by consumer only)
+    char pad1[CACHE_LINE_SIZE - sizeof(long)];
+    volatile long tail; //next byte to write (written by producer only)
+    char pad2[CACHE_LINE_SIZE - sizeof(long)];
+
+    //in-band flush: the producer can't move head, it marks where the stale data ends
+    volatile long discard; //position up to which the data is stale (written by producer only)
+    volatile long discards; //bumped with 'discard' (written by producer only)
+    long discards_seen; //consumer's copy of 'discards'
+}AudioRing;
+
+/** allocate a ring holding at least min_capacity bytes */
+int audio_ring_init(AudioRing *r, size_t min_capacity);
+
+/** release everything allocated by audio_ring_init() */
+void audio_ring_free(AudioRing *r);
+
+/** bytes ready to be read */
+static inline size_t audio_ring_used(AudioRing *r){
+    return (size_t)((unsigned long)os_atomic_load_long(&r->tail) - (unsigned long)os_atomic_load_long(&r->head));
+}
+
+/** bytes that can be written */
+static inline size_t audio_ring_avail(AudioRing *r){
+    return r->capacity - audio_ring_used(r);
+}
+
+/** producer: copy up to 'size' bytes in, return bytes written */
+size_t audio_ring_write(AudioRing *r, const void *data, size_t size);
+
+/** consumer: copy up to 'size' bytes out ('data' NULL: skip them), return bytes read */
+size_t audio_ring_read(AudioRing *r, void *data, size_t size);
+
+/** consumer: point 'data' at the bytes ready to be read, without copying them.
+    return how many are contiguous there (the rest, if any, wraps to the start of the ring).
+    release them with audio_ring_read(r, NULL, size) */
+size_t audio_ring_peek(AudioRing *r, const uint8_t **data);
+
+/** consumer: audio_ring_peek() in whole frames of 'frame_bytes'. the capacity is a power of 2, so frames that
+    don't divide it (5.1) get split by the end of the ring: such a frame is put together in 'split'
+    ('frame_bytes' long) and *data points there. 0 if not a whole frame is ready.
+    release them with audio_ring_read(r, NULL, size) */
+size_t audio_ring_peek_frames(AudioRing *r, const uint8_t **data, size_t frame_bytes, uint8_t *split);
+
+/** producer: everything written so far is stale, the consumer skips it in audio_ring_skip_stale() */
+void audio_ring_discard(AudioRing *r);
+
+/** consumer: skip what audio_ring_discard() marked stale.
+    return true if audio_ring_discard() was called since the last time */
+bool audio_ring_skip_stale(AudioRing *r);
+
+/** empty the ring (NOTE: neither side may run concurrently) */
+void audio_ring_reset(AudioRing *r);
@@ -0,0 +1,256 @@
+#include "c99defs.h"
+
+#include <SDL.h>
+
+#include "silly_player_internal.h"
+#include "silly_player.h"
+
+#include "util/bmem.h"
+#include "util/circlebuf.h"
+#include "util/platform.h"
+#include "util/threading.h"
+
+//one file waiting for a worker
+struct batch_job {
+	char *filename;
+	void *file_userdata;
+	long index;
+};
+
+//a pool of workers, each owning one headless player (and so its own format, codec & swr contexts).
+//files wait in 'jobs' until a worker is free, at most 'max_inflight' of them are queued or decoding.
+struct silly_batch {
+	silly_batch_params params;
+
+	pthread_t *workers;
+	int nb_workers;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t cond_job;		//workers: a job was queued (or we are quitting)
+	pthread_cond_t cond_done;		//submitters & waiters: a job is done
+	struct circlebuf jobs;			//struct batch_job, waiting for a worker
+	int inflight;					//queued + decoding
+	long submitted;
+	bool quit;
+
+	pthread_mutex_t result_mutex;	//result callbacks never run concurrently
+};
+
+//handed to silly_player_decode() while one file is decoded
+struct batch_decode_ctx {
+	silly_batch_t *batch;
+	silly_batch_result *result;
+};
+
+static int batch_on_pcm(void *userdata, const uint8_t *pcm, int size)
+{
+	struct batch_decode_ctx *ctx = (struct batch_decode_ctx *)userdata;
+
+	ctx->result->bytes += size;
+	if (ctx->batch->params.on_pcm)
+		return ctx->batch->params.on_pcm(ctx->batch->params.userdata, ctx->result, pcm, size);
+	return 0;
+}
+
+static void batch_decode_file(silly_batch_t *batch, silly_player_t *player, struct batch_job *job)
+{
+	silly_batch_result result;
+	struct batch_decode_ctx ctx;
+	uint64_t start = os_gettime_ns();
+	int bytes_per_second;
+
+	memset(&result, 0, sizeof(result));
+	result.filename = job->filename;
+	result.file_userdata = job->file_userdata;
+	result.index = job->index;
+
+	if (!player) {
+		result.status = -1;
+	} else if ((result.status = silly_player_open_headless(player, job->filename, &batch->params.spec, &result.spec)) == 0) {
+		ctx.batch = batch;
+		ctx.result = &result;
+		result.status = silly_player_decode(player, batch_on_pcm, &ctx);
+		silly_player_close(player);
+
+		bytes_per_second = result.spec.samplerate
+			* SA_CH_LAYOUT_CHANNELS(result.spec.channels)
+			* (result.spec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+		if (bytes_per_second > 0)
+			result.duration = (double)result.bytes / bytes_per_second;
+	}
+	result.decode_time = (double)(os_gettime_ns() - start) / 1000000000.0;
+
+	if (batch->params.on_result) {
+		pthread_mutex_lock(&batch->result_mutex);
+		batch->params.on_result(batch->params.userdata, &result);
+		pthread_mutex_unlock(&batch->result_mutex);
+	}
+}
+
+static void *batch_worker(void *arg)
+{
+	silly_batch_t *batch = (silly_batch_t *)arg;
+	silly_player_t *player;
+	struct batch_job job;
+
+	os_set_thread_name("silly_batch_worker");
+
+	//created once, reused for every file this worker decodes
+	player = silly_player_create();
+	if (!player)
+		fprintf(stderr, "silly_batch: could not create a player, files of this worker will fail.\n");
+
+	for (;;) {
+		pthread_mutex_lock(&batch->mutex);
+		while (!batch->jobs.size && !batch->quit)
+			pthread_cond_wait(&batch->cond_job, &batch->mutex);
+		if (!batch->jobs.size) { //quitting & nothing left
+			pthread_mutex_unlock(&batch->mutex);
+			break;
+		}
+		circlebuf_pop_front(&batch->jobs, &job, sizeof(job));
+		pthread_mutex_unlock(&batch->mutex);
+
+		batch_decode_file(batch, player, &job);
+		bfree(job.filename);
+
+		pthread_mutex_lock(&batch->mutex);
+		--batch->inflight;
+		pthread_cond_broadcast(&batch->cond_done);
+		pthread_mutex_unlock(&batch->mutex);
+	}
+
+	silly_player_destroy(player);
+	return NULL;
+}
+
+//create a batch decoder and start its workers
+//@param[in] params: see silly_batch_params
+//return the batch, NULL on error
+silly_batch_t *silly_batch_create(const silly_batch_params *params)
+{
+	silly_batch_t *batch;
+	int i;
+
+	if (!params)
+		return NULL;
+
+	batch = bzalloc(sizeof(silly_batch_t));
+	batch->params = *params;
+	if (batch->params.workers <= 0)
+		batch->params.workers = SDL_GetCPUCount();
+	if (batch->params.max_inflight <= 0)
+		batch->params.max_inflight = batch->params.workers * 2;
+
+	pthread_mutex_init_value(&batch->mutex);
+	pthread_mutex_init_value(&batch->result_mutex);
+	if (pthread_mutex_init(&batch->mutex, NULL) != 0
+		|| pthread_mutex_init(&batch->result_mutex, NULL) != 0
+		|| pthread_cond_init(&batch->cond_job, NULL) != 0
+		|| pthread_cond_init(&batch->cond_done, NULL) != 0) {
+		fprintf(stderr, "silly_batch: could not create locks.\n");
+		bfree(batch);
+		return NULL;
+	}
+	circlebuf_init(&batch->jobs);
+
+	batch->workers = bzalloc(batch->params.workers * sizeof(pthread_t));
+	for (i = 0; i < batch->params.workers; ++i) {
+		if (pthread_create(&batch->workers[i], NULL, batch_worker, batch) != 0) {
+			fprintf(stderr, "silly_batch: could not create worker %d.\n", i);
+			break;
+		}
+		++batch->nb_workers;
+	}
+
+	if (!batch->nb_workers) {
+		silly_batch_destroy(batch);
+		return NULL;
+	}
+
+	return batch;
+}
+
+//queue a file, blocks while 'max_inflight' files are queued or decoding
+//@param[in] filename: audio to be decoded
+//@param[in] file_userdata: handed back in silly_batch_result
+//return the index of the file (submission order), negative on error
+long silly_batch_submit(silly_batch_t *batch, const char *filename, void *file_userdata)
+{
+	struct batch_job job;
+
+	if (!batch) return -1;
+	if (!filename || !*filename) return -2;
+
+	job.filename = bstrdup(filename);
+	job.file_userdata = file_userdata;
+
+	pthread_mutex_lock(&batch->mutex);
+	while (batch->inflight >= batch->params.max_inflight)
+		pthread_cond_wait(&batch->cond_done, &batch->mutex);
+
+	job.index = batch->submitted++;
+	circlebuf_push_back(&batch->jobs, &job, sizeof(job));
+	++batch->inflight;
+	pthread_cond_signal(&batch->cond_job);
+	pthread_mutex_unlock(&batch->mutex);
+
+	return job.index;
+}
+
+//block until every file submitted so far is done
+void silly_batch_wait(silly_batch_t *batch)
+{
+	if (!batch) return;
+
+	pthread_mutex_lock(&batch->mutex);
+	while (batch->inflight > 0)
+		pthread_cond_wait(&batch->cond_done, &batch->mutex);
+	pthread_mutex_unlock(&batch->mutex);
+}
+
+//finish the files submitted, stop the workers and free the batch
+void silly_batch_destroy(silly_batch_t *batch)
+{
+	int i;
+
+	if (!batch) return;
+
+	pthread_mutex_lock(&batch->mutex);
+	batch->quit = true;
+	pthread_cond_broadcast(&batch->cond_job);
+	pthread_mutex_unlock(&batch->mutex);
+
+	for (i = 0; i < batch->nb_workers; ++i)
+		pthread_join(batch->workers[i], NULL);
+
+	circlebuf_free(&batch->jobs);
+	pthread_cond_destroy(&batch->cond_done);
+	pthread_cond_destroy(&batch->cond_job);
+	pthread_mutex_destroy(&batch->result_mutex);
+	pthread_mutex_destroy(&batch->mutex);
+	bfree(batch->workers);
+	bfree(batch);
+}
+
+//decode a list of files on a worker pool and wait for all of them
+//@param[in] filenames: files to be decoded, file_userdata of each is NULL
+//@param[in] count: number of files
+//@param[in] params: see silly_batch_params
+//return 0 on success, negative on error (failures of single files are reported through on_result)
+int silly_batch_decode(const char **filenames, int count, const silly_batch_params *params)
+{
+	silly_batch_t *batch;
+	int i;
+
+	if (!filenames || count < 0) return -1;
+
+	batch = silly_batch_create(params);
+	if (!batch) return -2;
+
+	for (i = 0; i < count; ++i)
+		silly_batch_submit(batch, filenames[i], NULL);
+
+	silly_batch_destroy(batch);
+	return 0;
+}
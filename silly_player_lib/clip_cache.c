@@ -0,0 +1,310 @@
+#include "c99defs.h"
+
+#include <sys/stat.h>
+
+#include "clip_cache.h"
+#include "silly_player_internal.h"
+#include "silly_player.h"
+
+#include "util/bmem.h"
+#include "util/darray.h"
+#include "util/platform.h"
+#include "util/threading.h"
+
+//short files decoded once to PCM (the format of the device playing them), so playing one costs no
+//demuxer, no decoder and no thread. bounded by 'budget' bytes, the least recently used clips go first.
+//a clip is keyed by its path & mtime: a file changed on disk is decoded again.
+struct silly_clip_cache {
+	silly_audiospec spec;
+	size_t budget;
+
+	pthread_mutex_t mutex;			//guards the list & the counters
+	struct silly_clip *first;		//most recently used
+	struct silly_clip *last;		//evicted first
+	size_t used;					//bytes of the cached clips
+	int count;
+	long hits;
+	long misses;
+	long evictions;
+
+	pthread_mutex_t decode_mutex;	//guards 'decoder', a miss doesn't hold up the hits
+	silly_player_t *decoder;		//headless, reused for every miss
+};
+
+typedef DARRAY(uint8_t) clip_buffer;
+
+//handed to silly_player_decode() while a clip is decoded
+struct clip_decoding {
+	clip_buffer buffer;
+	size_t budget;
+	bool over_budget;
+};
+
+void clip_addref(struct silly_clip *clip)
+{
+	os_atomic_inc_long(&clip->refs);
+}
+
+//drop a reference to a clip, the last one frees it
+void silly_clip_release(silly_clip_t *clip)
+{
+	if (!clip)
+		return;
+	if (os_atomic_dec_long(&clip->refs) > 0)
+		return;
+
+	bfree(clip->filename);
+	bfree(clip->data);
+	bfree(clip);
+}
+
+//get the length of a clip in seconds
+double silly_clip_duration(silly_clip_t *clip)
+{
+	if (!clip || clip->spec.samplerate <= 0)
+		return 0.0;
+	return (double)clip->frames / clip->spec.samplerate;
+}
+
+//stop the decoder as soon as the clip can't fit, a long file is not decoded as a whole to be rejected
+static int clip_on_pcm(void *userdata, const uint8_t *pcm, int size)
+{
+	struct clip_decoding *dec = (struct clip_decoding *)userdata;
+
+	if (dec->buffer.num + size > dec->budget) {
+		dec->over_budget = true;
+		return 1;
+	}
+	darray_push_back_array(sizeof(uint8_t), &dec->buffer.da, pcm, size);
+	return 0;
+}
+
+//decode 'filename' as a whole. return the clip (one reference, not cached yet), NULL on error
+static struct silly_clip *clip_decode(silly_clip_cache_t *cache, const char *filename, time_t mtime)
+{
+	struct silly_clip *clip = NULL;
+	silly_audiospec obtained;
+	struct clip_decoding dec;
+	int frame_bytes;
+	int ret;
+
+	da_init(dec.buffer);
+	dec.budget = cache->budget;
+	dec.over_budget = false;
+
+	pthread_mutex_lock(&cache->decode_mutex);
+	ret = silly_player_open_headless(cache->decoder, filename, &cache->spec, &obtained);
+	if (ret == 0) {
+		ret = silly_player_decode(cache->decoder, clip_on_pcm, &dec);
+		silly_player_close(cache->decoder);
+	}
+	pthread_mutex_unlock(&cache->decode_mutex);
+
+	if (dec.over_budget) {
+		fprintf(stderr, "%s: clip exceeds the cache budget of " SIZE_T_FORMAT " bytes.\n", filename, cache->budget);
+		goto done;
+	}
+	if (ret != 0) {
+		fprintf(stderr, "%s: could not decode the clip (%d).\n", filename, ret);
+		goto done;
+	}
+
+	frame_bytes = SA_CH_LAYOUT_CHANNELS(obtained.channels) * (obtained.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+
+	clip = bzalloc(sizeof(struct silly_clip));
+	clip->filename = bstrdup(filename);
+	clip->mtime = mtime;
+	clip->spec = obtained;
+	clip->size = dec.buffer.num;
+	clip->frames = (int)(dec.buffer.num / frame_bytes);
+	clip->data = dec.buffer.array; //taken over
+	clip->refs = 1;
+	da_init(dec.buffer);
+
+done:
+	da_free(dec.buffer);
+	return clip;
+}
+
+static void clip_unlink(silly_clip_cache_t *cache, struct silly_clip *clip)
+{
+	if (clip->prev) clip->prev->next = clip->next;
+	else cache->first = clip->next;
+	if (clip->next) clip->next->prev = clip->prev;
+	else cache->last = clip->prev;
+	clip->prev = clip->next = NULL;
+}
+
+static void clip_push_front(silly_clip_cache_t *cache, struct silly_clip *clip)
+{
+	clip->prev = NULL;
+	clip->next = cache->first;
+	if (cache->first) cache->first->prev = clip;
+	else cache->last = clip;
+	cache->first = clip;
+}
+
+static struct silly_clip *clip_find(silly_clip_cache_t *cache, const char *filename)
+{
+	struct silly_clip *clip;
+
+	for (clip = cache->first; clip; clip = clip->next) {
+		if (strcmp(clip->filename, filename) == 0)
+			return clip;
+	}
+	return NULL;
+}
+
+//most recently used now, one more reference for the caller
+static void clip_hit(silly_clip_cache_t *cache, struct silly_clip *clip)
+{
+	clip_unlink(cache, clip);
+	clip_push_front(cache, clip);
+	clip_addref(clip);
+}
+
+//drop the cache's reference. clips still playing (or held by callers) live on outside the budget
+//@param[in,out] evicted: appended to, released by the caller once the mutex is unlocked
+static void clip_evict(silly_clip_cache_t *cache, struct silly_clip *clip, struct silly_clip **evicted)
+{
+	clip_unlink(cache, clip);
+	cache->used -= clip->size;
+	--cache->count;
+	++cache->evictions;
+
+	clip->next = *evicted;
+	*evicted = clip;
+}
+
+static void clip_release_list(struct silly_clip *list)
+{
+	while (list) {
+		struct silly_clip *next = list->next;
+
+		list->next = NULL;
+		silly_clip_release(list);
+		list = next;
+	}
+}
+
+//create a clip cache
+//@param[in] spec: format the clips are decoded to, the spec obtained from the device playing them
+//			(silly_mixer_create()): spec.samplerate 0 keeps the rate of every file, samples is UNUSED
+//@param[in] budget: bytes of PCM kept at most
+//return the cache, NULL on error
+silly_clip_cache_t *silly_clip_cache_create(const silly_audiospec *spec, int64_t budget)
+{
+	silly_clip_cache_t *cache;
+
+	if (!spec || budget <= 0)
+		return NULL;
+
+	cache = bzalloc(sizeof(silly_clip_cache_t));
+	cache->spec = *spec;
+	cache->budget = (size_t)budget;
+
+	cache->decoder = silly_player_create();
+	if (!cache->decoder) {
+		bfree(cache);
+		return NULL;
+	}
+
+	pthread_mutex_init(&cache->mutex, NULL);
+	pthread_mutex_init(&cache->decode_mutex, NULL);
+	return cache;
+}
+
+//destroy a clip cache, clips still referenced stay valid until released
+void silly_clip_cache_destroy(silly_clip_cache_t *cache)
+{
+	struct silly_clip *evicted = NULL;
+
+	if (!cache)
+		return;
+
+	while (cache->first)
+		clip_evict(cache, cache->first, &evicted);
+	clip_release_list(evicted);
+
+	silly_player_destroy(cache->decoder);
+	pthread_mutex_destroy(&cache->mutex);
+	pthread_mutex_destroy(&cache->decode_mutex);
+	bfree(cache);
+}
+
+//get a clip, decoding the file on a miss (or when it changed on disk)
+//@param[in] filename: audio to be decoded, short files only: larger than the budget fails
+//return the clip (release it with silly_clip_release()), NULL on error
+silly_clip_t *silly_clip_cache_get(silly_clip_cache_t *cache, const char *filename)
+{
+	struct silly_clip *clip, *decoded;
+	struct silly_clip *evicted = NULL;
+	struct stat st;
+
+	if (!cache || !filename || !*filename)
+		return NULL;
+	if (os_stat(filename, &st) != 0) {
+		fprintf(stderr, "%s: no such file.\n", filename);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&cache->mutex);
+	clip = clip_find(cache, filename);
+	if (clip && clip->mtime == st.st_mtime) {
+		clip_hit(cache, clip);
+		++cache->hits;
+		pthread_mutex_unlock(&cache->mutex);
+		return clip;
+	}
+	if (clip) //stale
+		clip_evict(cache, clip, &evicted);
+	++cache->misses;
+	pthread_mutex_unlock(&cache->mutex);
+	clip_release_list(evicted);
+	evicted = NULL;
+
+	decoded = clip_decode(cache, filename, st.st_mtime);
+	if (!decoded)
+		return NULL;
+
+	pthread_mutex_lock(&cache->mutex);
+	clip = clip_find(cache, filename);
+	if (clip && clip->mtime == st.st_mtime) {
+		//another thread decoded it meanwhile
+		clip_hit(cache, clip);
+	} else {
+		if (clip)
+			clip_evict(cache, clip, &evicted);
+
+		while (cache->last && cache->used + decoded->size > cache->budget)
+			clip_evict(cache, cache->last, &evicted);
+
+		clip = decoded;
+		decoded = NULL;
+		clip_push_front(cache, clip);
+		cache->used += clip->size;
+		++cache->count;
+		clip_addref(clip); //the cache's + the caller's
+	}
+	pthread_mutex_unlock(&cache->mutex);
+
+	clip_release_list(evicted);
+	silly_clip_release(decoded);
+	return clip;
+}
+
+//get the state of the cache
+void silly_clip_cache_stats(silly_clip_cache_t *cache, silly_clipcachestats *stats)
+{
+	if (!cache || !stats)
+		return;
+
+	pthread_mutex_lock(&cache->mutex);
+	stats->clips = cache->count;
+	stats->bytes = (int64_t)cache->used;
+	stats->budget = (int64_t)cache->budget;
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	stats->evictions = cache->evictions;
+	pthread_mutex_unlock(&cache->mutex);
+}
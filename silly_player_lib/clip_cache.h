@@ -0,0 +1,22 @@
+#pragma once
+
+#include <time.h>
+
+#include "silly_player_internal.h"
+
+//a file decoded once to the cache's format. refcounted: the cache holds one reference while
+//the clip is cached, every caller of silly_clip_cache_get() and every playback one more
+struct silly_clip {
+	char *filename;
+	time_t mtime;				//of the file when decoded: a newer file is decoded again
+	silly_audiospec spec;
+	uint8_t *data;
+	size_t size;				//bytes
+	int frames;
+	volatile long refs;
+
+	struct silly_clip *prev;	//LRU list of the cache, most recently used first
+	struct silly_clip *next;
+};
+
+void clip_addref(struct silly_clip *clip);
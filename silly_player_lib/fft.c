@@ -0,0 +1,130 @@
+#include <math.h>
+#include <string.h>
+
+#include "c99defs.h"
+#include "fft.h"
+
+#include "util/bmem.h"
+
+//real FFT of 'size' frames: the even & odd frames are packed as one complex signal of size / 2 points,
+//transformed, then split into the spectrum of the real input (one extra O(n) pass).
+//the complex transform is iterative decimation in time: the window is applied while the input is
+//loaded in bit-reversed order, then radix-4 passes (plus one radix-2 pass if log2 is odd) run on
+//the FFT kernels of sample_conv.c, which vectorize over the butterflies of a block.
+#define FFT_PI 3.14159265358979
+
+//W(n)^k = exp(-2 pi i k / n)
+static inline void fft_twiddle(float *re, float *im, int k, int n)
+{
+	*re = (float)cos(2.0 * FFT_PI * k / n);
+	*im = (float)-sin(2.0 * FFT_PI * k / n);
+}
+
+int fft_init(RealFFT *fft, int size)
+{
+	int bits = 0, i, k, h, b;
+	float *w;
+
+	memset(fft, 0, sizeof(*fft));
+	if (size < FFT_SIZE_MIN || size > FFT_SIZE_MAX || (size & (size - 1)))
+		return -1;
+
+	fft->kernels = sample_kernels();
+	fft->size = size;
+	fft->half = size / 2;
+	while ((1 << bits) < fft->half)
+		++bits;
+	fft->bits = bits;
+
+	fft->window = bmalloc(sizeof(float) * size);
+	for (i = 0; i < size; ++i)
+		fft->window[i] = (float)(0.5 - 0.5 * cos(2.0 * FFT_PI * i / size));
+
+	fft->rev = bmalloc(sizeof(int) * fft->half);
+	for (i = 0; i < fft->half; ++i) {
+		for (k = 0, b = 0; b < bits; ++b)
+			k |= ((i >> b) & 1) << (bits - 1 - b);
+		fft->rev[i] = k;
+	}
+
+	//per pass, in the order they run: radix 2 (h = 1): w[1] re, im; radix 4 (span h): w1[h] re, im, w2[h] re, im.
+	//less than 2 * half in all
+	fft->twiddle = w = bmalloc(sizeof(float) * 4 * fft->half);
+	h = 1;
+	if (bits & 1) {
+		fft_twiddle(w, w + 1, 0, 2);
+		w += 2;
+		h = 2;
+	}
+	for (; h < fft->half; h *= 4) {
+		for (k = 0; k < h; ++k) {
+			fft_twiddle(w + k, w + h + k, k, 2 * h);
+			fft_twiddle(w + 2 * h + k, w + 3 * h + k, k, 4 * h);
+		}
+		w += 4 * h;
+	}
+
+	fft->post_re = bmalloc(sizeof(float) * fft->half);
+	fft->post_im = bmalloc(sizeof(float) * fft->half);
+	for (k = 0; k < fft->half; ++k)
+		fft_twiddle(fft->post_re + k, fft->post_im + k, k, size);
+
+	fft->re = bmalloc(sizeof(float) * fft->half);
+	fft->im = bmalloc(sizeof(float) * fft->half);
+	return 0;
+}
+
+void fft_free(RealFFT *fft)
+{
+	bfree(fft->window);
+	bfree(fft->rev);
+	bfree(fft->twiddle);
+	bfree(fft->post_re);
+	bfree(fft->post_im);
+	bfree(fft->re);
+	bfree(fft->im);
+	memset(fft, 0, sizeof(*fft));
+}
+
+size_t fft_bytes(int size)
+{
+	size_t half = size / 2;
+
+	//window: size, rev: half, twiddle: 4 half, post_re & post_im, re & im: half each
+	return sizeof(float) * (size + 8 * half) + sizeof(int) * half;
+}
+
+void fft_power(RealFFT *fft, const float *src, float *power)
+{
+	const float *w = fft->twiddle;
+	float *re = fft->re, *im = fft->im;
+	int n = fft->half, h = 1, i, k;
+
+	//z[i] = x[2i] + i x[2i + 1], windowed, bit-reversed
+	for (i = 0; i < n; ++i) {
+		re[fft->rev[i]] = src[2 * i] * fft->window[2 * i];
+		im[fft->rev[i]] = src[2 * i + 1] * fft->window[2 * i + 1];
+	}
+
+	if (fft->bits & 1) {
+		//log2(n) odd: one radix-2 pass first
+		fft->kernels->fft_radix2_flt(re, im, n, 1, w, w + 1);
+		w += 2;
+		h = 2;
+	}
+	for (; h < n; h *= 4) {
+		fft->kernels->fft_radix4_flt(re, im, n, h, w, w + h, w + 2 * h, w + 3 * h);
+		w += 4 * h;
+	}
+
+	//X[k] = E[k] + W(size)^k O[k], E & O: spectra of the even & odd frames, out of Z[k] & Z[n - k]
+	for (k = 0; k <= n; ++k) {
+		int a = k % n, b = (n - k) % n;
+		float er = 0.5f * (re[a] + re[b]), ei = 0.5f * (im[a] - im[b]);
+		float odd_r = 0.5f * (im[a] + im[b]), odd_i = 0.5f * (re[b] - re[a]);
+		float c = k < n ? fft->post_re[k] : -1.0f, s = k < n ? fft->post_im[k] : 0.0f;
+		float xr = er + c * odd_r - s * odd_i;
+		float xi = ei + c * odd_i + s * odd_r;
+		power[k] = xr * xr + xi * xi;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "c99defs.h"
+#include "sample_conv.h"
+
+#define FFT_SIZE_MIN 512
+#define FFT_SIZE_MAX 8192
+
+//Hann windowed power spectrum of real input, see fft.c
+typedef struct RealFFT{
+	const SampleKernels *kernels;
+	int size;			//real input frames, a power of 2
+	int half;			//complex points transformed: size / 2
+	int bits;			//log2(half)
+
+	float *window;		//Hann, 'size'
+	int *rev;			//bit reversal of 'half' points
+	float *twiddle;		//every pass, re then im (see fft_init())
+	float *post_re;		//W(size)^k: splits the half-size transform into the real one
+	float *post_im;
+	float *re;			//work
+	float *im;
+}RealFFT;
+
+/** 'size': a power of 2, FFT_SIZE_MIN .. FFT_SIZE_MAX */
+int fft_init(RealFFT *fft, int size);
+void fft_free(RealFFT *fft);
+
+/** bytes fft_init() allocates for 'size' */
+size_t fft_bytes(int size);
+
+/** power |X[k]|^2 of bins 0 .. size / 2 (size / 2 + 1 of them) of 'size' frames of 'src', windowed */
+void fft_power(RealFFT *fft, const float *src, float *power);
@@ -1,5 +1,52 @@
-/** global variables shared by multiple files are defined here. **/
-volatile int global_exit;
-volatile int global_exit_parse;
-volatile int active;
-volatile int pause_on;
\ No newline at end of file
+/** process-wide state shared by all player instances is defined here. **/
+#include <libavformat/avformat.h>
+#include <SDL.h>
+
+#include "silly_player_internal.h"
+#include "util/threading.h"
+
+static pthread_mutex_t global_mutex = PTHREAD_MUTEX_INITIALIZER;
+static long global_refs = 0;
+
+//first caller registers formats & codecs
+int silly_global_init()
+{
+	pthread_mutex_lock(&global_mutex);
+	if (global_refs++ == 0)
+		av_register_all();
+	pthread_mutex_unlock(&global_mutex);
+
+	return 0;
+}
+
+void silly_global_uninit()
+{
+	pthread_mutex_lock(&global_mutex);
+	if (global_refs > 0)
+		--global_refs;
+	pthread_mutex_unlock(&global_mutex);
+}
+
+//the SDL audio subsystem is only brought up for instances that open a device,
+//headless instances work without any audio driver.
+//SDL refcounts Init/QuitSubSystem itself, we only serialize the calls
+int silly_global_audio_init()
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&global_mutex);
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+		fprintf(stderr, "SDL_InitSubSystem(): %s.\n", SDL_GetError());
+		ret = -1;
+	}
+	pthread_mutex_unlock(&global_mutex);
+
+	return ret;
+}
+
+void silly_global_audio_uninit()
+{
+	pthread_mutex_lock(&global_mutex);
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	pthread_mutex_unlock(&global_mutex);
+}
@@ -0,0 +1,207 @@
+#include <math.h>
+#include <string.h>
+
+#include "c99defs.h"
+#include "meter.h"
+
+#include "util/bmem.h"
+#include "util/threading.h"
+
+//level meters computed by the decoder on the PCM it hands out anyway, so nobody has to fetch
+//the stream just to draw a meter. blocks of 100 ms: sample peak & RMS of each channel, and the
+//EBU R128 loudness (ITU-R BS.1770 K-weighting, mean square over 400 ms / 3 s, ungated).
+//peak & squares run on the levels kernel of sample_conv.c; the K-weighting filters are recursive,
+//they run sample by sample (10 multiplications a sample).
+#define METER_PI 3.14159265358979
+#define METER_SCRATCH_FRAMES 1024
+
+//filter coefficients of BS.1770 for any samplerate (the standard gives them at 48 kHz only)
+static void meter_kweighting(LevelMeter *m)
+{
+	double f0 = 1681.974450955533, gain = 3.999843853973347, q = 0.7071752369554196;
+	double k = tan(METER_PI * f0 / m->samplerate);
+	double vh = pow(10.0, gain / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+
+	m->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+	m->shelf.b1 = 2.0 * (k * k - vh) / a0;
+	m->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+	m->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+	m->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = tan(METER_PI * f0 / m->samplerate);
+	a0 = 1.0 + k / q + k * k;
+	m->highpass.b0 = 1.0;
+	m->highpass.b1 = -2.0;
+	m->highpass.b2 = 1.0;
+	m->highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+	m->highpass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+//start over (open, seek): no history, filters at rest
+static void meter_reset(LevelMeter *m)
+{
+	memset(m->state, 0, sizeof(m->state));
+	memset(m->peak, 0, sizeof(m->peak));
+	memset(m->sum, 0, sizeof(m->sum));
+	memset(m->weighted, 0, sizeof(m->weighted));
+	m->block_pos = 0;
+	m->block_next = 0;
+	m->block_count = 0;
+}
+
+int meter_init(LevelMeter *m, int samplerate, int channels, bool s16)
+{
+	memset(m, 0, sizeof(*m));
+	if (samplerate <= 0 || channels < 1 || channels > 2)
+		return -1;
+
+	m->kernels = sample_kernels();
+	m->samplerate = samplerate;
+	m->channels = channels;
+	m->s16 = s16;
+	m->block_frames = samplerate * METER_BLOCK_MS / 1000;
+	m->scratch = bmalloc(sizeof(float) * METER_SCRATCH_FRAMES * channels);
+	m->levels.channels = channels;
+	meter_kweighting(m);
+	meter_reset(m);
+	return 0;
+}
+
+void meter_free(LevelMeter *m)
+{
+	bfree(m->scratch);
+	memset(m, 0, sizeof(*m));
+}
+
+static inline double meter_biquad(const MeterBiquad *f, double *z, double x)
+{
+	double y = f->b0 * x + z[0];
+	z[0] = f->b1 * x - f->a1 * y + z[1];
+	z[1] = f->b2 * x - f->a2 * y;
+	return y;
+}
+
+static float meter_db(double power)
+{
+	double db = power > 0.0 ? 10.0 * log10(power) : SILLY_LEVELS_FLOOR;
+	return db < SILLY_LEVELS_FLOOR ? SILLY_LEVELS_FLOOR : (float)db;
+}
+
+//loudness of the mean of the last 'count' blocks
+static float meter_loudness(LevelMeter *m, int count)
+{
+	double sum = 0.0;
+	int i;
+
+	count = min(count, m->block_count);
+	for (i = 1; i <= count; ++i)
+		sum += m->blocks[(m->block_next - i + METER_SHORT_TERM_BLOCKS) % METER_SHORT_TERM_BLOCKS];
+	return count ? meter_db(sum / count) - 0.691f : SILLY_LEVELS_FLOOR;
+}
+
+//a block is complete: keep its loudness & publish the snapshot
+static void meter_publish(LevelMeter *m, double clock)
+{
+	double power = 0.0;
+	int ch;
+
+	for (ch = 0; ch < m->channels; ++ch)
+		power += m->weighted[ch] / m->block_frames; //BS.1770: every channel of mono/stereo weighs 1
+	m->blocks[m->block_next] = power;
+	m->block_next = (m->block_next + 1) % METER_SHORT_TERM_BLOCKS;
+	if (m->block_count < METER_SHORT_TERM_BLOCKS)
+		++m->block_count;
+
+	os_atomic_inc_long(&m->seq);
+	for (ch = 0; ch < m->channels; ++ch) {
+		m->levels.peak[ch] = meter_db((double)m->peak[ch] * m->peak[ch]);
+		m->levels.rms[ch] = meter_db(m->sum[ch] / m->block_frames);
+	}
+	m->levels.momentary = meter_loudness(m, METER_MOMENTARY_BLOCKS);
+	m->levels.short_term = meter_loudness(m, METER_SHORT_TERM_BLOCKS);
+	m->levels.clock = clock;
+	++m->levels.blocks;
+	os_atomic_inc_long(&m->seq);
+
+	memset(m->peak, 0, sizeof(m->peak));
+	memset(m->sum, 0, sizeof(m->sum));
+	memset(m->weighted, 0, sizeof(m->weighted));
+	m->block_pos = 0;
+}
+
+//'frames' frames of float PCM, all in the current block
+static void meter_measure(LevelMeter *m, float *pcm, int frames)
+{
+	float sum[2] = { 0.0f, 0.0f };
+	float ignored[2] = { 0.0f, 0.0f };
+	int i, ch;
+
+	m->kernels->levels_flt(pcm, frames, m->channels, m->peak, sum);
+	for (ch = 0; ch < m->channels; ++ch) {
+		m->sum[ch] += sum[ch];
+		sum[ch] = 0.0f;
+	}
+
+	//K-weighted in place (pcm is our scratch), then squared by the kernel again
+	for (i = 0; i < frames; ++i) {
+		for (ch = 0; ch < m->channels; ++ch) {
+			double x = pcm[i * m->channels + ch];
+			x = meter_biquad(&m->shelf, m->state[ch], x);
+			pcm[i * m->channels + ch] = (float)meter_biquad(&m->highpass, m->state[ch] + 2, x);
+		}
+	}
+	m->kernels->levels_flt(pcm, frames, m->channels, ignored, sum);
+	for (ch = 0; ch < m->channels; ++ch)
+		m->weighted[ch] += sum[ch];
+}
+
+void meter_update(LevelMeter *m, const uint8_t *pcm, int size, long serial, double clock, float tempo)
+{
+	int frame_bytes = m->channels * (m->s16 ? 2 : 4);
+	int frames = size / frame_bytes;
+	int done = 0, n;
+
+	if (!m->scratch)
+		return;
+	if (serial != m->serial) {
+		meter_reset(m);
+		m->serial = serial;
+	}
+
+	while (done < frames) {
+		n = min(min(frames - done, METER_SCRATCH_FRAMES), m->block_frames - m->block_pos);
+		if (m->s16)
+			m->kernels->s16_to_flt(m->scratch, (const int16_t *)(pcm + (size_t)done * frame_bytes), n * m->channels);
+		else
+			memcpy(m->scratch, pcm + (size_t)done * frame_bytes, (size_t)n * frame_bytes);
+
+		meter_measure(m, m->scratch, n);
+		done += n;
+		m->block_pos += n;
+		if (m->block_pos >= m->block_frames)
+			meter_publish(m, clock + (double)done * tempo / m->samplerate);
+	}
+}
+
+bool meter_read(LevelMeter *m, silly_levels *levels)
+{
+	long seq;
+
+	do {
+		while ((seq = os_atomic_load_long(&m->seq)) & 1)
+			; //being written, a few stores
+		*levels = m->levels;
+		os_atomic_thread_fence_acquire();
+	} while (os_atomic_load_long(&m->seq) != seq);
+
+	return levels->blocks > 0;
+}
+
+size_t meter_bytes(const LevelMeter *m)
+{
+	return m->scratch ? sizeof(float) * METER_SCRATCH_FRAMES * m->channels : 0;
+}
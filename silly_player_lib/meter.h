@@ -0,0 +1,54 @@
+#pragma once
+
+#include "c99defs.h"
+#include "sample_conv.h"
+#include "silly_player_params.h"
+
+#define METER_BLOCK_MS 100
+#define METER_SHORT_TERM_BLOCKS 30	//3 s
+#define METER_MOMENTARY_BLOCKS 4	//400 ms
+
+//K-weighting of EBU R128: a high shelf then a high pass (transposed direct form II)
+typedef struct MeterBiquad{
+	double b0, b1, b2, a1, a2;
+}MeterBiquad;
+
+//peak, RMS & loudness of the decoded PCM, see meter.c
+typedef struct LevelMeter{
+	const SampleKernels *kernels;
+	int samplerate;
+	int channels;
+	bool s16;
+
+	MeterBiquad shelf;
+	MeterBiquad highpass;
+	double state[2][4];			//per channel: shelf z1 z2, high pass z1 z2
+
+	int block_frames;			//100 ms
+	int block_pos;				//frames of the current block measured
+	float peak[2];				//current block
+	double sum[2];				//... squares
+	double weighted[2];			//... K-weighted squares
+	double blocks[METER_SHORT_TERM_BLOCKS];	//mean square (K-weighted, channels summed) of the last blocks
+	int block_next;
+	int block_count;
+
+	float *scratch;				//a piece of the block converted / K-weighted
+	long serial;				//audioq serial measured: a seek starts over
+
+	//lock-free snapshot: 'seq' is odd while the decoder writes it, readers copy until it's even & unchanged
+	volatile long seq;
+	silly_levels levels;
+}LevelMeter;
+
+int meter_init(LevelMeter *m, int samplerate, int channels, bool s16);
+void meter_free(LevelMeter *m);
+
+/** decoder: measure 'size' bytes of PCM of audioq serial 'serial' starting at media time 'clock' (time-stretched by 'tempo') */
+void meter_update(LevelMeter *m, const uint8_t *pcm, int size, long serial, double clock, float tempo);
+
+/** any thread: copy the levels of the last block, false if there is none */
+bool meter_read(LevelMeter *m, silly_levels *levels);
+
+/** bytes allocated, 0 before meter_init() */
+size_t meter_bytes(const LevelMeter *m);
@@ -0,0 +1,309 @@
+#include "c99defs.h"
+
+#include <SDL.h>
+
+#include "audio.h"
+#include "clip_cache.h"
+#include "mixer.h"
+#include "sample_conv.h"
+#include "silly_player_internal.h"
+#include "silly_player.h"
+
+#include "util/bmem.h"
+#include "util/darray.h"
+#include "util/platform.h"
+
+#define MIXER_SAMPLERATE 48000 //when the caller doesn't ask for one
+
+//a cached clip being played (silly_mixer_play_clip()): read in place, nothing decoded
+struct mixer_clip {
+	struct silly_clip *clip;	//one reference
+	int frame;					//next frame to play
+	float left;					//volume & pan
+	float right;
+	bool done;					//played out, released by the next silly_mixer_play_clip()/silly_mixer_stats()
+};
+
+//one device summing any number of voices. each voice is a player decoding on its own threads
+//into its pcm_ring (in the mixer's format), the device callback only copies, scales & adds:
+//voice -> audio_callback() (volume, clock, fetching & taps) -> accumulate (pan) -> clip -> device
+struct silly_mixer {
+	SDL_AudioDeviceID dev;
+	SDL_AudioSpec spec;			//obtained, always AUDIO_F32SYS
+	silly_audiospec audiospec;	//the same, for the voices
+
+	DARRAY(VideoState *) voices;	//guarded by the device lock
+	DARRAY(struct mixer_clip) clips;	//the same
+
+	float *mix;					//callback: the sum, spec.size bytes
+	uint8_t *voice_buf;			//callback: one voice, spec.size bytes
+
+	//callback cost since the last silly_mixer_stats() (under the device lock)
+	long callbacks;
+	uint64_t callback_ns;
+	uint64_t callback_max_ns;
+};
+
+//balance: the far side fades out, the near side stays at unity
+static void mixer_pan_gains(float pan, float *left, float *right)
+{
+	*left = pan > 0.0f ? 1.0f - pan : 1.0f;
+	*right = pan < 0.0f ? 1.0f + pan : 1.0f;
+}
+
+static void mixer_callback(void *userdata, uint8_t *stream, int len)
+{
+	silly_mixer_t *mixer = (silly_mixer_t *)userdata;
+	const SampleKernels *kernels = sample_kernels();
+	int channels = mixer->spec.channels;
+	int frames = len / (int)(channels * sizeof(float));
+	uint64_t start = os_gettime_ns();
+	uint64_t ns;
+	size_t i;
+
+	if (len > (int)mixer->spec.size) { //never happens, SDL hands out spec.size bytes
+		SDL_memset(stream, 0, len);
+		return;
+	}
+
+	SDL_memset(mixer->mix, 0, len);
+	for (i = 0; i < mixer->voices.num; ++i) {
+		VideoState *voice = mixer->voices.array[i];
+		float left, right, left_to, right_to;
+		float pan = voice->pan;
+
+		if (!voice->active || voice->pause_on)
+			continue;
+
+		audio_callback(voice, mixer->voice_buf, len);
+
+		//a pan change ramps over this callback, like the volume
+		mixer_pan_gains(voice->pan_applied, &left, &right);
+		mixer_pan_gains(pan, &left_to, &right_to);
+		kernels->accumulate_flt(mixer->mix, (const float *)mixer->voice_buf, frames, channels,
+			left, right,
+			frames ? (left_to - left) / (float)frames : 0.0f,
+			frames ? (right_to - right) / (float)frames : 0.0f);
+		voice->pan_applied = pan;
+	}
+
+	for (i = 0; i < mixer->clips.num; ++i) {
+		struct mixer_clip *c = mixer->clips.array + i;
+		int n = min(frames, c->clip->frames - c->frame);
+
+		if (c->done)
+			continue;
+
+		kernels->accumulate_flt(mixer->mix, (const float *)c->clip->data + (size_t)c->frame * channels,
+			n, channels, c->left, c->right, 0.0f, 0.0f);
+		c->frame += n;
+		c->done = c->frame >= c->clip->frames;
+	}
+
+	//the sum is kept in float, saturated once on the way out
+	kernels->clip_flt((float *)stream, mixer->mix, len / (int)sizeof(float));
+
+	ns = os_gettime_ns() - start;
+	++mixer->callbacks;
+	mixer->callback_ns += ns;
+	if (ns > mixer->callback_max_ns)
+		mixer->callback_max_ns = ns;
+}
+
+const silly_audiospec *mixer_audiospec(struct silly_mixer *mixer)
+{
+	return &mixer->audiospec;
+}
+
+void mixer_device_spec(struct silly_mixer *mixer, SDL_AudioSpec *spec)
+{
+	*spec = mixer->spec;
+}
+
+void mixer_add_voice(struct silly_mixer *mixer, VideoState *voice)
+{
+	voice->pan_applied = voice->pan;
+
+	SDL_LockAudioDevice(mixer->dev);
+	da_push_back(mixer->voices, &voice);
+	SDL_UnlockAudioDevice(mixer->dev);
+}
+
+//once it returns the callback is done with 'voice'
+void mixer_remove_voice(struct silly_mixer *mixer, VideoState *voice)
+{
+	SDL_LockAudioDevice(mixer->dev);
+	da_erase_item(mixer->voices, &voice);
+	SDL_UnlockAudioDevice(mixer->dev);
+}
+
+//keep the callback (and audio_callback() of every voice) out until mixer_unlock()
+void mixer_lock(struct silly_mixer *mixer)
+{
+	SDL_LockAudioDevice(mixer->dev);
+}
+
+void mixer_unlock(struct silly_mixer *mixer)
+{
+	SDL_UnlockAudioDevice(mixer->dev);
+}
+
+//create a mixer: one audio device playing any number of voices at once (silly_player_open_voice())
+//@param[in] sa_desired: audio spec desired
+//			sa_desired.channels:	SA_CH_LAYOUT_MONO, SA_CH_LAYOUT_STEREO
+//			sa_desired.format:		UNUSED (voices are mixed in float)
+//			sa_desired.samplerate:	every voice is resampled to it (0: 48000)
+//			sa_desired.samples:		audio buffer size in samples (power of 2)
+//@param[out] sa_obtained: audio spec obtained
+//return the mixer, NULL on error
+silly_mixer_t *silly_mixer_create(const silly_audiospec *sa_desired, silly_audiospec *sa_obtained)
+{
+	silly_mixer_t *mixer;
+	SDL_AudioSpec desired_spec;
+
+	if (!sa_desired)
+		return NULL;
+	if (silly_global_init() != 0)
+		return NULL;
+	if (silly_global_audio_init() != 0) {
+		silly_global_uninit();
+		return NULL;
+	}
+
+	mixer = bzalloc(sizeof(silly_mixer_t));
+
+	SDL_zero(desired_spec);
+	desired_spec.channels = sa_desired->channels == SA_CH_LAYOUT_MONO ? 1 : 2;
+	desired_spec.format = AUDIO_F32SYS;
+	desired_spec.freq = sa_desired->samplerate > 0 ? sa_desired->samplerate : MIXER_SAMPLERATE;
+	desired_spec.samples = sa_desired->samples > 0 ? sa_desired->samples : SDL_AUDIO_BUFFER_SIZE;
+	desired_spec.callback = mixer_callback;
+	desired_spec.userdata = mixer;
+
+	//no allowed changes: SDL converts to the device if it must, the voices see one fixed format
+	mixer->dev = SDL_OpenAudioDevice(NULL, 0, &desired_spec, &mixer->spec, 0);
+	if (mixer->dev == 0) {
+		fprintf(stderr, "SDL_OpenAudioDevice(): %s.\n", SDL_GetError());
+		bfree(mixer);
+		silly_global_audio_uninit();
+		silly_global_uninit();
+		return NULL;
+	}
+
+	mixer->audiospec.channels = mixer->spec.channels == 1 ? SA_CH_LAYOUT_MONO : SA_CH_LAYOUT_STEREO;
+	mixer->audiospec.format = SA_SAMPLE_FMT_FLT;
+	mixer->audiospec.samplerate = mixer->spec.freq;
+	mixer->audiospec.samples = mixer->spec.samples;
+	if (sa_obtained)
+		*sa_obtained = mixer->audiospec;
+
+	mixer->mix = bmalloc(mixer->spec.size);
+	mixer->voice_buf = bmalloc(mixer->spec.size);
+
+	SDL_PauseAudioDevice(mixer->dev, 0);
+	return mixer;
+}
+
+//destroy a mixer, closing the voices still playing on it (the players themselves are the caller's)
+void silly_mixer_destroy(silly_mixer_t *mixer)
+{
+	size_t i;
+
+	if (!mixer)
+		return;
+
+	while (mixer->voices.num)
+		silly_player_close(mixer->voices.array[0]);
+
+	SDL_CloseAudioDevice(mixer->dev);
+	silly_global_audio_uninit();
+
+	for (i = 0; i < mixer->clips.num; ++i)
+		silly_clip_release(mixer->clips.array[i].clip);
+
+	da_free(mixer->voices);
+	da_free(mixer->clips);
+	bfree(mixer->mix);
+	bfree(mixer->voice_buf);
+	bfree(mixer);
+
+	silly_global_uninit();
+}
+
+//take the played out clips away and release them once the callback may run again,
+//so an evicted clip's PCM does not outlive the cache budget for long
+//@param[in] add: clip to start playing under the same lock, or NULL
+static void mixer_reap_clips(silly_mixer_t *mixer, const struct mixer_clip *add)
+{
+	DARRAY(silly_clip_t *) done;
+	size_t i;
+
+	da_init(done);
+	SDL_LockAudioDevice(mixer->dev);
+	for (i = mixer->clips.num; i > 0; --i) {
+		if (mixer->clips.array[i - 1].done) {
+			da_push_back(done, &mixer->clips.array[i - 1].clip);
+			da_erase(mixer->clips, i - 1);
+		}
+	}
+	if (add)
+		da_push_back(mixer->clips, add);
+	SDL_UnlockAudioDevice(mixer->dev);
+
+	for (i = 0; i < done.num; ++i)
+		silly_clip_release(done.array[i]);
+	da_free(done);
+}
+
+//play a cached clip (silly_clip_cache_get()) once, from the next device callback on.
+//any number of clips (and instances of one clip) play at once, nothing is decoded
+//@param[in] clip: in the format of the mixer (the cache created with the spec the mixer obtained)
+//@param[in] volume: linear gain, see silly_player_set_volume()
+//@param[in] pan: see silly_player_set_pan()
+//return 0 on success, negative on error
+int silly_mixer_play_clip(silly_mixer_t *mixer, silly_clip_t *clip, float volume, float pan)
+{
+	struct mixer_clip c;
+
+	if (!mixer || !clip)
+		return -1;
+	if (clip->spec.format != SA_SAMPLE_FMT_FLT
+		|| clip->spec.channels != mixer->audiospec.channels
+		|| clip->spec.samplerate != mixer->audiospec.samplerate)
+		return -2;
+
+	memset(&c, 0, sizeof(c));
+	c.clip = clip;
+	volume = volume < 0.0f ? 0.0f : (volume > VOLUME_MAX ? VOLUME_MAX : volume);
+	pan = pan < -1.0f ? -1.0f : (pan > 1.0f ? 1.0f : pan);
+	mixer_pan_gains(mixer->audiospec.channels == SA_CH_LAYOUT_MONO ? 0.0f : pan, &c.left, &c.right);
+	c.left *= volume;
+	c.right *= volume;
+	clip_addref(clip);
+
+	mixer_reap_clips(mixer, &c);
+
+	return 0;
+}
+
+//get the cost of the device callbacks since the last call
+void silly_mixer_stats(silly_mixer_t *mixer, silly_mixerstats *stats)
+{
+	if (!mixer || !stats)
+		return;
+
+	//stats are polled periodically, a good place to drop the clips played out since
+	mixer_reap_clips(mixer, NULL);
+
+	SDL_LockAudioDevice(mixer->dev);
+	stats->voices = (int)mixer->voices.num;
+	stats->callbacks = mixer->callbacks;
+	stats->callback_avg_ms = mixer->callbacks ? (double)mixer->callback_ns / mixer->callbacks / 1000000.0 : 0.0;
+	stats->callback_max_ms = (double)mixer->callback_max_ns / 1000000.0;
+	mixer->callbacks = 0;
+	mixer->callback_ns = 0;
+	mixer->callback_max_ns = 0;
+	SDL_UnlockAudioDevice(mixer->dev);
+
+	stats->buffer_ms = 1000.0 * mixer->spec.samples / mixer->spec.freq;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <SDL.h>
+
+#include "silly_player_internal.h"
+
+//voices (silly_player_open_voice()) have no device of their own, they are played by their mixer
+const silly_audiospec *mixer_audiospec(struct silly_mixer *mixer);
+void mixer_device_spec(struct silly_mixer *mixer, SDL_AudioSpec *spec);
+void mixer_add_voice(struct silly_mixer *mixer, VideoState *voice);
+void mixer_remove_voice(struct silly_mixer *mixer, VideoState *voice);
+void mixer_lock(struct silly_mixer *mixer);
+void mixer_unlock(struct silly_mixer *mixer);
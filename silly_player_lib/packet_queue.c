@@ -1,96 +1,228 @@
 #include "c99defs.h"
 #include "packet_queue.h"
 
-extern int global_exit;
+#define PACKET_QUEUE_MASK (PACKET_QUEUE_CAPACITY - 1)
+
+static inline unsigned long packet_queue_used(PacketQueue *q){
+    return (unsigned long)os_atomic_load_long(&q->tail) - (unsigned long)os_atomic_load_long(&q->head);
+}
+
+int packet_queue_init(PacketQueue *q){
+    int i;
 
-void packet_queue_init(PacketQueue *q){
     memset(q, 0, sizeof(PacketQueue));
+    q->slots = bzalloc(PACKET_QUEUE_CAPACITY * sizeof(PacketSlot));
+    for(i = 0; i < PACKET_QUEUE_CAPACITY; ++i){
+        av_init_packet(&q->slots[i].pkt);
+    }
+    q->serial = 1;
     q->mutex = SDL_CreateMutex();
     q->cond = SDL_CreateCond();
+    q->cond_room = SDL_CreateCond();
+    return 0;
+}
+
+void packet_queue_destroy(PacketQueue *q){
+    packet_queue_clear(q);
+
+    SDL_DestroyCond(q->cond_room);
+    SDL_DestroyCond(q->cond);
+    SDL_DestroyMutex(q->mutex);
+    bfree(q->slots);
+    memset(q, 0, sizeof(PacketQueue));
 }
 
 void packet_queue_clear(PacketQueue *q) {
-    AVPacketList *pktList;
+    if(!q->slots) return;
 
-    SDL_LockMutex(q->mutex);
-    while(pktList = q->first_pkt) {
-        q->first_pkt = pktList->next;
-        if(!q->first_pkt) {
-            q->last_pkt = NULL;
-        }
-        q->nb_packets--;
-        q->size -= pktList->pkt.size;
-        av_free(pktList);
+    //drain as if we were the consumer
+    while(packet_queue_used(q) > 0){
+        long head = q->head;
+        AVPacket *slot = &q->slots[head & PACKET_QUEUE_MASK].pkt;
+
+        os_atomic_add_long(&q->size, -slot->size);
+        os_atomic_dec_long(&q->nb_packets);
+        av_packet_unref(slot);
+        os_atomic_set_long(&q->head, head + 1);
     }
 
+    //the producer may be sleeping on a full ring
+    SDL_LockMutex(q->mutex);
+    SDL_CondSignal(q->cond_room);
     SDL_UnlockMutex(q->mutex);
 }
 
 int packet_queue_put(PacketQueue *q, AVPacket *pkt){
-    //wrap AVPacket in a AVPacketList, which is a element of the list
-    AVPacketList *pktList;
-    if(av_dup_packet(pkt) != 0){
+    long tail = q->tail; //only the producer writes tail
+    AVPacket *slot;
+
+    //ring full: sleep until the consumer frees a slot
+    if(packet_queue_used(q) >= PACKET_QUEUE_CAPACITY){
+        SDL_LockMutex(q->mutex);
+        os_atomic_set_bool(&q->producer_waiting, true);
+        while(packet_queue_used(q) >= PACKET_QUEUE_CAPACITY && !q->abort_request){
+            SDL_CondWait(q->cond_room, q->mutex);
+        }
+        os_atomic_set_bool(&q->producer_waiting, false);
+        SDL_UnlockMutex(q->mutex);
+
+        if(q->abort_request){
+            av_packet_unref(pkt);
+            return -1;
+        }
+    }
+
+    slot = &q->slots[tail & PACKET_QUEUE_MASK].pkt;
+    q->slots[tail & PACKET_QUEUE_MASK].serial = q->serial;
+    if(pkt->buf || !pkt->data){
+        av_packet_move_ref(slot, pkt); //hand the demuxer's buffer over, no copy
+    }else{
+        //not refcounted: the data belongs to the demuxer, we have to own a copy
+        int ret = av_packet_ref(slot, pkt);
+        av_packet_unref(pkt);
+        if(ret < 0){
+            return -1;
+        }
+        ++q->nb_copied;
+    }
+    ++q->nb_put;
+
+    os_atomic_add_long(&q->size, slot->size);
+    os_atomic_inc_long(&q->nb_packets);
+    os_atomic_set_long(&q->tail, tail + 1); //publish the slot
+
+    //only pay for the lock when the consumer is actually asleep
+    if(os_atomic_load_bool(&q->consumer_waiting)){
+        SDL_LockMutex(q->mutex);
+        SDL_CondSignal(q->cond);
+        SDL_UnlockMutex(q->mutex);
+    }
+
+    return 0;
+}
+
+int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, long *serial){
+    long head = q->head; //only the consumer writes head
+
+    //if(quit_get_from_queue){
+    if(q->abort_request){
         return -1;
     }
 
-    pktList = av_malloc(sizeof(AVPacketList));
-    if(!pktList) return -1;
-    pktList->pkt = *pkt;
-    pktList->next = NULL;
+    if(os_atomic_load_long(&q->tail) == head){
+        if(!block){ //return if non-blocking
+            return 0;
+        }
 
-    //
-    SDL_LockMutex(q->mutex);
+        SDL_LockMutex(q->mutex);
+        os_atomic_set_bool(&q->consumer_waiting, true);
+        while(os_atomic_load_long(&q->tail) == head && !q->abort_request){
+            SDL_CondWait(q->cond, q->mutex);
+        }
+        os_atomic_set_bool(&q->consumer_waiting, false);
+        SDL_UnlockMutex(q->mutex);
 
-    if(!q->last_pkt) q->first_pkt = pktList;
-    else q->last_pkt->next = pktList;
+        if(q->abort_request){
+            return -1;
+        }
+    }
 
-    q->last_pkt = pktList;
-    q->nb_packets++;
-    q->size += pktList->pkt.size;
+    av_packet_move_ref(pkt, &q->slots[head & PACKET_QUEUE_MASK].pkt);
+    if(serial){
+        *serial = q->slots[head & PACKET_QUEUE_MASK].serial;
+    }
+    os_atomic_add_long(&q->size, -pkt->size);
+    os_atomic_dec_long(&q->nb_packets);
+    os_atomic_set_long(&q->head, head + 1); //hand the slot back
+
+    if(os_atomic_load_bool(&q->producer_waiting)){
+        SDL_LockMutex(q->mutex);
+        SDL_CondSignal(q->cond_room);
+        SDL_UnlockMutex(q->mutex);
+    }
+
+    return 1;
+}
+
+long packet_queue_flush(PacketQueue *q){
+    //nothing is removed here (that is the consumer's job), stale packets
+    //still count against the size limit until the decoder has dropped them
+    return os_atomic_inc_long(&q->serial);
+}
+
+void packet_queue_start(PacketQueue *q){
+    SDL_LockMutex(q->mutex);
+    q->abort_request = false;
+    q->wakeup_request = false;
+    SDL_UnlockMutex(q->mutex);
+}
 
+void packet_queue_abort(PacketQueue *q){
+    SDL_LockMutex(q->mutex);
+    q->abort_request = true;
     SDL_CondSignal(q->cond);
+    SDL_CondSignal(q->cond_room);
     SDL_UnlockMutex(q->mutex);
+}
 
-    return 0;
+void packet_queue_wakeup(PacketQueue *q){
+    SDL_LockMutex(q->mutex);
+    q->wakeup_request = true;
+    SDL_CondSignal(q->cond_room);
+    SDL_UnlockMutex(q->mutex);
+}
+
+//max_size == 0 means "drained": no packet left at all
+static inline bool packet_queue_has_room(PacketQueue *q, long max_size){
+    if(max_size == 0)
+        return packet_queue_used(q) == 0;
+    return max_size > 0
+        && os_atomic_load_long(&q->size) <= max_size
+        && packet_queue_used(q) < PACKET_QUEUE_CAPACITY;
 }
 
-int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block){
-    AVPacketList *pktList;
+//max_size < 0: there is never room, only wakeup/abort/timeout end the wait
+static int packet_queue_wait(PacketQueue *q, long max_size, int timeout_ms){
     int ret;
 
-    SDL_LockMutex(q->mutex);
+    if(packet_queue_has_room(q, max_size) && !q->abort_request && !q->wakeup_request){
+        return 0;
+    }
 
+    SDL_LockMutex(q->mutex);
+    os_atomic_set_bool(&q->producer_waiting, true);
     for(;;){
-        //if(quit_get_from_queue){
-        if(global_exit){
+        if(q->abort_request){
             ret = -1;
             break;
         }
-
-        //
-        pktList = q->first_pkt;
-        if(pktList){ //read all elements from the list
-            q->first_pkt = pktList->next;
-            if(!q->first_pkt){
-                q->last_pkt = NULL;
-            }
-            q->nb_packets--;
-            q->size -= pktList->pkt.size;
-            *pkt = pktList->pkt;
-            av_free(pktList);
-
+        if(q->wakeup_request){
+            q->wakeup_request = false;
             ret = 1;
             break;
-        }else {
-            if(!block){ //return if non-blocking
-                ret = 0;
-                break;
-            }else{
-                SDL_CondWait(q->cond, q->mutex);
-            }
         }
-    }//end for(;;)
+        if(packet_queue_has_room(q, max_size)){
+            ret = 0;
+            break;
+        }
 
+        if(timeout_ms < 0){
+            SDL_CondWait(q->cond_room, q->mutex);
+        }else if(SDL_CondWaitTimeout(q->cond_room, q->mutex, timeout_ms) == SDL_MUTEX_TIMEDOUT){
+            ret = packet_queue_has_room(q, max_size) ? 0 : 1;
+            break;
+        }
+    }
+    os_atomic_set_bool(&q->producer_waiting, false);
     SDL_UnlockMutex(q->mutex);
+
     return ret;
 }
+
+int packet_queue_wait_room(PacketQueue *q, long max_size, int timeout_ms){
+    return packet_queue_wait(q, max_size, timeout_ms);
+}
+
+int packet_queue_sleep(PacketQueue *q, int timeout_ms){
+    return packet_queue_wait(q, -1, timeout_ms);
+}
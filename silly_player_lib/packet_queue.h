@@ -4,27 +4,101 @@
 #include <libavformat/avformat.h>
 #include <SDL.h>
 
+#include "util/bmem.h"
+#include "util/threading.h"
+
 #define MAX_AUDIOQ_SIZE (8*1024) //#define MAX_AUDIOQ_SIZE (5*16*1024)
 #define MAX_VIDEOQ_SIZE (256*1024) //#define MAX_VIDEOQ_SIZE (5*256*1024)
 
+#define PACKET_QUEUE_CAPACITY 256 //number of packet slots in the ring (power of 2)
+#define CACHE_LINE_SIZE 64
+
+typedef struct PacketSlot{
+    AVPacket pkt;
+    long serial; //queue serial when the packet was put
+}PacketSlot;
+
+//bounded single-producer/single-consumer ring of AVPacket slots.
+//the parse thread is the only producer, the decoder is the only consumer.
+//put/get are lock-free; the mutex is only taken to sleep on an empty/full ring.
+//packets are moved through by reference: the slots are recycled packet shells
+//and the payload buffer of the demuxer is never duplicated.
+//
+//flushing is in-band: packet_queue_flush() bumps 'serial', the consumer drops
+//every packet tagged with an older serial and resets its decoder when it sees
+//the first packet of the new one.
 typedef struct PacketQueue{
-    AVPacketList *first_pkt, *last_pkt;
-    int nb_packets; //number of all elements
-    int size; //total size of all elements
+    PacketSlot *slots; //PACKET_QUEUE_CAPACITY slots (shells), allocated once
+
+    //head & tail keep growing, slot index is (x & (PACKET_QUEUE_CAPACITY-1)).
+    //each one lives in its own cache line so producer & consumer don't bounce it.
+    char pad0[CACHE_LINE_SIZE];
+    volatile long head; //next slot to read (written by consumer only)
+    char pad1[CACHE_LINE_SIZE - sizeof(long)];
+    volatile long tail; //next slot to write (written by producer only)
+    char pad2[CACHE_LINE_SIZE - sizeof(long)];
+
+    volatile long nb_packets; //number of all elements
+    volatile long size; //total size of all elements
+    volatile long serial; //bumped by packet_queue_flush(), starts at 1
+
+    //statistics (written by producer only)
+    long nb_put; //packets queued since init
+    long nb_copied; //packets whose payload had to be copied (not refcounted)
+
+    //slow path
+    volatile bool consumer_waiting; //consumer sleeps on 'cond' (ring empty)
+    volatile bool producer_waiting; //producer sleeps on 'cond_room' (ring full / over size limit)
+    volatile bool abort_request; //wakes both sides for good, see packet_queue_abort()
+    volatile bool wakeup_request; //wakes the producer once, see packet_queue_wakeup()
     SDL_mutex *mutex;
     SDL_cond *cond;
+    SDL_cond *cond_room;
 }PacketQueue;
 
 //int quit_get_from_queue; //stop getting AVPacket from the queue
 
 /** initialize a queue */
-void packet_queue_init(PacketQueue *q);
+int packet_queue_init(PacketQueue *q);
+
+/** release everything allocated by packet_queue_init() */
+void packet_queue_destroy(PacketQueue *q);
 
-/** clear a queue */
+/** clear a queue (NOTE: must not run concurrently with packet_queue_get()) */
 void packet_queue_clear(PacketQueue *q);
 
-/** append "one" AVPacket to the end of the queue */
+/** move "one" AVPacket to the end of the queue, blocks while the ring is full.
+    the queue takes over the reference, 'pkt' is left blank (also on error) */
 int packet_queue_put(PacketQueue *q, AVPacket *pkt);
 
-/** get "one" AVPacket from the queue in blocking/non-blocking manner*/
-int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block);
\ No newline at end of file
+/** move "one" AVPacket out of the queue in blocking/non-blocking manner.
+    the caller owns the reference and releases it with av_packet_unref().
+    'serial' (may be NULL) receives the serial the packet was queued with */
+int packet_queue_get(PacketQueue *q, AVPacket *pkt, int block, long *serial);
+
+/** producer side flush: everything queued so far becomes stale (see 'serial').
+    return the new serial */
+long packet_queue_flush(PacketQueue *q);
+
+/** current serial, packets queued with another one are stale */
+static inline long packet_queue_serial(PacketQueue *q){
+    return os_atomic_load_long(&q->serial);
+}
+
+/** (re)enable a queue after packet_queue_abort() */
+void packet_queue_start(PacketQueue *q);
+
+/** make every blocked or later put/get/wait return -1 */
+void packet_queue_abort(PacketQueue *q);
+
+/** wake the producer blocked in packet_queue_wait_room()/packet_queue_sleep() (seek/quit requests) */
+void packet_queue_wakeup(PacketQueue *q);
+
+/** block the producer until the queue holds no more than max_size bytes and has a free slot
+    (max_size == 0: until the queue is drained).
+    return 0 if there is room, 1 if woken by packet_queue_wakeup() or timed out, -1 if aborted.
+    timeout_ms < 0 waits forever */
+int packet_queue_wait_room(PacketQueue *q, long max_size, int timeout_ms);
+
+/** block the producer until packet_queue_wakeup()/packet_queue_abort() or timeout */
+int packet_queue_sleep(PacketQueue *q, int timeout_ms);
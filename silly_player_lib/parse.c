@@ -2,17 +2,16 @@
 
 #include "silly_player_internal.h"
 #include "parse.h"
-
-extern int global_exit;
-extern int global_exit_parse;
-extern int pause_on;
+#include "audio.h"
+#include "playlist.h"
 
 void seek_to(VideoState *is, uint32_t seek_pos_sec)
 {
-	AVRational time_base = is->audio_st->time_base;
-	int64_t seek_time = is->audio_st->start_time + av_rescale(seek_pos_sec, time_base.den, time_base.num);
+	AVStream *st = is->pFormatCtx->streams[is->audio_stream_index]; //the file being read (see playlist_seek())
+	AVRational time_base = st->time_base;
+	int64_t seek_time = st->start_time + av_rescale(seek_pos_sec, time_base.den, time_base.num);
 
-	if (seek_time > is->audio_st->cur_dts) {
+	if (seek_time > st->cur_dts) {
 		av_seek_frame(is->pFormatCtx, is->audio_stream_index, seek_time, AVSEEK_FLAG_ANY);
 	}
 	else {
@@ -20,35 +19,125 @@ void seek_to(VideoState *is, uint32_t seek_pos_sec)
 	}
 }
 
+//stream finished (end of file or read error): mark the end of stream in-band, the decoder drains
+//the codec & the stretcher when it meets this empty packet and reports 0. with a device, wait for
+//it to be played out, then pause the device and sleep until seek/close
+static void parse_finished(VideoState *is)
+{
+	long serial = packet_queue_serial(&is->audioq);
+	AVPacket pkt;
+
+	av_init_packet(&pkt);
+	pkt.data = NULL;
+	pkt.size = 0;
+	packet_queue_put(&is->audioq, &pkt);
+
+	if (is->headless) {
+		is->exit_parse = 1;
+		return;
+	}
+
+	//let the decoder decode what's queued: the decode thread wakes us once it met the marker, with
+	//its last chunk in the ring (the queue runs empty before that, the last packet is still decoded)
+	while (!is->exit && !os_atomic_load_bool(&is->seek_req)
+		&& os_atomic_load_long(&is->pcm_eos_serial) != serial
+		&& packet_queue_sleep(&is->audioq, -1) >= 0);
+	//...and the device play out what the decode thread has queued: audio_callback() wakes
+	//us once the ring ran dry (a paused device never does, we sleep until resume/seek/close)
+	os_atomic_set_bool(&is->pcm_drain_waiting, true);
+	while (!is->exit && !os_atomic_load_bool(&is->seek_req)
+		&& audio_ring_used(&is->pcm_ring) > 0
+		&& packet_queue_sleep(&is->audioq, -1) >= 0);
+	os_atomic_set_bool(&is->pcm_drain_waiting, false);
+
+	if (is->exit || os_atomic_load_bool(&is->seek_req))
+		return; //serve it first, the seek makes the end marker stale
+
+	is->exit_parse = 1;
+	audio_pause(is, 1);
+}
+
+//serve a seek request in-band: reposition the demuxer and make everything queued stale.
+//the decoder resets itself when it meets the first packet of the new serial.
+static void parse_seek(VideoState *is)
+{
+	os_atomic_set_bool(&is->seek_req, false);
+
+	playlist_seek(is); //the track heard may not be the one read
+	seek_to(is, is->seek_pos_sec);
+	os_atomic_set_long(&is->seek_serial, packet_queue_flush(&is->audioq));
+
+	if (is->exit_parse) { //finished before: start over
+		is->exit_parse = 0;
+		audio_pause(is, 0);
+	}
+}
+
 int parse_thread(void *arg)
 {
     VideoState *is = (VideoState *)arg;
     AVPacket pkt1, *packet = &pkt1;
 	int ret;
 
-    //seek to position (audio seeking supported ONLY)
-    packet_queue_clear(&is->audioq);
-
-	seek_to(is, is->seek_pos_sec);
+    av_init_packet(packet);
 
     for(;;)
     {
-        if(global_exit_parse) break;
-        //seek stuff goes here ???
+        if(is->exit) break;
 
-        //reading too fast, slow down!
-        if(is->audioq.size > MAX_AUDIOQ_SIZE || is->videoq.size > MAX_VIDEOQ_SIZE)
+        //seek position (audio seeking supported ONLY)
+        if(os_atomic_load_bool(&is->seek_req))
         {
-            SDL_Delay(10);
+            parse_seek(is);
+        }
+
+        //finished: nothing to read until we're asked to seek (or close)
+        if(is->exit_parse)
+        {
+            //...or a file is queued: play it (the device ran dry already, so not gapless)
+            if(!is->headless && playlist_next(is))
+            {
+                is->exit_parse = 0;
+                audio_pause(is, 0);
+                continue;
+            }
+            if(packet_queue_sleep(&is->audioq, -1) < 0) break;
+            continue;
+        }
+
+        //open the next queued file while the decoder has plenty queued to chew on
+        if(!is->track_next && is->playlist.num && is->audioq.size >= MAX_AUDIOQ_SIZE / 2)
+        {
+            playlist_prepare(is);
+        }
+        //and hand it to the decoder if it fades in
+        if(is->track_next && !is->fade_track && is->crossfade_ms > 0)
+        {
+            playlist_fade_offer(is);
+        }
+
+        //reading too fast: sleep until the decoder frees room.
+        //seek/close wake us up through packet_queue_wakeup()/packet_queue_abort();
+        //a paused device consumes nothing, so we stay asleep while paused.
+        if((ret = packet_queue_wait_room(&is->audioq, MAX_AUDIOQ_SIZE, -1)) != 0)
+        {
+            if(ret < 0) break;
             continue;
         }
+        if(is->video_stream_index >= 0 && packet_queue_wait_room(&is->videoq, MAX_VIDEOQ_SIZE, -1) != 0)
+            continue;
+
         if((ret = av_read_frame(is->pFormatCtx, packet)) < 0)
         {
 			if (ret == AVERROR_EOF || url_feof(is->pFormatCtx->pb))
 			{
 				if (!is->loop) {
-					global_exit_parse = 1;
-					break;
+					//a file is queued: go on reading it, the decoder splices it in (see playlist.c)
+					if (playlist_next(is))
+						continue;
+
+					parse_finished(is);
+					continue;
 				}
 				else {
 					seek_to(is, 0);
@@ -58,13 +147,13 @@ int parse_thread(void *arg)
 
             if(is->pFormatCtx->pb->error == 0)
             {
-                SDL_Delay(100); /* no error; wait for user input */
+                packet_queue_sleep(&is->audioq, 100); /* no error; wait for user input */
                 continue;
             }
             else
             {
-				global_exit_parse = 1;
-                break;
+				parse_finished(is);
+                continue;
             }
         }
 
@@ -78,17 +167,11 @@ int parse_thread(void *arg)
         }
         else
         {
-            av_free_packet(packet);
+            av_packet_unref(packet);
         }
     }
 
-    /* wait for quitting */
-    while(!global_exit_parse)
-    {
-        SDL_Delay(100);
-    }
-	SDL_PauseAudio(1);
-	pause_on = 1;
+	audio_pause(is, 1);
 
     return 0;
 }
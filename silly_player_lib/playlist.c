@@ -0,0 +1,618 @@
+#include "c99defs.h"
+
+#include <libswresample/swresample.h>
+
+#include "audio.h"
+#include "playlist.h"
+#include "silly_player_internal.h"
+#include "silly_player.h"
+
+#include "util/bmem.h"
+#include "util/darray.h"
+#include "util/platform.h"
+
+//gapless playback of queued files. the parse thread opens the next file while the current one
+//plays (playlist_prepare()); at the end of the stream it moves on to its demuxer at once and marks
+//the spot in audioq with an end packet (playlist_next()). the decoder drains the old codec when it
+//meets the marker, then continues with the new one (playlist_switch()): the PCM of both files
+//follows in the same ring, with no gap and no device reopened. a seek before the decoder got to the
+//marker belongs to the old file: the switch is dropped and the old demuxer read again (playlist_seek()).
+//encoder delay & padding are trimmed by libavcodec from the skip side data the demuxer attaches
+//(packets go through audioq by reference, side data included).
+//
+//crossfade: the next file is handed to the decoder ahead of time (playlist_fade_offer()). once the
+//current track reaches 'fade_at' the decode thread reads & decodes the next one too and mixes both
+//with an equal-power curve (playlist_fade_mix()), all ahead of the device. at the end marker the
+//decoder switches over as above, and the parse thread reads on from where the decoder stopped.
+
+#define CROSSFADE_MAX_MS 10000
+
+int playlist_init(VideoState *is)
+{
+	pthread_mutex_init_value(&is->playlist_mutex);
+	if (pthread_mutex_init(&is->playlist_mutex, NULL) != 0)
+		return -1;
+	da_init(is->playlist);
+	circlebuf_init(&is->fade_pcm);
+	return 0;
+}
+
+static void playlist_track_free(PlaylistTrack *track)
+{
+	if (!track)
+		return;
+
+	avformat_close_input(&track->fmt_ctx);
+	avformat_close_input(&track->retired);
+	avcodec_free_context(&track->codec_ctx);
+	resampler_free(&track->resampler);
+	bfree(track->filename);
+	bfree(track);
+}
+
+static void playlist_clear_files(VideoState *is)
+{
+	size_t i;
+
+	pthread_mutex_lock(&is->playlist_mutex);
+	for (i = 0; i < is->playlist.num; ++i)
+		bfree(is->playlist.array[i]);
+	da_resize(is->playlist, 0);
+	pthread_mutex_unlock(&is->playlist_mutex);
+}
+
+//after the parse & decode threads stopped: drop the queue & the tracks opened ahead
+void playlist_close(VideoState *is)
+{
+	playlist_clear_files(is);
+
+	playlist_track_free(is->track_next);
+	is->track_next = NULL;
+	playlist_track_free(is->track_switch); //its demuxer is is->pFormatCtx already
+	is->track_switch = NULL;
+	is->track_switch_pending = false;
+	is->track_next_drop = false;
+
+	playlist_track_free(is->fade_track);
+	is->fade_track = NULL;
+	is->fade_offered = false;
+	is->fade_switched = false;
+	is->fade_state = FADE_NONE;
+	circlebuf_free(&is->fade_pcm);
+	av_frame_free(&is->fade_frame);
+	bfree(is->fade_buf);
+	is->fade_buf = NULL;
+	is->fade_buf_capacity = 0;
+}
+
+void playlist_free(VideoState *is)
+{
+	playlist_close(is);
+	da_free(is->playlist);
+	pthread_mutex_destroy(&is->playlist_mutex);
+}
+
+//open a file up to the point the decoder could take it over
+static PlaylistTrack *playlist_open(VideoState *is, const char *filename)
+{
+	PlaylistTrack *track = bzalloc(sizeof(PlaylistTrack));
+	AVCodec *codec = NULL;
+
+	track->filename = bstrdup(filename);
+
+	if (avformat_open_input(&track->fmt_ctx, filename, NULL, NULL) != 0) {
+		fprintf(stderr, "%s: could not open the queued file.\n", filename);
+		goto fail;
+	}
+	if (avformat_find_stream_info(track->fmt_ctx, NULL) < 0) {
+		fprintf(stderr, "%s: could not find stream info.\n", filename);
+		goto fail;
+	}
+	track->stream_index = av_find_best_stream(track->fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+	if (track->stream_index < 0) {
+		fprintf(stderr, "%s: could not find audio stream.\n", filename);
+		goto fail;
+	}
+	track->st = track->fmt_ctx->streams[track->stream_index];
+	track->duration = (long)(track->fmt_ctx->duration / AV_TIME_BASE);
+
+	track->codec_ctx = avcodec_alloc_context3(codec);
+	if (avcodec_copy_context(track->codec_ctx, track->st->codec) != 0
+		|| avcodec_open2(track->codec_ctx, codec, NULL) < 0) {
+		fprintf(stderr, "%s: could not open audio codecs.\n", filename);
+		goto fail;
+	}
+
+	if (audio_conv_open(is, track->codec_ctx, &track->resampler, &track->conv) != 0) {
+		fprintf(stderr, "%s: could not create the converter.\n", filename);
+		goto fail;
+	}
+	return track;
+
+fail:
+	playlist_track_free(track);
+	return NULL;
+}
+
+//parse thread: open the next queued file if it isn't yet, failing ones are skipped
+void playlist_prepare(VideoState *is)
+{
+	char *filename;
+
+	if (is->track_next_drop) { //the queue was cleared
+		is->track_next_drop = false;
+		playlist_track_free(is->track_next);
+		is->track_next = NULL;
+	}
+
+	while (!is->track_next && !is->exit) {
+		pthread_mutex_lock(&is->playlist_mutex);
+		filename = NULL;
+		if (is->playlist.num) {
+			filename = is->playlist.array[0];
+			da_erase(is->playlist, 0);
+		}
+		pthread_mutex_unlock(&is->playlist_mutex);
+
+		if (!filename)
+			break;
+		is->track_next = playlist_open(is, filename);
+		bfree(filename);
+	}
+}
+
+//queue an end marker: the decoder drains the codec when it meets it
+static void playlist_put_marker(VideoState *is)
+{
+	AVPacket pkt;
+
+	av_init_packet(&pkt);
+	pkt.data = NULL;
+	pkt.size = 0;
+	packet_queue_put(&is->audioq, &pkt);
+}
+
+//parse thread: hand the next track to the decoder to be faded in, if the length of the current
+//one is known (the fade starts that long before its end)
+void playlist_fade_offer(VideoState *is)
+{
+	PlaylistTrack *track = is->track_next;
+	AVStream *st = is->pFormatCtx->streams[is->audio_stream_index];
+	double start = 0.0, duration = -1.0, fade;
+
+	if (!track || is->track_next_drop || is->fade_track || is->crossfade_ms <= 0)
+		return;
+
+	if (st->duration != AV_NOPTS_VALUE)
+		duration = st->duration * av_q2d(st->time_base);
+	else if (is->pFormatCtx->duration != AV_NOPTS_VALUE)
+		duration = (double)is->pFormatCtx->duration / AV_TIME_BASE;
+	if (st->start_time != AV_NOPTS_VALUE)
+		start = st->start_time * av_q2d(st->time_base);
+	if (duration <= 0.0)
+		return; //no idea where it ends: gapless
+
+	fade = min(is->crossfade_ms / 1000.0, duration / 2);
+	track->fade_at = start + duration - fade;
+	track->fade_frames = (int)(fade * is->audiospec.samplerate);
+	if (track->fade_frames <= 0)
+		return;
+
+	is->track_next = NULL;
+	is->fade_track = track;
+	os_atomic_set_bool(&is->fade_offered, true);
+}
+
+//parse thread, end of stream with a track fading in: wait for the decoder to switch to it,
+//then read on from where the decoder stopped
+static bool playlist_fade_next(VideoState *is)
+{
+	PlaylistTrack *track = is->fade_track;
+	long serial = packet_queue_serial(&is->audioq);
+
+	if (!track->marker || track->serial != serial) { //(again if a seek dropped it)
+		pthread_mutex_lock(&is->playlist_mutex);
+		track->serial = serial;
+		track->marker = true;
+		pthread_mutex_unlock(&is->playlist_mutex);
+		playlist_put_marker(is);
+	}
+
+	//the decoder wakes us once it switched (see playlist_switch()), seek & close too
+	while (!os_atomic_load_bool(&is->fade_switched)) {
+		if (is->exit || os_atomic_load_bool(&is->seek_req))
+			return true; //serve it first, we'll be back at this end of stream
+		if (packet_queue_sleep(&is->audioq, -1) < 0)
+			return true;
+	}
+
+	//the decoder is done with the old demuxer
+	avformat_close_input(&is->pFormatCtx);
+	is->pFormatCtx = track->fmt_ctx;
+	is->audio_stream_index = track->stream_index;
+	track->fmt_ctx = NULL;
+
+	is->fade_track = NULL;
+	os_atomic_set_bool(&is->fade_switched, false);
+	playlist_track_free(track);
+	return true;
+}
+
+//parse thread, end of stream: continue with the next track if one is queued.
+//return false if there is none (the stream is finished)
+bool playlist_next(VideoState *is)
+{
+	PlaylistTrack *track;
+
+	if (is->fade_track)
+		return playlist_fade_next(is);
+
+	playlist_prepare(is); //nothing opened ahead: now
+	if (!is->track_next)
+		return false;
+
+	//one switch at a time: the decoder still has to reach the marker of the last one,
+	//it wakes us when it does (see playlist_take_switch()), seek & close too
+	while (os_atomic_load_bool(&is->track_switch_pending)) {
+		if (is->exit || os_atomic_load_bool(&is->seek_req))
+			return true; //serve it first, we'll be back at this end of stream
+		if (packet_queue_sleep(&is->audioq, -1) < 0)
+			return true;
+	}
+
+	track = is->track_next;
+	is->track_next = NULL;
+
+	//we read the new file from now on, the decoder needs the old demuxer until its marker
+	//(and it's still the one heard: see playlist_seek())
+	track->retired = is->pFormatCtx;
+	track->retired_stream_index = is->audio_stream_index;
+	is->pFormatCtx = track->fmt_ctx;
+	is->audio_stream_index = track->stream_index;
+	track->fmt_ctx = NULL;
+	track->serial = packet_queue_serial(&is->audioq);
+
+	pthread_mutex_lock(&is->playlist_mutex);
+	is->track_switch = track;
+	os_atomic_set_bool(&is->track_switch_pending, true);
+	pthread_mutex_unlock(&is->playlist_mutex);
+
+	playlist_put_marker(is);
+	return true;
+}
+
+//decoder: take the decoder & conversion of 'track' over
+static void playlist_take_decoder(VideoState *is, PlaylistTrack *track)
+{
+	avcodec_close(is->audio_ctx);
+	avcodec_free_context(&is->audio_ctx);
+	resampler_free(&is->resampler);
+
+	is->audio_ctx = track->codec_ctx;
+	is->resampler = track->resampler;
+	is->audio_conv = track->conv;
+	is->audio_conv_held = track->conv_held;
+	is->audio_st = track->st;
+	track->codec_ctx = NULL;
+	track->resampler = NULL;
+
+	++is->track_decoded;
+	os_atomic_set_long(&is->duration, track->duration);
+}
+
+static PlaylistTrack *playlist_take_switch(VideoState *is, long serial)
+{
+	PlaylistTrack *track;
+
+	if (!os_atomic_load_bool(&is->track_switch_pending))
+		return NULL;
+
+	pthread_mutex_lock(&is->playlist_mutex);
+	track = is->track_switch;
+	if (track && track->serial <= serial) {
+		is->track_switch = NULL;
+		os_atomic_set_bool(&is->track_switch_pending, false);
+	} else {
+		track = NULL;
+	}
+	pthread_mutex_unlock(&is->playlist_mutex);
+
+	if (track)
+		packet_queue_wakeup(&is->audioq); //the parse thread may wait to queue the next switch
+	return track;
+}
+
+//decoder, end marker met & the codec drained: continue with the next track if one is pending.
+//return true if it switched
+bool playlist_switch(VideoState *is)
+{
+	PlaylistTrack *track;
+	bool marker;
+
+	if ((track = playlist_take_switch(is, is->audio_pkt_serial))) {
+		playlist_take_decoder(is, track);
+		playlist_track_free(track); //closes the old demuxer
+		return true;
+	}
+
+	if (!os_atomic_load_bool(&is->fade_offered))
+		return false;
+
+	pthread_mutex_lock(&is->playlist_mutex);
+	marker = is->fade_track->marker;
+	pthread_mutex_unlock(&is->playlist_mutex);
+	if (!marker)
+		return false;
+
+	//the fade goes on with the new track alone (PCM decoded ahead first), its demuxer goes back to the parse thread
+	playlist_take_decoder(is, is->fade_track);
+	is->fade_serial = is->audio_pkt_serial;
+	is->fade_state = is->fade_state == FADE_MIXING ? FADE_TAIL : FADE_NONE;
+	os_atomic_set_bool(&is->fade_offered, false);
+	os_atomic_set_bool(&is->fade_switched, true);
+	packet_queue_wakeup(&is->audioq);
+	return true;
+}
+
+//parse thread, before a seek: until the decoder met the end marker of the track before, that one
+//is still being played and the seek belongs to it. drop the pending switch and read it again,
+//the next file goes back to the front of the queue (opened again when it's due)
+void playlist_seek(VideoState *is)
+{
+	PlaylistTrack *track;
+
+	if (!os_atomic_load_bool(&is->track_switch_pending))
+		return;
+
+	pthread_mutex_lock(&is->playlist_mutex);
+	track = is->track_switch;
+	is->track_switch = NULL;
+	os_atomic_set_bool(&is->track_switch_pending, false);
+	if (track) {
+		da_insert(is->playlist, 0, &track->filename);
+		track->filename = NULL;
+		if (is->track_next && !is->track_next_drop) { //opened ahead in the meantime: after it
+			da_insert(is->playlist, 1, &is->track_next->filename);
+			is->track_next->filename = NULL;
+		}
+	}
+	pthread_mutex_unlock(&is->playlist_mutex);
+
+	if (!track) //the decoder took it just now: the seek is in the new file
+		return;
+
+	playlist_track_free(is->track_next);
+	is->track_next = NULL;
+	is->track_next_drop = false;
+
+	avformat_close_input(&is->pFormatCtx);
+	is->pFormatCtx = track->retired;
+	is->audio_stream_index = track->retired_stream_index;
+	track->retired = NULL;
+	playlist_track_free(track);
+}
+
+//decoder, first packet of a new serial (seek)
+void playlist_flushed(VideoState *is, long serial)
+{
+	PlaylistTrack *track;
+
+	//the fade starts over when the current track gets there again
+	if (is->fade_state == FADE_MIXING) {
+		track = is->fade_track;
+		av_seek_frame(track->fmt_ctx, track->stream_index, 0, AVSEEK_FLAG_BACKWARD);
+		avcodec_flush_buffers(track->codec_ctx);
+		resampler_reset(track->resampler);
+		track->conv_held = false;
+	}
+	is->fade_state = FADE_NONE;
+	is->fade_eof = false;
+	circlebuf_pop_front(&is->fade_pcm, NULL, is->fade_pcm.size);
+}
+
+static int playlist_frame_bytes(VideoState *is)
+{
+	return SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+}
+
+//decoder: decode the track fading in until fade_pcm holds 'size' bytes (or the track ended).
+//it has its own demuxer, the decode thread reads it directly
+static void playlist_fade_fill(VideoState *is, PlaylistTrack *track, size_t size)
+{
+	int frame_bytes = playlist_frame_bytes(is);
+	int capacity = (int)(is->audio_buf_capacity / frame_bytes); //is->out_buffer
+	AVPacket pkt, left;
+	int used, got_frame, out_frames;
+
+	while (is->fade_pcm.size < size && !is->fade_eof && !is->exit) {
+		if (av_read_frame(track->fmt_ctx, &pkt) < 0) {
+			is->fade_eof = true;
+			break;
+		}
+
+		left = pkt;
+		while (pkt.stream_index == track->stream_index && left.size > 0) {
+			used = avcodec_decode_audio4(track->codec_ctx, is->fade_frame, &got_frame, &left);
+			if (used < 0)
+				break;
+			left.data += used;
+			left.size -= used;
+			if (!got_frame)
+				continue;
+
+			//like the decoder: a frame bigger than out_buffer goes through the resampler, which keeps the rest
+			if (track->conv.kind != SAMPLE_CONV_NONE && !track->conv_held
+				&& is->fade_frame->format == track->codec_ctx->sample_fmt
+				&& is->fade_frame->channels == track->codec_ctx->channels
+				&& is->fade_frame->sample_rate == track->codec_ctx->sample_rate
+				&& is->fade_frame->nb_samples <= capacity) {
+				out_frames = is->fade_frame->nb_samples;
+				sample_conv_run(&track->conv, &is->out_buffer, (const uint8_t **)is->fade_frame->extended_data, out_frames);
+			} else {
+				out_frames = resampler_convert(track->resampler, &is->out_buffer, capacity,
+					(const uint8_t **)is->fade_frame->extended_data, is->fade_frame->nb_samples);
+				track->conv_held = out_frames == capacity;
+				if (track->conv_held)
+					is->audio_buf_want = max(is->audio_buf_want,
+						(size_t)(out_frames + resampler_out_frames(track->resampler, 0)) * frame_bytes);
+			}
+			if (out_frames > 0)
+				circlebuf_push_back(&is->fade_pcm, is->out_buffer, (size_t)out_frames * frame_bytes);
+		}
+		av_packet_unref(&pkt);
+	}
+}
+
+//decoder: PCM of the track faded in that was decoded ahead of the switch, it goes before anything
+//decoded from its packets. return bytes copied to 'buf'
+int playlist_fade_tail(VideoState *is, uint8_t *buf, int size)
+{
+	int frame_bytes = playlist_frame_bytes(is);
+	size_t n;
+
+	if (is->fade_state != FADE_TAIL || !is->fade_pcm.size)
+		return 0;
+	if (is->fade_serial != packet_queue_serial(&is->audioq)) { //seeked since
+		circlebuf_pop_front(&is->fade_pcm, NULL, is->fade_pcm.size);
+		return 0;
+	}
+
+	n = min(is->fade_pcm.size, (size_t)size);
+	n -= n % frame_bytes;
+	circlebuf_pop_front(&is->fade_pcm, buf, n);
+
+	is->audio_buf_clock = is->fade_clock;
+	is->fade_clock += (double)n / ((double)frame_bytes * is->audiospec.samplerate);
+	return (int)n;
+}
+
+static void playlist_crossfade(VideoState *is, uint8_t *dst, const uint8_t *a, const uint8_t *b, int frames)
+{
+	const SampleKernels *kernels = sample_kernels();
+	int channels = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels);
+	float step = 1.0f / (float)is->fade_frames;
+	float pos = (float)is->fade_pos * step;
+
+	if (is->audiospec.format == SA_SAMPLE_FMT_S16)
+		kernels->crossfade_s16((int16_t *)dst, (const int16_t *)a, (const int16_t *)b, frames, channels, pos, step);
+	else
+		kernels->crossfade_flt((float *)dst, (const float *)a, (const float *)b, frames, channels, pos, step);
+	is->fade_pos += frames;
+}
+
+//decoder: mix the track fading in into 'size' bytes just decoded (pts 'clock') in place
+void playlist_fade_mix(VideoState *is, uint8_t *buf, int size, double clock)
+{
+	PlaylistTrack *track;
+	int frame_bytes = playlist_frame_bytes(is);
+	int frames = size / frame_bytes;
+	int offset, n;
+	size_t have;
+
+	if (is->fade_state == FADE_TAIL) {
+		//the track before is over: the curve goes on with silence on its side
+		playlist_crossfade(is, buf, NULL, buf, frames);
+		if (is->fade_pos >= is->fade_frames)
+			is->fade_state = FADE_NONE;
+		return;
+	}
+	if (!os_atomic_load_bool(&is->fade_offered))
+		return;
+
+	track = is->fade_track;
+	if (clock + (double)frames / is->audiospec.samplerate <= track->fade_at)
+		return;
+
+	if (is->fade_state != FADE_MIXING) {
+		is->fade_state = FADE_MIXING;
+		is->fade_frames = track->fade_frames;
+		is->fade_pos = 0;
+		is->fade_eof = false;
+		is->fade_clock = track->st->start_time != AV_NOPTS_VALUE ? track->st->start_time * av_q2d(track->st->time_base) : 0.0;
+		if (!is->fade_frame)
+			is->fade_frame = av_frame_alloc();
+	}
+	if (is->fade_buf_capacity < (size_t)size) {
+		is->fade_buf = brealloc(is->fade_buf, size);
+		is->fade_buf_capacity = size;
+	}
+
+	offset = clock >= track->fade_at ? 0 : (int)((track->fade_at - clock) * is->audiospec.samplerate + 0.5);
+	offset = min(offset, frames);
+	n = frames - offset;
+
+	playlist_fade_fill(is, track, (size_t)n * frame_bytes);
+	have = min(is->fade_pcm.size, (size_t)n * frame_bytes);
+	circlebuf_pop_front(&is->fade_pcm, is->fade_buf, have);
+	memset(is->fade_buf + have, 0, (size_t)n * frame_bytes - have); //it ended already
+	is->fade_clock += (double)have / ((double)frame_bytes * is->audiospec.samplerate);
+
+	playlist_crossfade(is, buf + (size_t)offset * frame_bytes, buf + (size_t)offset * frame_bytes, is->fade_buf, n);
+}
+
+//queue a file to be played right after the current one (and the ones queued before), with no gap.
+//it's opened ahead of time while the current one plays. the queue is dropped by silly_player_close();
+//with loop on, the current file repeats and the queue waits
+//@param[in] filename: audio to be played
+//return 0 on success, negative on error
+int silly_player_queue(silly_player_t *is, const char *filename)
+{
+	char *copy;
+
+	if (!is || !is->active) return -1;
+	if (!filename || !*filename) return -2;
+
+	copy = bstrdup(filename);
+	pthread_mutex_lock(&is->playlist_mutex);
+	da_push_back(is->playlist, &copy);
+	pthread_mutex_unlock(&is->playlist_mutex);
+
+	//the parse thread may be asleep (queue full, or finished): let it open the file
+	packet_queue_wakeup(&is->audioq);
+	return 0;
+}
+
+//drop the queued files (the one being played goes on)
+void silly_player_queue_clear(silly_player_t *is)
+{
+	if (!is || !is->active) return;
+
+	playlist_clear_files(is);
+	is->track_next_drop = true;
+}
+
+//get the number of files queued and not played yet
+int silly_player_queued(silly_player_t *is)
+{
+	int queued;
+
+	if (!is || !is->active) return 0;
+
+	pthread_mutex_lock(&is->playlist_mutex);
+	queued = (int)is->playlist.num;
+	pthread_mutex_unlock(&is->playlist_mutex);
+
+	if (is->track_next && !is->track_next_drop)
+		++queued;
+	if (os_atomic_load_bool(&is->track_switch_pending) || os_atomic_load_bool(&is->fade_offered))
+		++queued;
+	return queued;
+}
+
+//set the crossfade between queued files, applied from the next one handed over (0: gapless).
+//the overlap is placed from the length the container declares, without it the files follow gapless
+//@param[in] ms: overlap in milliseconds, 0 .. 10000
+void silly_player_set_crossfade(silly_player_t *is, int ms)
+{
+	if (!is) return;
+
+	is->crossfade_ms = ms < 0 ? 0 : (ms > CROSSFADE_MAX_MS ? CROSSFADE_MAX_MS : ms);
+}
+
+//get the track being played: 0 is the file opened, then 1, 2... for the queued ones
+long silly_player_track(silly_player_t *is)
+{
+	if (!is || !is->active) return -1;
+
+	return os_atomic_load_long(&is->track_played);
+}
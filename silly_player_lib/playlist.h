@@ -0,0 +1,46 @@
+#pragma once
+
+#include "silly_player_internal.h"
+
+//a queued file opened ahead of time: demuxer, decoder & conversion to the device format ready
+typedef struct PlaylistTrack{
+	char *filename;
+	AVFormatContext *fmt_ctx;		//moved to is->pFormatCtx when the parse thread reaches it
+	AVFormatContext *retired;		//the demuxer it replaced, closed by the decoder once it switched
+	int retired_stream_index;		//its audio stream: a seek goes back to it until the decoder switched
+	int stream_index;
+	AVStream *st;
+	long duration;					//in sec, published once the decoder takes it over
+	AVCodecContext *codec_ctx;
+	Resampler *resampler;
+	SampleConv conv;
+	bool conv_held;					//crossfade: its resampler holds the rest of a frame bigger than out_buffer
+	long serial;					//audioq serial of the end marker of the track before
+	bool marker;					//crossfade: that marker is queued
+
+	//crossfade: set when handed to the decoder (see playlist_fade_offer())
+	double fade_at;					//clock of the track before where this one fades in (in sec)
+	int fade_frames;				//length of the overlap
+}PlaylistTrack;
+
+enum{
+	FADE_NONE,
+	FADE_MIXING,	//fade_track is being decoded & mixed into the current track
+	FADE_TAIL		//the decoder switched to it, the rest of its fade-in goes on alone
+};
+
+int playlist_init(VideoState *is);
+void playlist_free(VideoState *is);
+void playlist_close(VideoState *is);
+
+//parse thread
+void playlist_prepare(VideoState *is);
+void playlist_fade_offer(VideoState *is);
+bool playlist_next(VideoState *is);
+void playlist_seek(VideoState *is);
+
+//decoder
+bool playlist_switch(VideoState *is);
+void playlist_flushed(VideoState *is, long serial);
+int playlist_fade_tail(VideoState *is, uint8_t *buf, int size);
+void playlist_fade_mix(VideoState *is, uint8_t *buf, int size, double clock);
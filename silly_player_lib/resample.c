@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "c99defs.h"
+#include "resample.h"
+#include "silly_player_params.h"
+
+#include <libavutil/channel_layout.h>
+#include <libavutil/opt.h>
+
+#include "util/bmem.h"
+
+//the tiers, all on interleaved / planar PCM of any layout (bench_resample measures them):
+//  fast:    swresample, 8 taps of its cubic filter, 64 phases interpolated linearly. previews
+//  default: swresample as it comes (32 taps blackman-nuttall, 1024 phases)
+//  high:    swresample, 64 taps kaiser (beta 9), phases interpolated, cutoff at 98% of nyquist
+//  speex:   the speex resampler at its "desktop" quality (5). swresample converts format & layout before it
+#define RESAMPLE_SPEEX_QUALITY SPEEX_RESAMPLER_QUALITY_DESKTOP
+
+static int resampler_swr_options(SwrContext *swr, int quality)
+{
+	int ret = 0;
+
+	switch (quality) {
+	case SA_RESAMPLE_FAST:
+		ret |= av_opt_set_int(swr, "filter_size", 8, 0);
+		ret |= av_opt_set_int(swr, "phase_shift", 6, 0);
+		ret |= av_opt_set_int(swr, "linear_interp", 1, 0);
+		ret |= av_opt_set_int(swr, "filter_type", SWR_FILTER_TYPE_CUBIC, 0);
+		break;
+	case SA_RESAMPLE_HIGH:
+		ret |= av_opt_set_int(swr, "filter_size", 64, 0);
+		ret |= av_opt_set_int(swr, "linear_interp", 1, 0);
+		ret |= av_opt_set_double(swr, "cutoff", 0.98, 0);
+		ret |= av_opt_set_int(swr, "filter_type", SWR_FILTER_TYPE_KAISER, 0);
+		ret |= av_opt_set_int(swr, "kaiser_beta", 9, 0);
+		break;
+	default:
+		break;
+	}
+	return ret;
+}
+
+Resampler *resampler_open(int quality,
+	int64_t out_layout, enum AVSampleFormat out_fmt, int out_samplerate,
+	int64_t in_layout, enum AVSampleFormat in_fmt, int in_samplerate)
+{
+	Resampler *r = bzalloc(sizeof(Resampler));
+	int err = 0;
+
+	r->quality = quality;
+	r->kernels = sample_kernels();
+	r->channels = av_get_channel_layout_nb_channels(out_layout);
+	r->s16 = out_fmt == AV_SAMPLE_FMT_S16;
+	r->in_samplerate = in_samplerate;
+	r->out_samplerate = out_samplerate;
+
+	//speex: packed output, and only if there is a rate to change
+	if (quality == SA_RESAMPLE_SPEEX
+		&& (out_fmt == AV_SAMPLE_FMT_FLT || out_fmt == AV_SAMPLE_FMT_S16) && in_samplerate != out_samplerate) {
+		r->speex = speex_resampler_init(r->channels, in_samplerate, out_samplerate, RESAMPLE_SPEEX_QUALITY, &err);
+		if (!r->speex) {
+			fprintf(stderr, "speex_resampler_init: %s.\n", speex_resampler_strerror(err));
+			goto fail;
+		}
+		speex_resampler_skip_zeros(r->speex); //no filter delay at the start, the pts stay right
+		out_fmt = AV_SAMPLE_FMT_FLT;
+		out_samplerate = in_samplerate;
+	}
+
+	r->swr = swr_alloc_set_opts(NULL,
+		out_layout, out_fmt, out_samplerate,
+		in_layout, in_fmt, in_samplerate,
+		0, NULL);
+	if (!r->swr || (!r->speex && resampler_swr_options(r->swr, quality) < 0) || swr_init(r->swr) < 0) {
+		fprintf(stderr, "resampler: could not create the converter.\n");
+		goto fail;
+	}
+	return r;
+
+fail:
+	resampler_free(&r);
+	return NULL;
+}
+
+void resampler_free(Resampler **r)
+{
+	if (!*r)
+		return;
+
+	swr_free(&(*r)->swr);
+	if ((*r)->speex)
+		speex_resampler_destroy((*r)->speex);
+	bfree((*r)->pending);
+	bfree((*r)->scratch);
+	bfree(*r);
+	*r = NULL;
+}
+
+static void resampler_reserve(Resampler *r, int frames)
+{
+	if (frames <= r->pending_capacity)
+		return;
+
+	r->pending_capacity = max(frames, r->pending_capacity * 2);
+	r->pending = brealloc(r->pending, sizeof(float) * r->pending_capacity * r->channels);
+}
+
+//speex: convert the input to float in 'pending' (at the input rate, nothing is buffered by swr),
+//then resample as much of it as 'out' takes
+static int resampler_convert_speex(Resampler *r, uint8_t **out, int out_count, const uint8_t **in, int in_count)
+{
+	spx_uint32_t in_len, out_len = out_count;
+	float *dst;
+	int n;
+
+	if (in && in_count > 0) {
+		resampler_reserve(r, r->pending_frames + in_count);
+		dst = r->pending + (size_t)r->pending_frames * r->channels;
+		if ((n = swr_convert(r->swr, (uint8_t **)&dst, in_count, in, in_count)) < 0)
+			return n;
+		r->pending_frames += n;
+	} else if (!in && !r->flushed) {
+		//end of stream: silence pushes the tail of the filter out
+		n = speex_resampler_get_input_latency(r->speex);
+		resampler_reserve(r, r->pending_frames + n);
+		memset(r->pending + (size_t)r->pending_frames * r->channels, 0, sizeof(float) * n * r->channels);
+		r->pending_frames += n;
+		r->flushed = true;
+	}
+	if (!out_count || !r->pending_frames)
+		return 0;
+
+	if (r->s16 && r->scratch_frames < out_count) {
+		r->scratch_frames = out_count;
+		r->scratch = brealloc(r->scratch, sizeof(float) * out_count * r->channels);
+	}
+	dst = r->s16 ? r->scratch : (float *)out[0];
+
+	in_len = r->pending_frames;
+	speex_resampler_process_interleaved_float(r->speex, r->pending, &in_len, dst, &out_len);
+	if (r->s16)
+		r->kernels->flt_to_s16((int16_t *)out[0], dst, (int)out_len * r->channels);
+
+	r->pending_frames -= in_len;
+	memmove(r->pending, r->pending + (size_t)in_len * r->channels, sizeof(float) * r->pending_frames * r->channels);
+	return (int)out_len;
+}
+
+int resampler_convert(Resampler *r, uint8_t **out, int out_count, const uint8_t **in, int in_count)
+{
+	if (r->speex)
+		return resampler_convert_speex(r, out, out_count, in, in_count);
+	return swr_convert(r->swr, out, out_count, in, in_count);
+}
+
+int resampler_out_frames(Resampler *r, int in_count)
+{
+	if (r->speex)
+		return (int)(((int64_t)r->pending_frames + in_count) * r->out_samplerate / r->in_samplerate) + 1;
+	return swr_get_out_samples(r->swr, in_count);
+}
+
+void resampler_reset(Resampler *r)
+{
+	swr_init(r->swr);
+	if (r->speex) {
+		speex_resampler_reset_mem(r->speex);
+		speex_resampler_skip_zeros(r->speex);
+		r->pending_frames = 0;
+		r->flushed = false;
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "c99defs.h"
+#include "sample_conv.h"
+
+#include <libswresample/swresample.h>
+#include <speex/speex_resampler.h>
+
+//a format / layout / samplerate conversion of the tier picked by silly_player_set_resampler() (SA_RESAMPLE_*):
+//swresample with the options of the tier, or the speex resampler (samplerate only: swresample converts
+//the format & the layout at the input rate first). see resample.c
+typedef struct Resampler{
+	int quality;				//SA_RESAMPLE_*
+	SwrContext *swr;			//the whole conversion, or format & layout only (speex)
+	SpeexResamplerState *speex;
+	const SampleKernels *kernels;
+	int channels;				//out
+	bool s16;					//out format (speex: packed float or s16 only)
+	int in_samplerate;
+	int out_samplerate;
+
+	float *pending;				//speex: input converted to float, not taken yet
+	int pending_frames;
+	int pending_capacity;
+	float *scratch;				//speex: output before s16
+	int scratch_frames;
+	bool flushed;				//speex: the tail of the filter was pushed through
+}Resampler;
+
+/** NULL on error. the layouts are AV_CH_LAYOUT_* */
+Resampler *resampler_open(int quality,
+	int64_t out_layout, enum AVSampleFormat out_fmt, int out_samplerate,
+	int64_t in_layout, enum AVSampleFormat in_fmt, int in_samplerate);
+void resampler_free(Resampler **r);
+
+/** like swr_convert(): 'in' NULL flushes, the input that doesn't fit 'out_count' is kept. return frames out */
+int resampler_convert(Resampler *r, uint8_t **out, int out_count, const uint8_t **in, int in_count);
+
+/** most frames resampler_convert() can give for 'in_count' more frames in */
+int resampler_out_frames(Resampler *r, int in_count);
+
+/** drop the input & the filter history (seek) */
+void resampler_reset(Resampler *r);
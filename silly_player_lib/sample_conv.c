@@ -0,0 +1,1280 @@
+#include <math.h>
+#include <SDL.h>
+
+#include "c99defs.h"
+#include "sample_conv.h"
+
+#include <libavutil/channel_layout.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SAMPLE_CONV_X86
+#include <immintrin.h>
+
+//msvc emits any intrinsic, gcc/clang only inside functions built for the instruction set
+#ifdef _MSC_VER
+#define TARGET_SSE2
+#define TARGET_AVX2
+#else
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+/** ************** scalar, also finishes the tails of the SIMD loops ************** */
+static void interleave2_flt_c(float *dst, const float *left, const float *right, int frames){
+    int i;
+    for(i = 0; i < frames; ++i){
+        dst[2*i] = left[i];
+        dst[2*i+1] = right[i];
+    }
+}
+
+static void deinterleave2_flt_c(float *left, float *right, const float *src, int frames){
+    int i;
+    for(i = 0; i < frames; ++i){
+        left[i] = src[2*i];
+        right[i] = src[2*i+1];
+    }
+}
+
+static void s16_to_flt_c(float *dst, const int16_t *src, int count){
+    int i;
+    for(i = 0; i < count; ++i){
+        dst[i] = src[i] * (1.0f / 32768.0f);
+    }
+}
+
+static void flt_to_s16_c(int16_t *dst, const float *src, int count){
+    int i;
+    for(i = 0; i < count; ++i){
+        long v = lrintf(src[i] * 32768.0f);
+        dst[i] = (int16_t)(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+    }
+}
+
+static void mono_to_stereo_flt_c(float *dst, const float *src, int frames, float gain){
+    int i;
+    for(i = 0; i < frames; ++i){
+        dst[2*i] = dst[2*i+1] = src[i] * gain;
+    }
+}
+
+static void stereo_to_mono_flt_c(float *dst, const float *src, int frames, float gain){
+    int i;
+    for(i = 0; i < frames; ++i){
+        dst[i] = (src[2*i] + src[2*i+1]) * gain;
+    }
+}
+
+static void mix2_flt_c(float *dst, const float *a, const float *b, int frames, float gain){
+    int i;
+    for(i = 0; i < frames; ++i){
+        dst[i] = (a[i] + b[i]) * gain;
+    }
+}
+
+//frames [begin, end) of a ramp starting at frame 0
+static void gain_flt_range(float *dst, const float *src, int begin, int end, int channels, float gain, float step){
+    int i, ch;
+    for(i = begin; i < end; ++i){
+        float g = gain + (float)i * step;
+        for(ch = 0; ch < channels; ++ch){
+            dst[i*channels + ch] = src[i*channels + ch] * g;
+        }
+    }
+}
+
+static void gain_s16_range(int16_t *dst, const int16_t *src, int begin, int end, int channels, float gain, float step){
+    int i, ch;
+    for(i = begin; i < end; ++i){
+        float g = gain + (float)i * step;
+        for(ch = 0; ch < channels; ++ch){
+            long v = lrintf(src[i*channels + ch] * g);
+            dst[i*channels + ch] = (int16_t)(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+        }
+    }
+}
+
+//sin(y) on [0, pi/2] (taylor up to y^9, error < 4e-6), the same steps in every kernel
+#define XFADE_HALF_PI 1.57079633f
+#define XFADE_C3 (-1.0f / 6.0f)
+#define XFADE_C5 (1.0f / 120.0f)
+#define XFADE_C7 (-1.0f / 5040.0f)
+#define XFADE_C9 (1.0f / 362880.0f)
+
+static inline float xfade_sin(float y){
+    float y2 = y * y;
+    float p = XFADE_C9;
+    p = p * y2 + XFADE_C7;
+    p = p * y2 + XFADE_C5;
+    p = p * y2 + XFADE_C3;
+    p = p * y2 + 1.0f;
+    return p * y;
+}
+
+static inline float xfade_pos(float pos, float step, int i){
+    float x = pos + (float)i * step;
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static void crossfade_flt_range(float *dst, const float *a, const float *b, int begin, int end, int channels, float pos, float step){
+    int i, ch;
+    for(i = begin; i < end; ++i){
+        float x = xfade_pos(pos, step, i);
+        float ga = xfade_sin((1.0f - x) * XFADE_HALF_PI);
+        float gb = xfade_sin(x * XFADE_HALF_PI);
+        for(ch = 0; ch < channels; ++ch){
+            float va = a ? a[i*channels + ch] : 0.0f;
+            dst[i*channels + ch] = va * ga + b[i*channels + ch] * gb;
+        }
+    }
+}
+
+static void crossfade_s16_range(int16_t *dst, const int16_t *a, const int16_t *b, int begin, int end, int channels, float pos, float step){
+    int i, ch;
+    for(i = begin; i < end; ++i){
+        float x = xfade_pos(pos, step, i);
+        float ga = xfade_sin((1.0f - x) * XFADE_HALF_PI);
+        float gb = xfade_sin(x * XFADE_HALF_PI);
+        for(ch = 0; ch < channels; ++ch){
+            float va = a ? (float)a[i*channels + ch] : 0.0f;
+            long v = lrintf(va * ga + (float)b[i*channels + ch] * gb);
+            dst[i*channels + ch] = (int16_t)(v < -32768 ? -32768 : (v > 32767 ? 32767 : v));
+        }
+    }
+}
+
+static void crossfade_flt_c(float *dst, const float *a, const float *b, int frames, int channels, float pos, float step){
+    crossfade_flt_range(dst, a, b, 0, frames, channels, pos, step);
+}
+
+static void crossfade_s16_c(int16_t *dst, const int16_t *a, const int16_t *b, int frames, int channels, float pos, float step){
+    crossfade_s16_range(dst, a, b, 0, frames, channels, pos, step);
+}
+
+static void accumulate_flt_range(float *acc, const float *src, int begin, int end, int channels,
+    float gain_l, float gain_r, float step_l, float step_r){
+    int i;
+    if(channels == 1){
+        for(i = begin; i < end; ++i){
+            acc[i] += src[i] * (gain_l + (float)i * step_l);
+        }
+    }else{
+        for(i = begin; i < end; ++i){
+            acc[2*i] += src[2*i] * (gain_l + (float)i * step_l);
+            acc[2*i+1] += src[2*i+1] * (gain_r + (float)i * step_r);
+        }
+    }
+}
+
+static void accumulate_flt_c(float *acc, const float *src, int frames, int channels,
+    float gain_l, float gain_r, float step_l, float step_r){
+    accumulate_flt_range(acc, src, 0, frames, channels, gain_l, gain_r, step_l, step_r);
+}
+
+static void clip_flt_c(float *dst, const float *src, int count){
+    int i;
+    for(i = 0; i < count; ++i){
+        dst[i] = src[i] < -1.0f ? -1.0f : (src[i] > 1.0f ? 1.0f : src[i]);
+    }
+}
+
+static void gain_flt_c(float *dst, const float *src, int frames, int channels, float gain, float step){
+    gain_flt_range(dst, src, 0, frames, channels, gain, step);
+}
+
+static float dot_flt_c(const float *a, const float *b, int count){
+    float sum = 0.0f;
+    int i;
+    for(i = 0; i < count; ++i){
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+static void window_add_flt_c(float *acc, const float *src, const float *window, int count){
+    int i;
+    for(i = 0; i < count; ++i){
+        acc[i] += src[i] * window[i];
+    }
+}
+
+static void levels_flt_range(const float *src, int begin, int end, int channels, float *peak, float *sum){
+    int i, ch;
+    for(i = begin; i < end; ++i){
+        for(ch = 0; ch < channels; ++ch){
+            float x = src[i*channels + ch];
+            float a = x < 0.0f ? -x : x;
+            if(a > peak[ch]) peak[ch] = a;
+            sum[ch] += x * x;
+        }
+    }
+}
+
+static void levels_flt_c(const float *src, int frames, int channels, float *peak, float *sum){
+    levels_flt_range(src, 0, frames, channels, peak, sum);
+}
+
+static void gain_s16_c(int16_t *dst, const int16_t *src, int frames, int channels, float gain, float step){
+    gain_s16_range(dst, src, 0, frames, channels, gain, step);
+}
+
+//butterflies k = begin .. end - 1 of every block
+static void fft_radix2_range(float *re, float *im, int n, int h, int begin, int end, const float *wr, const float *wi){
+    int base, k;
+    for(base = 0; base < n; base += 2*h){
+        float *ar = re + base, *ai = im + base, *br = ar + h, *bi = ai + h;
+        for(k = begin; k < end; ++k){
+            float tr = br[k]*wr[k] - bi[k]*wi[k];
+            float ti = br[k]*wi[k] + bi[k]*wr[k];
+            br[k] = ar[k] - tr;
+            bi[k] = ai[k] - ti;
+            ar[k] += tr;
+            ai[k] += ti;
+        }
+    }
+}
+
+static void fft_radix4_range(float *re, float *im, int n, int h, int begin, int end,
+    const float *w1r, const float *w1i, const float *w2r, const float *w2i){
+    int base, k;
+    for(base = 0; base < n; base += 4*h){
+        float *r = re + base, *i = im + base;
+        for(k = begin; k < end; ++k){
+            //first pass (span h): a,b and c,d by W(2h)^k
+            float tr = r[k+h]*w1r[k] - i[k+h]*w1i[k], ti = r[k+h]*w1i[k] + i[k+h]*w1r[k];
+            float a1r = r[k] + tr, a1i = i[k] + ti, b1r = r[k] - tr, b1i = i[k] - ti;
+            float c1r, c1i, d1r, d1i, ur, ui, vr, vi;
+            tr = r[k+3*h]*w1r[k] - i[k+3*h]*w1i[k];
+            ti = r[k+3*h]*w1i[k] + i[k+3*h]*w1r[k];
+            c1r = r[k+2*h] + tr; c1i = i[k+2*h] + ti;
+            d1r = r[k+2*h] - tr; d1i = i[k+2*h] - ti;
+            //second pass (span 2h): by W(4h)^k, and W(4h)^(k+h) = W(4h)^k * -i
+            ur = c1r*w2r[k] - c1i*w2i[k]; ui = c1r*w2i[k] + c1i*w2r[k];
+            vi = -(d1r*w2r[k] - d1i*w2i[k]); vr = d1r*w2i[k] + d1i*w2r[k];
+            r[k] = a1r + ur; i[k] = a1i + ui;
+            r[k+2*h] = a1r - ur; i[k+2*h] = a1i - ui;
+            r[k+h] = b1r + vr; i[k+h] = b1i + vi;
+            r[k+3*h] = b1r - vr; i[k+3*h] = b1i - vi;
+        }
+    }
+}
+
+static void downmix_stereo_range(float *dst, const float *const *planes, int begin, int end, int channels,
+    const float *ml, const float *mr){
+    int i, ch;
+    for(i = begin; i < end; ++i){
+        float l = 0.0f, r = 0.0f;
+        for(ch = 0; ch < channels; ++ch){
+            l += planes[ch][i] * ml[ch];
+            r += planes[ch][i] * mr[ch];
+        }
+        dst[2*i] = l;
+        dst[2*i + 1] = r;
+    }
+}
+
+static void downmix_71_51_range(float *dst, const float *const *p, int begin, int end){
+    int i;
+    for(i = begin; i < end; ++i){
+        dst[6*i] = p[0][i];
+        dst[6*i + 1] = p[1][i];
+        dst[6*i + 2] = p[2][i];
+        dst[6*i + 3] = p[3][i];
+        dst[6*i + 4] = (p[4][i] + p[6][i]) * SAMPLE_CONV_MIX_GAIN;
+        dst[6*i + 5] = (p[5][i] + p[7][i]) * SAMPLE_CONV_MIX_GAIN;
+    }
+}
+
+static void downmix_stereo_flt_c(float *dst, const float *const *planes, int frames, int channels, const float *ml, const float *mr){
+    downmix_stereo_range(dst, planes, 0, frames, channels, ml, mr);
+}
+
+static void downmix_71_51_flt_c(float *dst, const float *const *planes, int frames){
+    downmix_71_51_range(dst, planes, 0, frames);
+}
+
+static void fft_radix2_flt_c(float *re, float *im, int n, int h, const float *wr, const float *wi){
+    fft_radix2_range(re, im, n, h, 0, h, wr, wi);
+}
+
+static void fft_radix4_flt_c(float *re, float *im, int n, int h,
+    const float *w1r, const float *w1i, const float *w2r, const float *w2i){
+    fft_radix4_range(re, im, n, h, 0, h, w1r, w1i, w2r, w2i);
+}
+
+static const SampleKernels kernels_c = {
+    "scalar",
+    interleave2_flt_c,
+    deinterleave2_flt_c,
+    s16_to_flt_c,
+    flt_to_s16_c,
+    mono_to_stereo_flt_c,
+    stereo_to_mono_flt_c,
+    mix2_flt_c,
+    gain_flt_c,
+    gain_s16_c,
+    accumulate_flt_c,
+    clip_flt_c,
+    crossfade_flt_c,
+    crossfade_s16_c,
+    dot_flt_c,
+    window_add_flt_c,
+    levels_flt_c,
+    fft_radix2_flt_c,
+    fft_radix4_flt_c,
+    downmix_stereo_flt_c,
+    downmix_71_51_flt_c
+};
+
+#ifdef SAMPLE_CONV_X86
+/** ************** SSE2: 4 floats / 8 shorts per step ************** */
+TARGET_SSE2 static void interleave2_flt_sse2(float *dst, const float *left, const float *right, int frames){
+    int i;
+    for(i = 0; i + 4 <= frames; i += 4){
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(l, r));
+    }
+    interleave2_flt_c(dst + 2*i, left + i, right + i, frames - i);
+}
+
+TARGET_SSE2 static void deinterleave2_flt_sse2(float *left, float *right, const float *src, int frames){
+    int i;
+    for(i = 0; i + 4 <= frames; i += 4){
+        __m128 a = _mm_loadu_ps(src + 2*i);
+        __m128 b = _mm_loadu_ps(src + 2*i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleave2_flt_c(left + i, right + i, src + 2*i, frames - i);
+}
+
+TARGET_SSE2 static void s16_to_flt_sse2(float *dst, const int16_t *src, int count){
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    int i;
+    for(i = 0; i + 8 <= count; i += 8){
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16); //sign extend
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    s16_to_flt_c(dst + i, src + i, count - i);
+}
+
+TARGET_SSE2 static void flt_to_s16_sse2(int16_t *dst, const float *src, int count){
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lim_hi = _mm_set1_ps(32767.0f);
+    const __m128 lim_lo = _mm_set1_ps(-32768.0f);
+    int i;
+    for(i = 0; i + 8 <= count; i += 8){
+        //clamp first: cvtps turns huge values into 0x80000000. rounds to nearest like lrintf()
+        __m128 a = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i), scale), lim_hi), lim_lo);
+        __m128 b = _mm_max_ps(_mm_min_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4), scale), lim_hi), lim_lo);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+    flt_to_s16_c(dst + i, src + i, count - i);
+}
+
+TARGET_SSE2 static void mono_to_stereo_flt_sse2(float *dst, const float *src, int frames, float gain){
+    const __m128 g = _mm_set1_ps(gain);
+    int i;
+    for(i = 0; i + 4 <= frames; i += 4){
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+        _mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(x, x));
+        _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(x, x));
+    }
+    mono_to_stereo_flt_c(dst + 2*i, src + i, frames - i, gain);
+}
+
+TARGET_SSE2 static void stereo_to_mono_flt_sse2(float *dst, const float *src, int frames, float gain){
+    const __m128 g = _mm_set1_ps(gain);
+    int i;
+    for(i = 0; i + 4 <= frames; i += 4){
+        __m128 a = _mm_loadu_ps(src + 2*i);
+        __m128 b = _mm_loadu_ps(src + 2*i + 4);
+        __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(l, r), g));
+    }
+    stereo_to_mono_flt_c(dst + i, src + 2*i, frames - i, gain);
+}
+
+TARGET_SSE2 static void mix2_flt_sse2(float *dst, const float *a, const float *b, int frames, float gain){
+    const __m128 g = _mm_set1_ps(gain);
+    int i;
+    for(i = 0; i + 4 <= frames; i += 4){
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)), g));
+    }
+    mix2_flt_c(dst + i, a + i, b + i, frames - i, gain);
+}
+
+//gain ramps: a vector holds 4 samples, i.e. 4 mono or 2 stereo frames; more channels go scalar.
+//gains are 'gain + frame * step' like the scalar code, so both give the same result
+TARGET_SSE2 static void gain_flt_sse2(float *dst, const float *src, int frames, int channels, float gain, float step){
+    const __m128 idx = channels == 1 ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    const __m128 g0 = _mm_set1_ps(gain);
+    const __m128 dg = _mm_set1_ps(step);
+    int per = 4 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m128 g = _mm_add_ps(g0, _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), idx), dg));
+            _mm_storeu_ps(dst + i*channels, _mm_mul_ps(_mm_loadu_ps(src + i*channels), g));
+        }
+    }
+    gain_flt_range(dst, src, i, frames, channels, gain, step);
+}
+
+TARGET_SSE2 static void gain_s16_sse2(int16_t *dst, const int16_t *src, int frames, int channels, float gain, float step){
+    const __m128 idx_lo = channels == 1 ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    const __m128 idx_hi = channels == 1 ? _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f) : _mm_setr_ps(2.0f, 2.0f, 3.0f, 3.0f);
+    const __m128 g0 = _mm_set1_ps(gain);
+    const __m128 dg = _mm_set1_ps(step);
+    const __m128 lim_hi = _mm_set1_ps(32767.0f);
+    const __m128 lim_lo = _mm_set1_ps(-32768.0f);
+    int per = 8 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m128 fi = _mm_set1_ps((float)i);
+            __m128 g_lo = _mm_add_ps(g0, _mm_mul_ps(_mm_add_ps(fi, idx_lo), dg));
+            __m128 g_hi = _mm_add_ps(g0, _mm_mul_ps(_mm_add_ps(fi, idx_hi), dg));
+            __m128i x = _mm_loadu_si128((const __m128i *)(src + i*channels));
+            __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16));
+            __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16));
+            lo = _mm_max_ps(_mm_min_ps(_mm_mul_ps(lo, g_lo), lim_hi), lim_lo);
+            hi = _mm_max_ps(_mm_min_ps(_mm_mul_ps(hi, g_hi), lim_hi), lim_lo);
+            _mm_storeu_si128((__m128i *)(dst + i*channels), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+        }
+    }
+    gain_s16_range(dst, src, i, frames, channels, gain, step);
+}
+
+//mono: 4 frames a vector, gains l0 l1 l2 l3. stereo: 2 frames, gains l0 r0 l1 r1
+TARGET_SSE2 static void accumulate_flt_sse2(float *acc, const float *src, int frames, int channels,
+    float gain_l, float gain_r, float step_l, float step_r){
+    const __m128 idx = channels == 1 ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    const __m128 g0 = channels == 1 ? _mm_set1_ps(gain_l) : _mm_setr_ps(gain_l, gain_r, gain_l, gain_r);
+    const __m128 dg = channels == 1 ? _mm_set1_ps(step_l) : _mm_setr_ps(step_l, step_r, step_l, step_r);
+    int per = 4 / channels;
+    int i;
+
+    for(i = 0; i + per <= frames; i += per){
+        __m128 g = _mm_add_ps(g0, _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), idx), dg));
+        __m128 a = _mm_loadu_ps(acc + i*channels);
+        _mm_storeu_ps(acc + i*channels, _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(src + i*channels), g)));
+    }
+    accumulate_flt_range(acc, src, i, frames, channels, gain_l, gain_r, step_l, step_r);
+}
+
+TARGET_SSE2 static void clip_flt_sse2(float *dst, const float *src, int count){
+    const __m128 lim_hi = _mm_set1_ps(1.0f);
+    const __m128 lim_lo = _mm_set1_ps(-1.0f);
+    int i;
+    for(i = 0; i + 4 <= count; i += 4){
+        _mm_storeu_ps(dst + i, _mm_max_ps(_mm_min_ps(_mm_loadu_ps(src + i), lim_hi), lim_lo));
+    }
+    clip_flt_c(dst + i, src + i, count - i);
+}
+
+TARGET_SSE2 static inline __m128 xfade_sin_sse2(__m128 y){
+    __m128 y2 = _mm_mul_ps(y, y);
+    __m128 p = _mm_set1_ps(XFADE_C9);
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(XFADE_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(XFADE_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(XFADE_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(p, y);
+}
+
+//gains of 4 samples starting at frame i (idx: frame of each lane relative to i)
+TARGET_SSE2 static inline void xfade_gains_sse2(int i, __m128 idx, float pos, float step, __m128 *ga, __m128 *gb){
+    const __m128 half_pi = _mm_set1_ps(XFADE_HALF_PI);
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 x = _mm_add_ps(_mm_set1_ps(pos), _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)i), idx), _mm_set1_ps(step)));
+    x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), one);
+    *ga = xfade_sin_sse2(_mm_mul_ps(_mm_sub_ps(one, x), half_pi));
+    *gb = xfade_sin_sse2(_mm_mul_ps(x, half_pi));
+}
+
+TARGET_SSE2 static void crossfade_flt_sse2(float *dst, const float *a, const float *b, int frames, int channels, float pos, float step){
+    const __m128 idx = channels == 1 ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    int per = 4 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m128 ga, gb;
+            __m128 va = a ? _mm_loadu_ps(a + i*channels) : _mm_setzero_ps();
+            xfade_gains_sse2(i, idx, pos, step, &ga, &gb);
+            _mm_storeu_ps(dst + i*channels, _mm_add_ps(_mm_mul_ps(va, ga), _mm_mul_ps(_mm_loadu_ps(b + i*channels), gb)));
+        }
+    }
+    crossfade_flt_range(dst, a, b, i, frames, channels, pos, step);
+}
+
+TARGET_SSE2 static void crossfade_s16_sse2(int16_t *dst, const int16_t *a, const int16_t *b, int frames, int channels, float pos, float step){
+    const __m128 idx_lo = channels == 1 ? _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f) : _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+    const __m128 idx_hi = channels == 1 ? _mm_setr_ps(4.0f, 5.0f, 6.0f, 7.0f) : _mm_setr_ps(2.0f, 2.0f, 3.0f, 3.0f);
+    const __m128 lim_hi = _mm_set1_ps(32767.0f);
+    const __m128 lim_lo = _mm_set1_ps(-32768.0f);
+    int per = 8 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m128 ga_lo, gb_lo, ga_hi, gb_hi;
+            __m128i xa = a ? _mm_loadu_si128((const __m128i *)(a + i*channels)) : _mm_setzero_si128();
+            __m128i xb = _mm_loadu_si128((const __m128i *)(b + i*channels));
+            __m128 a_lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(xa, xa), 16));
+            __m128 a_hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(xa, xa), 16));
+            __m128 b_lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(xb, xb), 16));
+            __m128 b_hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(xb, xb), 16));
+            __m128 lo, hi;
+
+            xfade_gains_sse2(i, idx_lo, pos, step, &ga_lo, &gb_lo);
+            xfade_gains_sse2(i, idx_hi, pos, step, &ga_hi, &gb_hi);
+            lo = _mm_add_ps(_mm_mul_ps(a_lo, ga_lo), _mm_mul_ps(b_lo, gb_lo));
+            hi = _mm_add_ps(_mm_mul_ps(a_hi, ga_hi), _mm_mul_ps(b_hi, gb_hi));
+            lo = _mm_max_ps(_mm_min_ps(lo, lim_hi), lim_lo);
+            hi = _mm_max_ps(_mm_min_ps(hi, lim_hi), lim_lo);
+            _mm_storeu_si128((__m128i *)(dst + i*channels), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+        }
+    }
+    crossfade_s16_range(dst, a, b, i, frames, channels, pos, step);
+}
+
+TARGET_SSE2 static float dot_flt_sse2(const float *a, const float *b, int count){
+    __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+    float sum[4];
+    int i;
+    for(i = 0; i + 8 <= count; i += 8){
+        s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    _mm_storeu_ps(sum, _mm_add_ps(s0, s1));
+    return sum[0] + sum[1] + sum[2] + sum[3] + dot_flt_c(a + i, b + i, count - i);
+}
+
+TARGET_SSE2 static void window_add_flt_sse2(float *acc, const float *src, const float *window, int count){
+    int i;
+    for(i = 0; i + 4 <= count; i += 4){
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(window + i))));
+    }
+    window_add_flt_c(acc + i, src + i, window + i, count - i);
+}
+
+TARGET_SSE2 static void levels_flt_sse2(const float *src, int frames, int channels, float *peak, float *sum){
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vp = _mm_setzero_ps(), vs = _mm_setzero_ps();
+    float p[4], q[4];
+    int per = 4 / channels;
+    int i = 0, lane;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m128 x = _mm_loadu_ps(src + i*channels);
+            vp = _mm_max_ps(vp, _mm_andnot_ps(sign, x));
+            vs = _mm_add_ps(vs, _mm_mul_ps(x, x));
+        }
+        //lane k holds channel k % channels
+        _mm_storeu_ps(p, vp);
+        _mm_storeu_ps(q, vs);
+        for(lane = 0; lane < 4; ++lane){
+            if(p[lane] > peak[lane % channels]) peak[lane % channels] = p[lane];
+            sum[lane % channels] += q[lane];
+        }
+    }
+    levels_flt_range(src, i, frames, channels, peak, sum);
+}
+
+//complex multiply of 4 points
+#define SSE_CMUL_RE(ar, ai, br, bi) _mm_sub_ps(_mm_mul_ps(ar, br), _mm_mul_ps(ai, bi))
+#define SSE_CMUL_IM(ar, ai, br, bi) _mm_add_ps(_mm_mul_ps(ar, bi), _mm_mul_ps(ai, br))
+
+//blocks shorter than a vector (the first passes) stay scalar
+TARGET_SSE2 static void fft_radix2_flt_sse2(float *re, float *im, int n, int h, const float *wr, const float *wi){
+    int base, k;
+    if(h < 4){
+        fft_radix2_range(re, im, n, h, 0, h, wr, wi);
+        return;
+    }
+    for(base = 0; base < n; base += 2*h){
+        float *ar = re + base, *ai = im + base, *br = ar + h, *bi = ai + h;
+        for(k = 0; k + 4 <= h; k += 4){
+            __m128 xr = _mm_loadu_ps(br + k), xi = _mm_loadu_ps(bi + k);
+            __m128 vwr = _mm_loadu_ps(wr + k), vwi = _mm_loadu_ps(wi + k);
+            __m128 tr = SSE_CMUL_RE(xr, xi, vwr, vwi), ti = SSE_CMUL_IM(xr, xi, vwr, vwi);
+            __m128 yr = _mm_loadu_ps(ar + k), yi = _mm_loadu_ps(ai + k);
+            _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+            _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+            _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+            _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+        }
+    }
+}
+
+TARGET_SSE2 static void fft_radix4_flt_sse2(float *re, float *im, int n, int h,
+    const float *w1r, const float *w1i, const float *w2r, const float *w2i){
+    int base, k;
+    if(h < 4){
+        fft_radix4_range(re, im, n, h, 0, h, w1r, w1i, w2r, w2i);
+        return;
+    }
+    for(base = 0; base < n; base += 4*h){
+        float *r = re + base, *i = im + base;
+        for(k = 0; k + 4 <= h; k += 4){
+            __m128 ar = _mm_loadu_ps(r + k), ai = _mm_loadu_ps(i + k);
+            __m128 br = _mm_loadu_ps(r + k + h), bi = _mm_loadu_ps(i + k + h);
+            __m128 cr = _mm_loadu_ps(r + k + 2*h), ci = _mm_loadu_ps(i + k + 2*h);
+            __m128 dr = _mm_loadu_ps(r + k + 3*h), di = _mm_loadu_ps(i + k + 3*h);
+            __m128 v1r = _mm_loadu_ps(w1r + k), v1i = _mm_loadu_ps(w1i + k);
+            __m128 v2r = _mm_loadu_ps(w2r + k), v2i = _mm_loadu_ps(w2i + k);
+            __m128 tr = SSE_CMUL_RE(br, bi, v1r, v1i), ti = SSE_CMUL_IM(br, bi, v1r, v1i);
+            __m128 a1r = _mm_add_ps(ar, tr), a1i = _mm_add_ps(ai, ti);
+            __m128 b1r = _mm_sub_ps(ar, tr), b1i = _mm_sub_ps(ai, ti);
+            __m128 c1r, c1i, d1r, d1i, ur, ui, vr, vi;
+            tr = SSE_CMUL_RE(dr, di, v1r, v1i);
+            ti = SSE_CMUL_IM(dr, di, v1r, v1i);
+            c1r = _mm_add_ps(cr, tr); c1i = _mm_add_ps(ci, ti);
+            d1r = _mm_sub_ps(cr, tr); d1i = _mm_sub_ps(ci, ti);
+            ur = SSE_CMUL_RE(c1r, c1i, v2r, v2i);
+            ui = SSE_CMUL_IM(c1r, c1i, v2r, v2i);
+            vr = SSE_CMUL_IM(d1r, d1i, v2r, v2i);  //times -i: (re, im) -> (im, -re)
+            vi = _mm_sub_ps(_mm_setzero_ps(), SSE_CMUL_RE(d1r, d1i, v2r, v2i));
+            _mm_storeu_ps(r + k, _mm_add_ps(a1r, ur));
+            _mm_storeu_ps(i + k, _mm_add_ps(a1i, ui));
+            _mm_storeu_ps(r + k + 2*h, _mm_sub_ps(a1r, ur));
+            _mm_storeu_ps(i + k + 2*h, _mm_sub_ps(a1i, ui));
+            _mm_storeu_ps(r + k + h, _mm_add_ps(b1r, vr));
+            _mm_storeu_ps(i + k + h, _mm_add_ps(b1i, vi));
+            _mm_storeu_ps(r + k + 3*h, _mm_sub_ps(b1r, vr));
+            _mm_storeu_ps(i + k + 3*h, _mm_sub_ps(b1i, vi));
+        }
+    }
+}
+
+TARGET_SSE2 static void downmix_stereo_flt_sse2(float *dst, const float *const *planes, int frames, int channels,
+    const float *ml, const float *mr){
+    __m128 wl[8], wr[8];
+    int i = 0, ch;
+
+    if(channels <= 8){
+        for(ch = 0; ch < channels; ++ch){
+            wl[ch] = _mm_set1_ps(ml[ch]);
+            wr[ch] = _mm_set1_ps(mr[ch]);
+        }
+        for(; i + 4 <= frames; i += 4){
+            __m128 l = _mm_setzero_ps(), r = _mm_setzero_ps();
+            for(ch = 0; ch < channels; ++ch){
+                __m128 x = _mm_loadu_ps(planes[ch] + i);
+                l = _mm_add_ps(l, _mm_mul_ps(x, wl[ch]));
+                r = _mm_add_ps(r, _mm_mul_ps(x, wr[ch]));
+            }
+            _mm_storeu_ps(dst + 2*i, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(dst + 2*i + 4, _mm_unpackhi_ps(l, r));
+        }
+    }
+    downmix_stereo_range(dst, planes, i, frames, channels, ml, mr);
+}
+
+//4 frames: the front 4 planes are transposed into frames, the surround pair goes after each
+TARGET_SSE2 static void downmix_71_51_flt_sse2(float *dst, const float *const *p, int frames){
+    const __m128 g = _mm_set1_ps(SAMPLE_CONV_MIX_GAIN);
+    int i;
+    for(i = 0; i + 4 <= frames; i += 4){
+        __m128 f0 = _mm_loadu_ps(p[0] + i), f1 = _mm_loadu_ps(p[1] + i);
+        __m128 f2 = _mm_loadu_ps(p[2] + i), f3 = _mm_loadu_ps(p[3] + i);
+        __m128 sl = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p[4] + i), _mm_loadu_ps(p[6] + i)), g);
+        __m128 sr = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p[5] + i), _mm_loadu_ps(p[7] + i)), g);
+        __m128 lo = _mm_unpacklo_ps(sl, sr), hi = _mm_unpackhi_ps(sl, sr);
+        float *d = dst + 6*i;
+
+        _MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+        _mm_storeu_ps(d, f0);
+        _mm_storel_pi((__m64 *)(d + 4), lo);
+        _mm_storeu_ps(d + 6, f1);
+        _mm_storeh_pi((__m64 *)(d + 10), lo);
+        _mm_storeu_ps(d + 12, f2);
+        _mm_storel_pi((__m64 *)(d + 16), hi);
+        _mm_storeu_ps(d + 18, f3);
+        _mm_storeh_pi((__m64 *)(d + 22), hi);
+    }
+    downmix_71_51_range(dst, p, i, frames);
+}
+
+static const SampleKernels kernels_sse2 = {
+    "sse2",
+    interleave2_flt_sse2,
+    deinterleave2_flt_sse2,
+    s16_to_flt_sse2,
+    flt_to_s16_sse2,
+    mono_to_stereo_flt_sse2,
+    stereo_to_mono_flt_sse2,
+    mix2_flt_sse2,
+    gain_flt_sse2,
+    gain_s16_sse2,
+    accumulate_flt_sse2,
+    clip_flt_sse2,
+    crossfade_flt_sse2,
+    crossfade_s16_sse2,
+    dot_flt_sse2,
+    window_add_flt_sse2,
+    levels_flt_sse2,
+    fft_radix2_flt_sse2,
+    fft_radix4_flt_sse2,
+    downmix_stereo_flt_sse2,
+    downmix_71_51_flt_sse2
+};
+
+/** ************** AVX2: 8 floats / 16 shorts per step ************** */
+//unpack works per 128-bit lane, put the halves back in order
+#define AVX_LANES_LO(lo, hi) _mm256_permute2f128_ps(lo, hi, 0x20)
+#define AVX_LANES_HI(lo, hi) _mm256_permute2f128_ps(lo, hi, 0x31)
+#define AVX_EVEN_ODD(x) _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(x), _MM_SHUFFLE(3, 1, 2, 0)))
+
+TARGET_AVX2 static void interleave2_flt_avx2(float *dst, const float *left, const float *right, int frames){
+    int i;
+    for(i = 0; i + 8 <= frames; i += 8){
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        __m256 lo = _mm256_unpacklo_ps(l, r);
+        __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + 2*i, AVX_LANES_LO(lo, hi));
+        _mm256_storeu_ps(dst + 2*i + 8, AVX_LANES_HI(lo, hi));
+    }
+    interleave2_flt_c(dst + 2*i, left + i, right + i, frames - i);
+}
+
+TARGET_AVX2 static void deinterleave2_flt_avx2(float *left, float *right, const float *src, int frames){
+    int i;
+    for(i = 0; i + 8 <= frames; i += 8){
+        __m256 a = _mm256_loadu_ps(src + 2*i);
+        __m256 b = _mm256_loadu_ps(src + 2*i + 8);
+        _mm256_storeu_ps(left + i, AVX_EVEN_ODD(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+        _mm256_storeu_ps(right + i, AVX_EVEN_ODD(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+    }
+    deinterleave2_flt_c(left + i, right + i, src + 2*i, frames - i);
+}
+
+TARGET_AVX2 static void s16_to_flt_avx2(float *dst, const int16_t *src, int count){
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    int i;
+    for(i = 0; i + 16 <= count; i += 16){
+        __m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    s16_to_flt_c(dst + i, src + i, count - i);
+}
+
+TARGET_AVX2 static void flt_to_s16_avx2(int16_t *dst, const float *src, int count){
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 lim_hi = _mm256_set1_ps(32767.0f);
+    const __m256 lim_lo = _mm256_set1_ps(-32768.0f);
+    int i;
+    for(i = 0; i + 16 <= count; i += 16){
+        __m256 a = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), scale), lim_hi), lim_lo);
+        __m256 b = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale), lim_hi), lim_lo);
+        __m256i s = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b)); //per lane: a0 b0 a1 b1
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    flt_to_s16_c(dst + i, src + i, count - i);
+}
+
+TARGET_AVX2 static void mono_to_stereo_flt_avx2(float *dst, const float *src, int frames, float gain){
+    const __m256 g = _mm256_set1_ps(gain);
+    int i;
+    for(i = 0; i + 8 <= frames; i += 8){
+        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+        __m256 lo = _mm256_unpacklo_ps(x, x);
+        __m256 hi = _mm256_unpackhi_ps(x, x);
+        _mm256_storeu_ps(dst + 2*i, AVX_LANES_LO(lo, hi));
+        _mm256_storeu_ps(dst + 2*i + 8, AVX_LANES_HI(lo, hi));
+    }
+    mono_to_stereo_flt_c(dst + 2*i, src + i, frames - i, gain);
+}
+
+TARGET_AVX2 static void stereo_to_mono_flt_avx2(float *dst, const float *src, int frames, float gain){
+    const __m256 g = _mm256_set1_ps(gain);
+    int i;
+    for(i = 0; i + 8 <= frames; i += 8){
+        __m256 a = _mm256_loadu_ps(src + 2*i);
+        __m256 b = _mm256_loadu_ps(src + 2*i + 8);
+        __m256 sum = _mm256_add_ps(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm256_storeu_ps(dst + i, AVX_EVEN_ODD(_mm256_mul_ps(sum, g)));
+    }
+    stereo_to_mono_flt_c(dst + i, src + 2*i, frames - i, gain);
+}
+
+TARGET_AVX2 static void mix2_flt_avx2(float *dst, const float *a, const float *b, int frames, float gain){
+    const __m256 g = _mm256_set1_ps(gain);
+    int i;
+    for(i = 0; i + 8 <= frames; i += 8){
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)), g));
+    }
+    mix2_flt_c(dst + i, a + i, b + i, frames - i, gain);
+}
+
+TARGET_AVX2 static void gain_flt_avx2(float *dst, const float *src, int frames, int channels, float gain, float step){
+    const __m256 idx = channels == 1 ? _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+        : _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    const __m256 g0 = _mm256_set1_ps(gain);
+    const __m256 dg = _mm256_set1_ps(step);
+    int per = 8 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m256 g = _mm256_add_ps(g0, _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)i), idx), dg));
+            _mm256_storeu_ps(dst + i*channels, _mm256_mul_ps(_mm256_loadu_ps(src + i*channels), g));
+        }
+    }
+    gain_flt_range(dst, src, i, frames, channels, gain, step);
+}
+
+TARGET_AVX2 static void gain_s16_avx2(int16_t *dst, const int16_t *src, int frames, int channels, float gain, float step){
+    const __m256 idx_lo = channels == 1 ? _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+        : _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    const __m256 idx_hi = _mm256_add_ps(idx_lo, _mm256_set1_ps(channels == 1 ? 8.0f : 4.0f));
+    const __m256 g0 = _mm256_set1_ps(gain);
+    const __m256 dg = _mm256_set1_ps(step);
+    const __m256 lim_hi = _mm256_set1_ps(32767.0f);
+    const __m256 lim_lo = _mm256_set1_ps(-32768.0f);
+    int per = 16 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m256 fi = _mm256_set1_ps((float)i);
+            __m256 g_lo = _mm256_add_ps(g0, _mm256_mul_ps(_mm256_add_ps(fi, idx_lo), dg));
+            __m256 g_hi = _mm256_add_ps(g0, _mm256_mul_ps(_mm256_add_ps(fi, idx_hi), dg));
+            __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i*channels))));
+            __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i*channels + 8))));
+            __m256i s;
+            lo = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(lo, g_lo), lim_hi), lim_lo);
+            hi = _mm256_max_ps(_mm256_min_ps(_mm256_mul_ps(hi, g_hi), lim_hi), lim_lo);
+            s = _mm256_packs_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+            _mm256_storeu_si256((__m256i *)(dst + i*channels), _mm256_permute4x64_epi64(s, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+    }
+    gain_s16_range(dst, src, i, frames, channels, gain, step);
+}
+
+TARGET_AVX2 static void accumulate_flt_avx2(float *acc, const float *src, int frames, int channels,
+    float gain_l, float gain_r, float step_l, float step_r){
+    const __m256 idx = channels == 1 ? _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+        : _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    const __m256 g0 = channels == 1 ? _mm256_set1_ps(gain_l)
+        : _mm256_setr_ps(gain_l, gain_r, gain_l, gain_r, gain_l, gain_r, gain_l, gain_r);
+    const __m256 dg = channels == 1 ? _mm256_set1_ps(step_l)
+        : _mm256_setr_ps(step_l, step_r, step_l, step_r, step_l, step_r, step_l, step_r);
+    int per = 8 / channels;
+    int i;
+
+    for(i = 0; i + per <= frames; i += per){
+        __m256 g = _mm256_add_ps(g0, _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)i), idx), dg));
+        __m256 a = _mm256_loadu_ps(acc + i*channels);
+        _mm256_storeu_ps(acc + i*channels, _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(src + i*channels), g)));
+    }
+    accumulate_flt_range(acc, src, i, frames, channels, gain_l, gain_r, step_l, step_r);
+}
+
+TARGET_AVX2 static void clip_flt_avx2(float *dst, const float *src, int count){
+    const __m256 lim_hi = _mm256_set1_ps(1.0f);
+    const __m256 lim_lo = _mm256_set1_ps(-1.0f);
+    int i;
+    for(i = 0; i + 8 <= count; i += 8){
+        _mm256_storeu_ps(dst + i, _mm256_max_ps(_mm256_min_ps(_mm256_loadu_ps(src + i), lim_hi), lim_lo));
+    }
+    clip_flt_c(dst + i, src + i, count - i);
+}
+
+TARGET_AVX2 static inline __m256 xfade_sin_avx2(__m256 y){
+    __m256 y2 = _mm256_mul_ps(y, y);
+    __m256 p = _mm256_set1_ps(XFADE_C9);
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(XFADE_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(XFADE_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(XFADE_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(1.0f));
+    return _mm256_mul_ps(p, y);
+}
+
+TARGET_AVX2 static inline void xfade_gains_avx2(int i, __m256 idx, float pos, float step, __m256 *ga, __m256 *gb){
+    const __m256 half_pi = _mm256_set1_ps(XFADE_HALF_PI);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 x = _mm256_add_ps(_mm256_set1_ps(pos), _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps((float)i), idx), _mm256_set1_ps(step)));
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), one);
+    *ga = xfade_sin_avx2(_mm256_mul_ps(_mm256_sub_ps(one, x), half_pi));
+    *gb = xfade_sin_avx2(_mm256_mul_ps(x, half_pi));
+}
+
+TARGET_AVX2 static void crossfade_flt_avx2(float *dst, const float *a, const float *b, int frames, int channels, float pos, float step){
+    const __m256 idx = channels == 1 ? _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+        : _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    int per = 8 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m256 ga, gb;
+            __m256 va = a ? _mm256_loadu_ps(a + i*channels) : _mm256_setzero_ps();
+            xfade_gains_avx2(i, idx, pos, step, &ga, &gb);
+            _mm256_storeu_ps(dst + i*channels, _mm256_add_ps(_mm256_mul_ps(va, ga), _mm256_mul_ps(_mm256_loadu_ps(b + i*channels), gb)));
+        }
+    }
+    crossfade_flt_range(dst, a, b, i, frames, channels, pos, step);
+}
+
+//8 samples converted to float, 8 floats back to shorts (in order)
+TARGET_AVX2 static inline __m256 xfade_load_s16_avx2(const int16_t *src){
+    return src ? _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src))) : _mm256_setzero_ps();
+}
+
+TARGET_AVX2 static void crossfade_s16_avx2(int16_t *dst, const int16_t *a, const int16_t *b, int frames, int channels, float pos, float step){
+    const __m256 idx = channels == 1 ? _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)
+        : _mm256_setr_ps(0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f);
+    const __m256 lim_hi = _mm256_set1_ps(32767.0f);
+    const __m256 lim_lo = _mm256_set1_ps(-32768.0f);
+    int per = 8 / channels;
+    int i = 0;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m256 ga, gb, v;
+            __m256i w;
+            xfade_gains_avx2(i, idx, pos, step, &ga, &gb);
+            v = _mm256_add_ps(_mm256_mul_ps(xfade_load_s16_avx2(a ? a + i*channels : NULL), ga),
+                _mm256_mul_ps(xfade_load_s16_avx2(b + i*channels), gb));
+            v = _mm256_max_ps(_mm256_min_ps(v, lim_hi), lim_lo);
+            w = _mm256_cvtps_epi32(v);
+            _mm_storeu_si128((__m128i *)(dst + i*channels),
+                _mm_packs_epi32(_mm256_castsi256_si128(w), _mm256_extracti128_si256(w, 1)));
+        }
+    }
+    crossfade_s16_range(dst, a, b, i, frames, channels, pos, step);
+}
+
+TARGET_AVX2 static float dot_flt_avx2(const float *a, const float *b, int count){
+    __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps();
+    __m128 s;
+    float sum[4];
+    int i;
+    for(i = 0; i + 16 <= count; i += 16){
+        s0 = _mm256_add_ps(s0, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+        s1 = _mm256_add_ps(s1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8)));
+    }
+    s0 = _mm256_add_ps(s0, s1);
+    s = _mm_add_ps(_mm256_castps256_ps128(s0), _mm256_extractf128_ps(s0, 1));
+    _mm_storeu_ps(sum, s);
+    return sum[0] + sum[1] + sum[2] + sum[3] + dot_flt_c(a + i, b + i, count - i);
+}
+
+TARGET_AVX2 static void window_add_flt_avx2(float *acc, const float *src, const float *window, int count){
+    int i;
+    for(i = 0; i + 8 <= count; i += 8){
+        _mm256_storeu_ps(acc + i, _mm256_add_ps(_mm256_loadu_ps(acc + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(window + i))));
+    }
+    window_add_flt_c(acc + i, src + i, window + i, count - i);
+}
+
+TARGET_AVX2 static void levels_flt_avx2(const float *src, int frames, int channels, float *peak, float *sum){
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 vp = _mm256_setzero_ps(), vs = _mm256_setzero_ps();
+    float p[8], q[8];
+    int per = 8 / channels;
+    int i = 0, lane;
+
+    if(channels <= 2){
+        for(; i + per <= frames; i += per){
+            __m256 x = _mm256_loadu_ps(src + i*channels);
+            vp = _mm256_max_ps(vp, _mm256_andnot_ps(sign, x));
+            vs = _mm256_add_ps(vs, _mm256_mul_ps(x, x));
+        }
+        _mm256_storeu_ps(p, vp);
+        _mm256_storeu_ps(q, vs);
+        for(lane = 0; lane < 8; ++lane){
+            if(p[lane] > peak[lane % channels]) peak[lane % channels] = p[lane];
+            sum[lane % channels] += q[lane];
+        }
+    }
+    levels_flt_range(src, i, frames, channels, peak, sum);
+}
+
+//complex multiply of 8 points, blocks shorter than that go to SSE2
+#define AVX_CMUL_RE(ar, ai, br, bi) _mm256_sub_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi))
+#define AVX_CMUL_IM(ar, ai, br, bi) _mm256_add_ps(_mm256_mul_ps(ar, bi), _mm256_mul_ps(ai, br))
+
+TARGET_AVX2 static void fft_radix2_flt_avx2(float *re, float *im, int n, int h, const float *wr, const float *wi){
+    int base, k;
+    if(h < 8){
+        fft_radix2_flt_sse2(re, im, n, h, wr, wi);
+        return;
+    }
+    for(base = 0; base < n; base += 2*h){
+        float *ar = re + base, *ai = im + base, *br = ar + h, *bi = ai + h;
+        for(k = 0; k + 8 <= h; k += 8){
+            __m256 xr = _mm256_loadu_ps(br + k), xi = _mm256_loadu_ps(bi + k);
+            __m256 vwr = _mm256_loadu_ps(wr + k), vwi = _mm256_loadu_ps(wi + k);
+            __m256 tr = AVX_CMUL_RE(xr, xi, vwr, vwi), ti = AVX_CMUL_IM(xr, xi, vwr, vwi);
+            __m256 yr = _mm256_loadu_ps(ar + k), yi = _mm256_loadu_ps(ai + k);
+            _mm256_storeu_ps(br + k, _mm256_sub_ps(yr, tr));
+            _mm256_storeu_ps(bi + k, _mm256_sub_ps(yi, ti));
+            _mm256_storeu_ps(ar + k, _mm256_add_ps(yr, tr));
+            _mm256_storeu_ps(ai + k, _mm256_add_ps(yi, ti));
+        }
+    }
+}
+
+TARGET_AVX2 static void fft_radix4_flt_avx2(float *re, float *im, int n, int h,
+    const float *w1r, const float *w1i, const float *w2r, const float *w2i){
+    int base, k;
+    if(h < 8){
+        fft_radix4_flt_sse2(re, im, n, h, w1r, w1i, w2r, w2i);
+        return;
+    }
+    for(base = 0; base < n; base += 4*h){
+        float *r = re + base, *i = im + base;
+        for(k = 0; k + 8 <= h; k += 8){
+            __m256 ar = _mm256_loadu_ps(r + k), ai = _mm256_loadu_ps(i + k);
+            __m256 br = _mm256_loadu_ps(r + k + h), bi = _mm256_loadu_ps(i + k + h);
+            __m256 cr = _mm256_loadu_ps(r + k + 2*h), ci = _mm256_loadu_ps(i + k + 2*h);
+            __m256 dr = _mm256_loadu_ps(r + k + 3*h), di = _mm256_loadu_ps(i + k + 3*h);
+            __m256 v1r = _mm256_loadu_ps(w1r + k), v1i = _mm256_loadu_ps(w1i + k);
+            __m256 v2r = _mm256_loadu_ps(w2r + k), v2i = _mm256_loadu_ps(w2i + k);
+            __m256 tr = AVX_CMUL_RE(br, bi, v1r, v1i), ti = AVX_CMUL_IM(br, bi, v1r, v1i);
+            __m256 a1r = _mm256_add_ps(ar, tr), a1i = _mm256_add_ps(ai, ti);
+            __m256 b1r = _mm256_sub_ps(ar, tr), b1i = _mm256_sub_ps(ai, ti);
+            __m256 c1r, c1i, d1r, d1i, ur, ui, vr, vi;
+            tr = AVX_CMUL_RE(dr, di, v1r, v1i);
+            ti = AVX_CMUL_IM(dr, di, v1r, v1i);
+            c1r = _mm256_add_ps(cr, tr); c1i = _mm256_add_ps(ci, ti);
+            d1r = _mm256_sub_ps(cr, tr); d1i = _mm256_sub_ps(ci, ti);
+            ur = AVX_CMUL_RE(c1r, c1i, v2r, v2i);
+            ui = AVX_CMUL_IM(c1r, c1i, v2r, v2i);
+            vr = AVX_CMUL_IM(d1r, d1i, v2r, v2i);  //times -i: (re, im) -> (im, -re)
+            vi = _mm256_sub_ps(_mm256_setzero_ps(), AVX_CMUL_RE(d1r, d1i, v2r, v2i));
+            _mm256_storeu_ps(r + k, _mm256_add_ps(a1r, ur));
+            _mm256_storeu_ps(i + k, _mm256_add_ps(a1i, ui));
+            _mm256_storeu_ps(r + k + 2*h, _mm256_sub_ps(a1r, ur));
+            _mm256_storeu_ps(i + k + 2*h, _mm256_sub_ps(a1i, ui));
+            _mm256_storeu_ps(r + k + h, _mm256_add_ps(b1r, vr));
+            _mm256_storeu_ps(i + k + h, _mm256_add_ps(b1i, vi));
+            _mm256_storeu_ps(r + k + 3*h, _mm256_sub_ps(b1r, vr));
+            _mm256_storeu_ps(i + k + 3*h, _mm256_sub_ps(b1i, vi));
+        }
+    }
+}
+
+TARGET_AVX2 static void downmix_stereo_flt_avx2(float *dst, const float *const *planes, int frames, int channels,
+    const float *ml, const float *mr){
+    __m256 wl[8], wr[8];
+    int i = 0, ch;
+
+    if(channels <= 8){
+        for(ch = 0; ch < channels; ++ch){
+            wl[ch] = _mm256_set1_ps(ml[ch]);
+            wr[ch] = _mm256_set1_ps(mr[ch]);
+        }
+        for(; i + 8 <= frames; i += 8){
+            __m256 l = _mm256_setzero_ps(), r = _mm256_setzero_ps(), lo, hi;
+            for(ch = 0; ch < channels; ++ch){
+                __m256 x = _mm256_loadu_ps(planes[ch] + i);
+                l = _mm256_add_ps(l, _mm256_mul_ps(x, wl[ch]));
+                r = _mm256_add_ps(r, _mm256_mul_ps(x, wr[ch]));
+            }
+            lo = _mm256_unpacklo_ps(l, r);
+            hi = _mm256_unpackhi_ps(l, r);
+            _mm256_storeu_ps(dst + 2*i, AVX_LANES_LO(lo, hi));
+            _mm256_storeu_ps(dst + 2*i + 8, AVX_LANES_HI(lo, hi));
+        }
+    }
+    downmix_stereo_range(dst, planes, i, frames, channels, ml, mr);
+}
+
+static const SampleKernels kernels_avx2 = {
+    "avx2",
+    interleave2_flt_avx2,
+    deinterleave2_flt_avx2,
+    s16_to_flt_avx2,
+    flt_to_s16_avx2,
+    mono_to_stereo_flt_avx2,
+    stereo_to_mono_flt_avx2,
+    mix2_flt_avx2,
+    gain_flt_avx2,
+    gain_s16_avx2,
+    accumulate_flt_avx2,
+    clip_flt_avx2,
+    crossfade_flt_avx2,
+    crossfade_s16_avx2,
+    dot_flt_avx2,
+    window_add_flt_avx2,
+    levels_flt_avx2,
+    fft_radix2_flt_avx2,
+    fft_radix4_flt_avx2,
+    downmix_stereo_flt_avx2,
+    downmix_71_51_flt_sse2 //6 floats a frame don't tile 8 lanes, SSE2 does it as well
+};
+#endif
+
+/** ************** dispatch ************** */
+const SampleKernels *sample_kernels_for(int cpu){
+    switch(cpu){
+    case SAMPLE_CPU_SCALAR:
+        return &kernels_c;
+#ifdef SAMPLE_CONV_X86
+    case SAMPLE_CPU_SSE2:
+        return SDL_HasSSE2() ? &kernels_sse2 : NULL;
+    case SAMPLE_CPU_AVX2:
+        return SDL_HasAVX2() ? &kernels_avx2 : NULL;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+const SampleKernels *sample_kernels(void){
+    static const SampleKernels *best = NULL; //racing threads all find the same ones
+    int cpu;
+
+    if(!best){
+        for(cpu = SAMPLE_CPU_COUNT - 1; cpu >= SAMPLE_CPU_SCALAR; --cpu){
+            const SampleKernels *k = sample_kernels_for(cpu);
+            if(k){
+                best = k;
+                break;
+            }
+        }
+    }
+    return best;
+}
+
+/** ************** conversions ************** */
+//surround -> stereo, weights by plane in ffmpeg's order (FL FR FC LFE, then BL BR / SL SR). the levels of
+//swresample's default matrix (center & surrounds -3 dB, no LFE), scaled so a row sums to 1: nothing clips
+#define DOWNMIX_51_FRONT 0.41421356f    //1 / (1 + 2 * 0.7071)
+#define DOWNMIX_51_SIDE 0.29289322f     //0.7071 / (1 + 2 * 0.7071)
+#define DOWNMIX_71_FRONT 0.32037724f    //1 / (1 + 3 * 0.7071)
+#define DOWNMIX_71_SIDE 0.22654092f     //0.7071 / (1 + 3 * 0.7071)
+
+static const float downmix_51_left[6] = { DOWNMIX_51_FRONT, 0.0f, DOWNMIX_51_SIDE, 0.0f, DOWNMIX_51_SIDE, 0.0f };
+static const float downmix_51_right[6] = { 0.0f, DOWNMIX_51_FRONT, DOWNMIX_51_SIDE, 0.0f, 0.0f, DOWNMIX_51_SIDE };
+static const float downmix_71_left[8] = { DOWNMIX_71_FRONT, 0.0f, DOWNMIX_71_SIDE, 0.0f, DOWNMIX_71_SIDE, 0.0f, DOWNMIX_71_SIDE, 0.0f };
+static const float downmix_71_right[8] = { 0.0f, DOWNMIX_71_FRONT, DOWNMIX_71_SIDE, 0.0f, 0.0f, DOWNMIX_71_SIDE, 0.0f, DOWNMIX_71_SIDE };
+
+bool sample_conv_setup(SampleConv *c,
+    enum AVSampleFormat in_fmt, int64_t in_layout, int in_samplerate,
+    enum AVSampleFormat out_fmt, int64_t out_layout, int out_samplerate){
+    int in_channels = av_get_channel_layout_nb_channels(in_layout);
+    int out_channels = av_get_channel_layout_nb_channels(out_layout);
+    bool in_51 = in_layout == AV_CH_LAYOUT_5POINT1 || in_layout == AV_CH_LAYOUT_5POINT1_BACK;
+    bool out_51 = out_layout == AV_CH_LAYOUT_5POINT1 || out_layout == AV_CH_LAYOUT_5POINT1_BACK;
+
+    memset(c, 0, sizeof(SampleConv));
+    if(in_samplerate != out_samplerate){
+        return false;
+    }
+
+    //surround decoders (ac3, aac, dts...) give planar float: the common downmixes are fixed matrices
+    if(in_fmt == AV_SAMPLE_FMT_FLTP && out_fmt == AV_SAMPLE_FMT_FLT){
+        if(in_51 && out_layout == AV_CH_LAYOUT_STEREO){
+            c->kind = SAMPLE_CONV_SURROUND_STEREO;
+            c->matrix_l = downmix_51_left;
+            c->matrix_r = downmix_51_right;
+        }else if(in_layout == AV_CH_LAYOUT_7POINT1 && out_layout == AV_CH_LAYOUT_STEREO){
+            c->kind = SAMPLE_CONV_SURROUND_STEREO;
+            c->matrix_l = downmix_71_left;
+            c->matrix_r = downmix_71_right;
+        }else if(in_layout == AV_CH_LAYOUT_7POINT1 && out_51){
+            c->kind = SAMPLE_CONV_SURROUND_71_51;
+        }
+        if(c->kind != SAMPLE_CONV_NONE){
+            c->channels = in_channels;
+            c->in_frame_bytes = in_channels * (int)sizeof(float);
+            c->kernels = sample_kernels();
+            return true;
+        }
+    }
+
+    if(in_channels < 1 || in_channels > 2 || out_channels < 1 || out_channels > 2){
+        return false;
+    }
+
+    //one plane is the same data planar or packed
+    if(in_channels == 1){
+        in_fmt = av_get_packed_sample_fmt(in_fmt);
+    }
+    if(out_channels == 1){
+        out_fmt = av_get_packed_sample_fmt(out_fmt);
+    }
+
+    if(in_channels == out_channels){
+        if(in_fmt == out_fmt && !av_sample_fmt_is_planar(in_fmt)){
+            c->kind = SAMPLE_CONV_COPY;
+        }else if(in_fmt == AV_SAMPLE_FMT_FLTP && out_fmt == AV_SAMPLE_FMT_FLT){
+            c->kind = SAMPLE_CONV_INTERLEAVE;
+        }else if(in_fmt == AV_SAMPLE_FMT_FLT && out_fmt == AV_SAMPLE_FMT_FLTP){
+            c->kind = SAMPLE_CONV_DEINTERLEAVE;
+        }else if(in_fmt == AV_SAMPLE_FMT_S16 && out_fmt == AV_SAMPLE_FMT_FLT){
+            c->kind = SAMPLE_CONV_S16_TO_FLT;
+        }else if(in_fmt == AV_SAMPLE_FMT_FLT && out_fmt == AV_SAMPLE_FMT_S16){
+            c->kind = SAMPLE_CONV_FLT_TO_S16;
+        }
+    }else if(out_fmt == AV_SAMPLE_FMT_FLT){
+        if(in_channels == 1 && in_fmt == AV_SAMPLE_FMT_FLT){
+            c->kind = SAMPLE_CONV_UPMIX;
+        }else if(in_channels == 2 && in_fmt == AV_SAMPLE_FMT_FLT){
+            c->kind = SAMPLE_CONV_DOWNMIX;
+        }else if(in_channels == 2 && in_fmt == AV_SAMPLE_FMT_FLTP){
+            c->kind = SAMPLE_CONV_DOWNMIX_PLANAR;
+        }
+    }
+
+    c->channels = in_channels;
+    c->in_frame_bytes = in_channels * av_get_bytes_per_sample(in_fmt);
+    c->kernels = sample_kernels();
+    return c->kind != SAMPLE_CONV_NONE;
+}
+
+void sample_conv_run(const SampleConv *c, uint8_t **out, const uint8_t **in, int frames){
+    const SampleKernels *k = c->kernels;
+
+    switch(c->kind){
+    case SAMPLE_CONV_COPY:
+        memcpy(out[0], in[0], (size_t)frames * c->in_frame_bytes);
+        break;
+    case SAMPLE_CONV_INTERLEAVE:
+        k->interleave2_flt((float *)out[0], (const float *)in[0], (const float *)in[1], frames);
+        break;
+    case SAMPLE_CONV_DEINTERLEAVE:
+        k->deinterleave2_flt((float *)out[0], (float *)out[1], (const float *)in[0], frames);
+        break;
+    case SAMPLE_CONV_S16_TO_FLT:
+        k->s16_to_flt((float *)out[0], (const int16_t *)in[0], frames * c->channels);
+        break;
+    case SAMPLE_CONV_FLT_TO_S16:
+        k->flt_to_s16((int16_t *)out[0], (const float *)in[0], frames * c->channels);
+        break;
+    case SAMPLE_CONV_UPMIX:
+        k->mono_to_stereo_flt((float *)out[0], (const float *)in[0], frames, SAMPLE_CONV_MIX_GAIN);
+        break;
+    case SAMPLE_CONV_DOWNMIX:
+        k->stereo_to_mono_flt((float *)out[0], (const float *)in[0], frames, SAMPLE_CONV_MIX_GAIN);
+        break;
+    case SAMPLE_CONV_DOWNMIX_PLANAR:
+        k->mix2_flt((float *)out[0], (const float *)in[0], (const float *)in[1], frames, SAMPLE_CONV_MIX_GAIN);
+        break;
+    case SAMPLE_CONV_SURROUND_STEREO:
+        k->downmix_stereo_flt((float *)out[0], (const float *const *)in, frames, c->channels, c->matrix_l, c->matrix_r);
+        break;
+    case SAMPLE_CONV_SURROUND_71_51:
+        k->downmix_71_51_flt((float *)out[0], (const float *const *)in, frames);
+        break;
+    }
+}
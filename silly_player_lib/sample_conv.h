@@ -0,0 +1,99 @@
+#pragma once
+
+#include "c99defs.h"
+
+#include <libavutil/samplefmt.h>
+
+#define SAMPLE_CONV_MIX_GAIN 0.70710678f //mono<->stereo level, the same as swresample's default matrix
+
+enum{
+    SAMPLE_CPU_SCALAR,
+    SAMPLE_CPU_SSE2,
+    SAMPLE_CPU_AVX2,
+    SAMPLE_CPU_COUNT
+};
+
+//sample format kernels of one instruction set. counts are frames unless named 'count' (samples).
+//pointers need no alignment.
+typedef struct SampleKernels{
+    const char *name;
+    void (*interleave2_flt)(float *dst, const float *left, const float *right, int frames);
+    void (*deinterleave2_flt)(float *left, float *right, const float *src, int frames);
+    void (*s16_to_flt)(float *dst, const int16_t *src, int count);
+    void (*flt_to_s16)(int16_t *dst, const float *src, int count); //clipped
+    void (*mono_to_stereo_flt)(float *dst, const float *src, int frames, float gain);
+    void (*stereo_to_mono_flt)(float *dst, const float *src, int frames, float gain); //interleaved stereo
+    void (*mix2_flt)(float *dst, const float *a, const float *b, int frames, float gain); //planar stereo
+
+    //interleaved, frame i gets 'gain + i * step' (step 0: constant gain). dst may be src
+    void (*gain_flt)(float *dst, const float *src, int frames, int channels, float gain, float step);
+    void (*gain_s16)(int16_t *dst, const int16_t *src, int frames, int channels, float gain, float step); //clipped
+
+    //mixing (mono/stereo interleaved): acc += src * gain, left & right ramp on their own
+    void (*accumulate_flt)(float *acc, const float *src, int frames, int channels,
+        float gain_l, float gain_r, float step_l, float step_r);
+    void (*clip_flt)(float *dst, const float *src, int count); //saturate to [-1, 1]
+
+    //equal-power crossfade (mono/stereo interleaved): dst = a * cos(x * pi/2) + b * sin(x * pi/2),
+    //frame i at x = pos + i * step, clamped to [0, 1]. a may be NULL (silence), dst may be a or b
+    void (*crossfade_flt)(float *dst, const float *a, const float *b, int frames, int channels, float pos, float step);
+    void (*crossfade_s16)(int16_t *dst, const int16_t *a, const int16_t *b, int frames, int channels, float pos, float step); //clipped
+
+    //time-stretch (see stretch.c): sum of a[i] * b[i], and acc += src * window
+    float (*dot_flt)(const float *a, const float *b, int count);
+    void (*window_add_flt)(float *acc, const float *src, const float *window, int count);
+
+    //meters (mono/stereo interleaved, see meter.c): peak[ch] = max(peak[ch], |x|), sum[ch] += x * x
+    void (*levels_flt)(const float *src, int frames, int channels, float *peak, float *sum);
+
+    //FFT passes (split complex, bit-reversed input, see fft.c) over 'n' points in blocks of 2h / 4h.
+    //radix 2: twiddle w[k] = W(2h)^k. radix 4 (two radix-2 passes in one): w1[k] = W(2h)^k, w2[k] = W(4h)^k
+    void (*fft_radix2_flt)(float *re, float *im, int n, int h, const float *wr, const float *wi);
+    void (*fft_radix4_flt)(float *re, float *im, int n, int h,
+        const float *w1r, const float *w1i, const float *w2r, const float *w2i);
+
+    //surround downmix of planar float (up to 8 planes): to interleaved stereo by a matrix (ml / mr: weight
+    //of every plane in left / right), and 7.1 to interleaved 5.1 (backs & sides summed, ffmpeg's order)
+    void (*downmix_stereo_flt)(float *dst, const float *const *planes, int frames, int channels, const float *ml, const float *mr);
+    void (*downmix_71_51_flt)(float *dst, const float *const *planes, int frames);
+}SampleKernels;
+
+/** kernels of the best instruction set the CPU has (detected on first use) */
+const SampleKernels *sample_kernels(void);
+
+/** kernels of one instruction set (SAMPLE_CPU_*), NULL if not built in or not supported by the CPU */
+const SampleKernels *sample_kernels_for(int cpu);
+
+//a conversion done by the kernels instead of swresample: same samplerate,
+//mono/stereo, packed/planar float or packed s16, and the common surround downmixes of planar float.
+typedef struct SampleConv{
+    int kind; //SAMPLE_CONV_NONE: the kernels can't do it, use swresample
+    int channels; //input channels
+    int in_frame_bytes; //packed input
+    const float *matrix_l; //SAMPLE_CONV_SURROUND_STEREO: weight of every plane in left / right
+    const float *matrix_r;
+    const SampleKernels *kernels;
+}SampleConv;
+
+enum{
+    SAMPLE_CONV_NONE,
+    SAMPLE_CONV_COPY,
+    SAMPLE_CONV_INTERLEAVE,     //FLTP stereo -> FLT stereo
+    SAMPLE_CONV_DEINTERLEAVE,   //FLT stereo -> FLTP stereo
+    SAMPLE_CONV_S16_TO_FLT,
+    SAMPLE_CONV_FLT_TO_S16,
+    SAMPLE_CONV_UPMIX,          //FLT(P) mono -> FLT stereo
+    SAMPLE_CONV_DOWNMIX,        //FLT stereo -> FLT mono
+    SAMPLE_CONV_DOWNMIX_PLANAR, //FLTP stereo -> FLT mono
+    SAMPLE_CONV_SURROUND_STEREO,//FLTP 5.1 / 7.1 -> FLT stereo
+    SAMPLE_CONV_SURROUND_71_51  //FLTP 7.1 -> FLT 5.1
+};
+
+/** pick a kernel for the conversion (layouts: AV_CH_LAYOUT_*), return false if it needs swresample
+ *  (resampling, other layouts...) */
+bool sample_conv_setup(SampleConv *c,
+    enum AVSampleFormat in_fmt, int64_t in_layout, int in_samplerate,
+    enum AVSampleFormat out_fmt, int64_t out_layout, int out_samplerate);
+
+/** convert 'frames' frames, planes like swr_convert() (one for packed formats) */
+void sample_conv_run(const SampleConv *c, uint8_t **out, const uint8_t **in, int frames);
@@ -11,12 +11,16 @@
 #include <SDL.h>
 
 #include "audio.h"
+#include "mixer.h"
 #include "video.h"
 #include "packet_queue.h"
 #include "parse.h"
+#include "playlist.h"
+#include "tap.h"
 #include "silly_player_internal.h"
 #include "silly_player.h"
 
+#include "util/bmem.h"
 #include "util/darray.h"
 #include "util/dstr.h"
 #include "util/platform.h"
@@ -26,21 +30,24 @@
 #include "util/windows/win-version.h"
 #endif
 
-extern int global_exit;
-extern int global_exit_parse;
-extern int active;
-extern int pause_on;
+static silly_player_t *default_player = NULL; //instance behind the silly_audio_*() API
 
-static volatile VideoState *is = NULL; //global video state
+static int silly_player_open_internal(VideoState *is, const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained, bool loop, bool headless);
+static int silly_player_fetch_internal(VideoState *is, float *sample_buffer, int sample_buffer_size, bool blocking);
 
 //invoke me while nothing is active !!!
-static void silly_audio_reset()
+static void silly_player_reset(VideoState *is)
 {
 	is->loop = 0;
+	is->headless = false;
 
 	//audio related
 	is->audio_stream_index = -1;
 	is->seek_pos_sec = 0;
+	is->seek_req = false;
+	is->seek_req_time = 0;
+	is->seek_serial = 0;
+	is->seek_latency = -1.0;
 	
 	is->audiospec.channels = SA_CH_LAYOUT_INVAL;
 	is->audiospec.format = SA_SAMPLE_FMT_INVAL;
@@ -48,20 +55,29 @@ static void silly_audio_reset()
 	is->audiospec.samples = 0;
 
 	is->current_clock = 0;
+	is->clock_base = 0.0;
+	is->clock_time = 0;
+	is->clock_span = 0.0;
+	is->clock_speed = 0.0f;
+	is->clock_pending = false;
+	is->track_decoded = 0;
+	is->track_played = 0;
 	is->audio_clock;
 
 	packet_queue_clear(&is->audioq);
 
 	if (is->audio_pkt_ptr) {
-		av_free_packet(is->audio_pkt_ptr);
+		av_packet_unref(is->audio_pkt_ptr);
 		is->audio_pkt_ptr = NULL;
 	}
 	is->audio_pkt_data = NULL;
 	is->audio_pkt_size = 0;
+	is->audio_pkt_serial = 0;
+	is->audio_pkt_eof = false;
 
-	memset(is->audio_buf, 0, sizeof(is->audio_buf));
 	is->audio_buf_size = 0;
 	is->audio_buf_index = 0;
+	is->audio_buf_serial = 0;
 
 	//video related
 	is->video_stream_index = -1;
@@ -69,28 +85,78 @@ static void silly_audio_reset()
 	memset(is->filename, 0, sizeof(is->filename));
 }
 
-//initialize silly audio
-int silly_audio_initialize()
+//create a player instance, each instance plays one stream on its own audio device
+//return the instance, NULL on error
+silly_player_t *silly_player_create()
 {
+	VideoState *is;
+
+	if (silly_global_init() != 0)
+		return NULL;
+
 	is = av_mallocz(sizeof(VideoState)); //memory allocation with alignment???
+	if (!is) {
+		silly_global_uninit();
+		return NULL;
+	}
 
-	pthread_mutex_init_value(&is->audio_fetch_buffer_mutex);
-	if (pthread_mutex_init(&is->audio_fetch_buffer_mutex, NULL) != 0)
-		return -1;
+	if (os_event_init(&is->audio_fetch_event, OS_EVENT_TYPE_AUTO) != 0) {
+		av_free(is);
+		silly_global_uninit();
+		return NULL;
+	}
 
-	return 0;
+	if (packet_queue_init(&is->audioq) != 0) {
+		os_event_destroy(is->audio_fetch_event);
+		av_free(is);
+		silly_global_uninit();
+		return NULL;
+	}
+
+	if (tap_init(is) != 0) {
+		packet_queue_destroy(&is->audioq);
+		os_event_destroy(is->audio_fetch_event);
+		av_free(is);
+		silly_global_uninit();
+		return NULL;
+	}
+
+	if (playlist_init(is) != 0) {
+		tap_free(is);
+		packet_queue_destroy(&is->audioq);
+		os_event_destroy(is->audio_fetch_event);
+		av_free(is);
+		silly_global_uninit();
+		return NULL;
+	}
+
+	is->pcm_latency_ms = PCM_LATENCY_MS;
+	is->volume = 1.0f;
+	is->volume_applied = 1.0f;
+	is->tempo = 1.0f;
+
+	return is;
 }
 
-//un-initialize silly audio
-void silly_audio_destroy()
+//destroy a player instance (closes it first)
+void silly_player_destroy(silly_player_t *is)
 {
-	pthread_mutex_destroy(&is->audio_fetch_buffer_mutex);
+	if (!is) return;
+
+	silly_player_close(is);
+	silly_player_fetch_stop(is);
+	tap_free(is);
+	playlist_free(is);
+
+	packet_queue_destroy(&is->audioq);
+	os_event_destroy(is->audio_fetch_event);
 
 	av_free(is);
-	is = NULL;
+
+	silly_global_uninit();
 }
 
-static int open_input()
+static int open_input(VideoState *is)
 {
 	if (avformat_open_input(&is->pFormatCtx, is->filename, NULL, NULL) != 0)
 	{
@@ -103,15 +169,16 @@ static int open_input()
 		return -1;
 	}
 	av_dump_format(is->pFormatCtx, 0, is->filename, 0);
+	sa_publish_duration(is);
 	return 0;
 }
 
-static void close_input()
+static void close_input(VideoState *is)
 {
 	avformat_close_input(&is->pFormatCtx);
 }
 
-static int stream_component_open(unsigned int stream_index, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained)
+static int stream_component_open(VideoState *is, unsigned int stream_index, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained)
 {
 	AVCodec *codec = NULL;
 	AVCodecContext *codecCtx = NULL;
@@ -140,9 +207,14 @@ static int stream_component_open(unsigned int stream_index, const silly_audiospe
 	//open SDL audio
 	if (codecCtx->codec_type == AVMEDIA_TYPE_AUDIO)
 	{
-		desired_spec.channels = sa_desired->channels == SA_CH_LAYOUT_MONO ? av_get_channel_layout_nb_channels(AV_CH_LAYOUT_MONO) : av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO);
+		//SA_CH_LAYOUT_SOURCE: as many channels as the file has (up to 7.1)
+		desired_spec.channels = SA_CH_LAYOUT_CHANNELS(sa_desired->channels == SA_CH_LAYOUT_SOURCE
+			? sa_layout_for_channels(codecCtx->channels) : sa_desired->channels);
+		if (desired_spec.channels == 0)
+			desired_spec.channels = 2;
 		desired_spec.format = sa_desired->format == SA_SAMPLE_FMT_S16 ? AUDIO_S16SYS : AUDIO_F32SYS;
-		desired_spec.freq = codecCtx->sample_rate;
+		//headless may resample (clip cache: decoded once to the rate of the device playing it)
+		desired_spec.freq = is->headless && sa_desired->samplerate > 0 ? sa_desired->samplerate : codecCtx->sample_rate;
 
 		desired_spec.silence = 0;
 		desired_spec.samples = sa_desired->samples;
@@ -150,17 +222,42 @@ static int stream_component_open(unsigned int stream_index, const silly_audiospe
 		desired_spec.callback = audio_callback;	//TODO use 'SDL_QueueAudio()' instead in a non-callback way
 		desired_spec.userdata = is;
 
-		if (SDL_OpenAudio(&desired_spec, &spec) < 0)
+		if (is->headless)
 		{
-			fprintf(stderr, "SDL_OpenAudio(): %s.\n", SDL_GetError());
-			return -1;
+			//no device: we get exactly what we asked for
+			spec = desired_spec;
+		}
+		else if (is->mixer)
+		{
+			//a voice: no device either, decoded straight to the mixer's format & rate
+			mixer_device_spec(is->mixer, &spec);
+		}
+		else
+		{
+			if (silly_global_audio_init() != 0)
+				return -1;
+
+			//one device per instance, so several players can run side by side
+			is->audio_dev = SDL_OpenAudioDevice(NULL, 0, &desired_spec, &spec, 0);
+			if (is->audio_dev == 0 && desired_spec.channels > 2)
+			{
+				//no surround output: stereo, the surround is downmixed (see sample_conv.c)
+				fprintf(stderr, "SDL_OpenAudioDevice(): %d channels: %s, falling back to stereo.\n",
+					desired_spec.channels, SDL_GetError());
+				desired_spec.channels = 2;
+				is->audio_dev = SDL_OpenAudioDevice(NULL, 0, &desired_spec, &spec, 0);
+			}
+			if (is->audio_dev == 0)
+			{
+				fprintf(stderr, "SDL_OpenAudioDevice(): %s.\n", SDL_GetError());
+				silly_global_audio_uninit();
+				return -1;
+			}
 		}
 
-		//set is->audiospec
-		if (spec.channels == av_get_channel_layout_nb_channels(AV_CH_LAYOUT_MONO))
-			is->audiospec.channels = SA_CH_LAYOUT_MONO;
-		else if (spec.channels == av_get_channel_layout_nb_channels(AV_CH_LAYOUT_STEREO))
-			is->audiospec.channels = SA_CH_LAYOUT_STEREO;
+		//set is->audiospec (the layouts are their channel counts)
+		if (spec.channels == 1 || spec.channels == 2 || spec.channels == 4 || spec.channels == 6 || spec.channels == 8)
+			is->audiospec.channels = spec.channels;
 		else
 			is->audiospec.channels = SA_CH_LAYOUT_INVAL;
 
@@ -199,26 +296,21 @@ static int stream_component_open(unsigned int stream_index, const silly_audiospe
 		is->audio_st = is->pFormatCtx->streams[stream_index];
 		is->audio_ctx = codecCtx;
 
-		//memset(&is->audio_pkt, 0, sizeof(is->audio_pkt));
-		is->audio_pkt_ptr = (AVPacket *)av_malloc(sizeof(AVPacket));
-		av_init_packet(is->audio_pkt_ptr);
-
-		//prepare conversion facility (FLTP -> S16)
-		//swr_convert()һ: һMAX_AUDIO_FRAME_SIZEֽڣ
-		is->out_buffer = (uint8_t *)av_malloc(MAX_AUDIO_FRAME_SIZE << 1);
-
-		is->swr_ctx = swr_alloc();
-		is->swr_ctx = swr_alloc_set_opts(is->swr_ctx,
-			is->audiospec.channels == SA_CH_LAYOUT_MONO ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO,	//out_ch_layout
-			is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT,		//out_sample_fmt
-			is->audiospec.samplerate,																//out_sample_rate
-			av_get_default_channel_layout(codecCtx->channels),		//in_ch_layout
-			codecCtx->sample_fmt,									//in_sample_fmt
-			codecCtx->sample_rate,									//in_sample_rate
-			0,		//log_offset
-			NULL	//log_ctx
-			);
-		swr_init(is->swr_ctx);
+		av_init_packet(&is->audio_pkt);
+		is->audio_pkt.data = NULL;
+		is->audio_pkt.size = 0;
+		is->audio_pkt_ptr = &is->audio_pkt;
+
+		//prepare conversion facility (FLTP -> S16), and room for one frame converted
+		if (audio_conv_open(is, codecCtx, &is->resampler, &is->audio_conv) != 0)
+			return -1;
+		if (audio_buf_open(is) != 0)
+			return -1;
+		//mono / stereo only: a surround device has no meter, spectrum nor time-stretch
+		meter_init(&is->meter, is->audiospec.samplerate,
+			SA_CH_LAYOUT_CHANNELS(is->audiospec.channels), is->audiospec.format == SA_SAMPLE_FMT_S16);
+		spectrum_init(&is->spectrum, is->audiospec.samplerate,
+			SA_CH_LAYOUT_CHANNELS(is->audiospec.channels), is->audiospec.format == SA_SAMPLE_FMT_S16);
 		break;
 	case AVMEDIA_TYPE_VIDEO:
 		is->video_stream_index = stream_index;
@@ -240,7 +332,7 @@ static int stream_component_open(unsigned int stream_index, const silly_audiospe
 	return 0;
 }
 
-static int open_audio_decoder(const silly_audiospec *sa_desired, silly_audiospec *sa_obtained)
+static int open_audio_decoder(VideoState *is, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained)
 {
 	unsigned int audio_stream_index = -1;
 	bool audio_stream_index_found = false;
@@ -263,7 +355,7 @@ static int open_audio_decoder(const silly_audiospec *sa_desired, silly_audiospec
 		return -1;
 	}
 
-	if (stream_component_open(audio_stream_index, sa_desired, sa_obtained) < 0)
+	if (stream_component_open(is, audio_stream_index, sa_desired, sa_obtained) < 0)
 	{
 		fprintf(stderr, "%s: could not open audio codecs.\n", is->filename);
 		return -2;
@@ -272,19 +364,28 @@ static int open_audio_decoder(const silly_audiospec *sa_desired, silly_audiospec
 	return 0;
 }
 
-static void close_audio_decoder()
+static void close_audio_decoder(VideoState *is)
 {
 	avcodec_close(is->audio_ctx);
 	avcodec_free_context(&(is->audio_ctx));
 	is->audio_ctx = NULL;
 
-	av_free(is->out_buffer);
-	swr_free(&is->swr_ctx);
+	audio_buf_close(is);
+	resampler_free(&is->resampler);
+
+	stretch_free(&is->stretch);
+	is->stretch_active = false;
+	meter_free(&is->meter);
+	spectrum_free(&is->spectrum);
 
-	SDL_CloseAudio();
+	if (is->audio_dev) {
+		SDL_CloseAudioDevice(is->audio_dev);
+		is->audio_dev = 0;
+		silly_global_audio_uninit();
+	}
 }
 
-static int open_video_decoder()
+static int open_video_decoder(VideoState *is)
 {
 	unsigned int video_stream_index = -1;
 	bool video_stream_index_found = false;
@@ -307,7 +408,7 @@ static int open_video_decoder()
 		return -1;
 	}
 	
-	if (stream_component_open(video_stream_index, NULL, NULL) < 0)
+	if (stream_component_open(is, video_stream_index, NULL, NULL) < 0)
 	{
 		fprintf(stderr, "%s: could not open video codecs.\n", is->filename);
 		return -2;
@@ -316,167 +417,262 @@ static int open_video_decoder()
 	return 0;
 }
 
-static void close_video_decoder()
+static void close_video_decoder(VideoState *is)
 {
 	avcodec_close(is->video_ctx);
 	avcodec_free_context(&(is->video_ctx));
 	is->video_ctx = NULL;
 }
 
-static SDL_Thread *parse_tid = NULL;
+//make the parse & decode threads quit, wait for the decode thread
+static void silly_player_stop_decoding(VideoState *is)
+{
+	is->exit = 1;
+	packet_queue_abort(&is->audioq);	//wakes up parse thread & decoder
+	if (is->pcm_room_event)
+		os_event_signal(is->pcm_room_event);
+
+	if (is->decode_tid) {
+		SDL_WaitThread(is->decode_tid, NULL);
+		is->decode_tid = NULL;
+	}
+}
 
 //open audio file
+//@param[in] is: player instance
 //@param[in] filename: audio to be played
 //@param[in] sa_desired: audio sepc desired
-//			sa_desired.channels:	SA_CH_LAYOUT_MONO, SA_CH_LAYOUT_STEREO
+//			sa_desired.channels:	SA_CH_LAYOUT_MONO, SA_CH_LAYOUT_STEREO, SA_CH_LAYOUT_QUAD, SA_CH_LAYOUT_5POINT1,
+//									SA_CH_LAYOUT_7POINT1, SA_CH_LAYOUT_SOURCE (the file's, stereo if the device can't)
 //			sa_desired.format:		SA_SAMPLE_FMT_S16, SA_SAMPLE_FMT_FLT
 //			sa_desired.samplerate:	UNUSED
 //			sa_desired.samples:		audio buffer size in samples (power of 2)
 //@param[out] sa_obtained: audio spec obtained
-//			sa_obtained.channels:	SA_CH_LAYOUT_MONO, SA_CH_LAYOUT_STEREO
+//			sa_obtained.channels:	SA_CH_LAYOUT_MONO ... SA_CH_LAYOUT_7POINT1
 //			sa_obtained.format:		SA_SAMPLE_FMT_S16, SA_SAMPLE_FMT_FLT
 //			sa_obtained.samplerate:	audio sample rate
 //			sa_obtained.samples:	audio buffer size in samples (power of 2)
 //@param[in] loop: playing in loop-mode or not
 //return 0 on success, negative on error
-int silly_audio_open(const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained, bool loop)
+int silly_player_open(silly_player_t *is, const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained, bool loop)
 {
-	if (active)
+	return silly_player_open_internal(is, filename, sa_desired, sa_obtained, loop, false);
+}
+
+//open audio file in headless mode: no audio device, the caller pulls PCM with
+//silly_player_read()/silly_player_decode() as fast as the CPU allows
+//@param[in] is: player instance
+//@param[in] filename: audio to be decoded
+//@param[in] sa_desired: audio sepc desired (see silly_player_open(), samples is UNUSED,
+//			samplerate resamples the stream to it, 0 keeps the stream's)
+//@param[out] sa_obtained: audio spec obtained
+//return 0 on success, negative on error
+int silly_player_open_headless(silly_player_t *is, const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained)
+{
+	return silly_player_open_internal(is, filename, sa_desired, sa_obtained, false, true);
+}
+
+//open audio file as a voice of 'mixer': decoded on this player's own threads like silly_player_open(),
+//played by the mixer's device along with its other voices. close it with silly_player_close()
+//@param[in] is: player instance
+//@param[in] mixer: see silly_mixer_create()
+//@param[in] filename: audio to be played
+//@param[in] loop: playing in loop-mode or not
+//return 0 on success, negative on error
+int silly_player_open_voice(silly_player_t *is, silly_mixer_t *mixer, const char *filename, bool loop)
+{
+	int ret;
+
+	if (!is)
+		return -8;
+	if (is->active)
+		return -1;
+	if (!mixer)
+		return -3;
+
+	is->mixer = mixer;
+	ret = silly_player_open_internal(is, filename, mixer_audiospec(mixer), NULL, loop, false);
+	if (ret != 0) {
+		is->mixer = NULL;
+		return ret;
+	}
+
+	mixer_add_voice(mixer, is);
+	return 0;
+}
+
+static int silly_player_open_internal(VideoState *is, const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained, bool loop, bool headless)
+{
+	if (!is)
+		return -8;
+	if (is->active)
 		return -1;
 	if (filename == 0 || *filename == 0)
 		return -2;
 	if (!sa_desired)
 		return -3;
 
-	global_exit = 0;
-	global_exit_parse = 0;
+	is->exit = 0;
+	is->exit_parse = 0;
 
-	silly_audio_reset();
+	silly_player_reset(is);
 
 	strncpy(is->filename, filename, sizeof(is->filename));
 	is->loop = loop;
+	is->headless = headless;
 
-	//register all formats & codecs
-	av_register_all();
-
-	//if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER))
-	if (SDL_Init(SDL_INIT_AUDIO)) {
-		fprintf(stderr, "SDL_Init() error: %s\n", SDL_GetError());
-		silly_audio_reset();
-		return -4;
-	}
-
-	if (open_input() != 0) {
-		silly_audio_reset();
+	//formats & codecs are registered (silly_global_init()), the SDL audio subsystem is brought up with the device
+	if (open_input(is) != 0) {
+		close_input(is);
+		silly_player_reset(is);
 		return -5;
 	}
 
-	if (open_audio_decoder(sa_desired, sa_obtained) != 0) {
-		silly_audio_reset();
+	if (open_audio_decoder(is, sa_desired, sa_obtained) != 0) {
+		close_audio_decoder(is);	//the device may be open already
+		close_input(is);
+		silly_player_reset(is);
 		return -6;
 	}
 
+	packet_queue_start(&is->audioq);
+
+	//decoding thread (decoding ahead of the device into is->pcm_ring), headless callers decode themselves
+	if (!is->headless) {
+		if (audio_ring_open(is, is->audiospec.samples
+			* SA_CH_LAYOUT_CHANNELS(is->audiospec.channels)
+			* (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4)) != 0) {
+			fprintf(stderr, "could not allocate the pcm ring.\n");
+			close_audio_decoder(is);
+			close_input(is);
+			silly_player_reset(is);
+			return -9;
+		}
+
+		is->decode_tid = SDL_CreateThread(audio_decode_thread, "DECODING_THREAD", is);
+		if (!is->decode_tid) {
+			fprintf(stderr, "create decoding thread failed.\n");
+			close_audio_decoder(is);
+			audio_ring_close(is);
+			close_input(is);
+			silly_player_reset(is);
+			return -10;
+		}
+	}
+
 	//parsing thread (reading packets from stream)
-	parse_tid = SDL_CreateThread(parse_thread, "PARSING_THREAD", is);
-	if (!parse_tid) {
+	is->parse_tid = SDL_CreateThread(parse_thread, "PARSING_THREAD", is);
+	if (!is->parse_tid) {
 		fprintf(stderr, "create parsing thread failed.\n");
-		silly_audio_reset();
+		silly_player_stop_decoding(is);
+		close_audio_decoder(is);
+		audio_ring_close(is);
+		close_input(is);
+		silly_player_reset(is);
 		return -7;
 	}
 
-	SDL_PauseAudio(0);
-	pause_on = 0;
+	is->active = 1;
 
-	active = 1;
+	audio_pause(is, 0); //headless: only the flag
 
 	return 0;
 }
 
 //close audio file
-void silly_audio_close()
+//@param[in] is: player instance
+void silly_player_close(silly_player_t *is)
 {
-	if (!active)
+	if (!is || !is->active)
 		return;
-	active = 0;
+	is->active = 0;
 
-	//stop parsing
-	global_exit = 1;
-	global_exit_parse = 1;
+	//a voice: make sure the mixer's callback is done with us
+	if (is->mixer) {
+		mixer_remove_voice(is->mixer, is);
+		is->mixer = NULL;
+	}
 
-	SDL_WaitThread(parse_tid, NULL);
+	//stop parsing & decoding
+	is->exit_parse = 1;
+	silly_player_stop_decoding(is);
 
-	//stop reading
-	close_audio_decoder();
-	close_input();
+	SDL_WaitThread(is->parse_tid, NULL);
+	is->parse_tid = NULL;
 
-	SDL_Quit();
+	//stop reading
+	close_audio_decoder(is);
+	audio_ring_close(is);
+	close_input(is);
+	playlist_close(is);
 
 	//reset 'is'
-	silly_audio_reset();
+	silly_player_reset(is);
 
-	//clear fetching
-	pthread_mutex_lock(&is->audio_fetch_buffer_mutex);
-	circlebuf_free(&is->audio_fetch_buffer);
-	pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
+	//clear fetching & taps: what's left belongs to this file (the device is closed, we're the producer now)
+	audio_fetch_flush(is);
 }
 
 //pause playing
-void silly_audio_pause()
+void silly_player_pause(silly_player_t *is)
 {
-	if (!active || global_exit_parse) return;
+	if (!is || !is->active || is->exit_parse) return;
 
-	SDL_PauseAudio(1);
-	pause_on = 1;
+	audio_pause(is, 1);
 }
 
 //resume playing
-void silly_audio_resume()
+void silly_player_resume(silly_player_t *is)
 {
-	if (!active || global_exit_parse) return;
+	if (!is || !is->active || is->exit_parse) return;
 
-	SDL_PauseAudio(0);
-	pause_on = 0;
+	audio_pause(is, 0);
 }
 
 //seek audio sec
+//the running parse thread serves the request; queued packets, the decoder
+//and audio_buf are flushed through the audioq serial
 //@param[in] sec: seek position in second(s)
 //return 0 on success, negative on error
-int silly_audio_seek(int sec)
+int silly_player_seek(silly_player_t *is, int sec)
 {
-	if (!active) return -1;
-
-	global_exit_parse = 1;
-	SDL_WaitThread(parse_tid, NULL);
-	global_exit_parse = 0;
+	if (!is || !is->active) return -1;
+	if (sec < 0) return -2;
 
 	is->seek_pos_sec = sec;
-	parse_tid = SDL_CreateThread(parse_thread, "PARSING_THREAD", is);
-	if (!parse_tid) {
-		fprintf(stderr, "create parsing thread failed.\n");
-		//TODO
-		return -2;
-	}
+	is->seek_req_time = os_gettime_ns();
+	os_atomic_set_bool(&is->seek_req, true);
+	packet_queue_wakeup(&is->audioq);	//parse thread may be waiting for room (or finished)
 
-	SDL_PauseAudio(0);
-	pause_on = 0;
+	audio_pause(is, 0);
 
 	return 0;
 }
 
-//get current position (in sec) of playing
+//get the latency of the last seek
+//return milliseconds from silly_audio_seek() to the first sample handed to the device, negative if unknown
+double silly_player_seek_latency(silly_player_t *is)
+{
+	if (!is || !is->active) return -1.0;
+
+	return is->seek_latency;
+}
+
+//get current position (in sec) of playing: the sample being heard, interpolated between device callbacks
+//(the output buffer of the device is taken off). lock-free, any thread; headless: the position decoded
 //return the current position in second(s), negative on error
-double silly_audio_time()
+double silly_player_time(silly_player_t *is)
 {
-	if (!active) return -1.0;						//in-active
-	//if (active && global_exit_parse) return -2.0;	//active & finished ==> audio is still playing while parsing is finished
+	if (!is || !is->active) return -1.0;			//in-active
+	//if (is->active && is->exit_parse) return -2.0;	//active & finished ==> audio is still playing while parsing is finished
 
 	return get_audio_clock(is);
 }
 
-void silly_audio_loop(bool enable)
+void silly_player_loop(silly_player_t *is, bool enable)
 {
-	if (!active) return;						//in-active
-	if (active && global_exit_parse) { //active & finished
+	if (!is || !is->active) return;			//in-active
+	if (is->active && is->exit_parse) { //active & finished
 		printf("loop failed\n");	//TODO
 		return;
 	}
@@ -486,186 +682,654 @@ void silly_audio_loop(bool enable)
 
 //get the audio duration
 //return the duration in second(s)
-double silly_audio_duration()
+double silly_player_duration(silly_player_t *is)
+{
+	if (!is || !is->active)	return -1.0;
+
+	return (double)os_atomic_load_long(&is->duration); //the decoder may be switching tracks
+}
+
+//set how much decoded audio is kept ahead of the device, applied by the next open.
+//a larger target rides out slower frames, a smaller one reacts faster
+//@param[in] ms: latency target in milliseconds (<= 0: default)
+void silly_player_set_latency(silly_player_t *is, int ms)
+{
+	if (!is) return;
+
+	is->pcm_latency_ms = ms > 0 ? ms : PCM_LATENCY_MS;
+}
+
+//pick the resampler converting the file to the device rate (and the played audio to the rates of the
+//fetcher & the taps), applied by the next open (next silly_player_fetch_start(), next tap format). the fast
+//tier suits previews
+//@param[in] quality: SA_RESAMPLE_DEFAULT, SA_RESAMPLE_FAST, SA_RESAMPLE_HIGH, SA_RESAMPLE_SPEEX
+void silly_player_set_resampler(silly_player_t *is, int quality)
+{
+	if (!is) return;
+
+	is->resample_quality = quality >= SA_RESAMPLE_DEFAULT && quality <= SA_RESAMPLE_SPEEX ? quality : SA_RESAMPLE_DEFAULT;
+}
+
+//cap the bytes the buffers of the player may hold, applied by the next open (next silly_player_fetch_start(),
+//next tap): the rings shrink to fit, lowering the latency target if needed. the decode buffers are sized
+//for one frame of the codec whatever the budget, an open or a start that can't fit fails. the stretcher &
+//the spectrum analyzer are checked as they are asked for (silly_player_set_tempo(), silly_player_set_spectrum()).
+//demuxers, decoders & resamplers (of the file open and of the queued ones opened ahead) are outside it
+//@param[in] bytes: budget in bytes (<= 0: no cap)
+void silly_player_set_mem_budget(silly_player_t *is, int64_t bytes)
+{
+	if (!is) return;
+
+	is->mem_budget = bytes > 0 ? bytes : 0;
+}
+
+//get the number of device callbacks that found no decoded audio while playing (output silence)
+//return the count since open, negative if not active
+long silly_player_underruns(silly_player_t *is)
+{
+	if (!is || !is->active) return -1;
+
+	return os_atomic_load_long(&is->underruns);
+}
+
+//set the volume of the device output, ramped over the next device buffer so it never clicks.
+//kept across open/close; fetching & taps get the samples before the volume
+//@param[in] volume: linear gain, 0.0 (mute) .. 1.0 (unchanged) .. 4.0 (+12 dB)
+void silly_player_set_volume(silly_player_t *is, float volume)
+{
+	if (!is) return;
+
+	is->volume = volume < 0.0f ? 0.0f : (volume > VOLUME_MAX ? VOLUME_MAX : volume);
+}
+
+//set the volume in dB, see silly_player_set_volume()
+//@param[in] db: 0.0 leaves the audio unchanged, -100 or less mutes
+void silly_player_set_gain_db(silly_player_t *is, float db)
+{
+	silly_player_set_volume(is, db <= -100.0f ? 0.0f : powf(10.0f, db / 20.0f));
+}
+
+//get the volume asked for (linear gain)
+float silly_player_volume(silly_player_t *is)
+{
+	return is ? is->volume : 0.0f;
+}
+
+//play faster or slower keeping the pitch (time-stretch, applied by the decode thread).
+//kept across open/close; the clock (silly_player_time()) stays in media time.
+//the stretcher counts against the memory budget: one that can't fit leaves the tempo at 1
+//@param[in] tempo: 0.5 (half speed) .. 1.0 (unchanged) .. 2.0 (double speed)
+//return 0 on success, negative on error
+int silly_player_set_tempo(silly_player_t *is, float tempo)
+{
+	if (!is) return -1;
+
+	tempo = tempo < STRETCH_TEMPO_MIN ? STRETCH_TEMPO_MIN : (tempo > STRETCH_TEMPO_MAX ? STRETCH_TEMPO_MAX : tempo);
+	if (is->active && tempo != 1.0f && !is->stretch.hann
+		&& !audio_mem_fits(is, stretch_bytes_for(is->audiospec.samplerate, SA_CH_LAYOUT_CHANNELS(is->audiospec.channels))))
+		return -2;
+
+	is->tempo = tempo;
+	return 0;
+}
+
+//get the tempo asked for
+float silly_player_tempo(silly_player_t *is)
 {
-	if (!active)	return -1.0;
+	return is ? is->tempo : 0.0f;
+}
 
-	int64_t duration = is->pFormatCtx->duration / AV_TIME_BASE;
-	return duration;
+//get the levels of the audio being decoded: peak, RMS & EBU R128 loudness of the last 100 ms block.
+//lock-free, any thread, as often as wanted; measured before the volume, about the latency target
+//ahead of what is heard (levels->clock tells which media time they belong to)
+//return 0, -1 if nothing was measured yet
+int silly_player_get_levels(silly_player_t *is, silly_levels *levels)
+{
+	if (!is || !levels) return -1;
+
+	memset(levels, 0, sizeof(*levels));
+	if (!is->active) return -1;
+
+	return meter_read(&is->meter, levels) ? 0 : -1;
 }
 
-static DARRAY(float) audio_fetch_array;	//used for conversion in 'audio fetching'
+//set up the spectrum analyzer: band magnitudes of the audio being decoded, computed by the decode
+//thread (a Hann windowed FFT of the mono downmix) 'rate' times a second. kept across open/close
+//@param[in] fft_size: 512 .. 8192, a power of 2 (frequency resolution: samplerate / fft_size), 0 to turn it off
+//@param[in] bands: 1 .. SILLY_SPECTRUM_MAX_BANDS
+//@param[in] rate: spectra per second, 1 .. 100
+//return 0 on success, negative on error (-5: over the memory budget)
+int silly_player_set_spectrum(silly_player_t *is, int fft_size, int bands, int rate)
+{
+	size_t want, held;
+	int bits = 0;
+
+	if (!is) return -1;
+	if (fft_size == 0) {
+		os_atomic_set_long(&is->spectrum_request, 0);
+		return 0;
+	}
+	if (fft_size < FFT_SIZE_MIN || fft_size > FFT_SIZE_MAX || (fft_size & (fft_size - 1))) return -2;
+	if (bands < 1 || bands > SILLY_SPECTRUM_MAX_BANDS) return -3;
+	if (rate < 1 || rate > SPECTRUM_RATE_MAX) return -4;
+
+	//the analyzer counts against the memory budget, the one it replaces is freed first
+	if (is->active) {
+		want = spectrum_bytes_for(fft_size, SA_CH_LAYOUT_CHANNELS(is->audiospec.channels));
+		held = spectrum_bytes(&is->spectrum);
+		if (want > held && !audio_mem_fits(is, want - held))
+			return -5;
+	}
+
+	while ((1 << bits) < fft_size)
+		++bits;
+	os_atomic_set_long(&is->spectrum_request, SPECTRUM_REQUEST(bits, bands, rate)); //the decoder picks it up
+	return 0;
+}
+
+//get the last spectrum (see silly_player_set_spectrum()). lock-free, any thread; like the levels
+//it is about the latency target ahead of what is heard (spectrum->clock tells which media time)
+//return 0, -1 if nothing was computed yet
+int silly_player_get_spectrum(silly_player_t *is, silly_spectrum *spectrum)
+{
+	if (!is || !spectrum) return -1;
+
+	memset(spectrum, 0, sizeof(*spectrum));
+	if (!is->active) return -1;
+
+	return spectrum_read(&is->spectrum, spectrum) ? 0 : -1;
+}
+
+//set the balance of a voice (silly_player_open_voice()), ramped like the volume.
+//kept across open/close, no effect on a mono mixer nor on a player with its own device
+//@param[in] pan: -1.0 (left only) .. 0.0 (center, both sides unchanged) .. 1.0 (right only)
+void silly_player_set_pan(silly_player_t *is, float pan)
+{
+	if (!is) return;
+
+	is->pan = pan < -1.0f ? -1.0f : (pan > 1.0f ? 1.0f : pan);
+}
+
+//read decoded PCM (headless mode), as fast as the CPU allows
+//@param[out] buffer: filled with interleaved samples in the format obtained at open
+//@param[in] buffer_size: size of buffer in bytes
+//return bytes read, 0 at the end of stream, negative on error
+int silly_player_read(silly_player_t *is, uint8_t *buffer, int buffer_size)
+{
+	if (!is || !is->active) return -1;
+	if (!is->headless) return -2;
+	if (!buffer || buffer_size <= 0) return -3;
+
+	return audio_decode_pcm(is, buffer, buffer_size);
+}
+
+//decode the whole stream (headless mode), handing every decoded frame to 'callback'
+//@param[in] callback: receives interleaved samples in the format obtained at open, returns non-zero to stop
+//@param[in] userdata: passed to callback
+//return 0 at the end of stream, 1 if stopped by callback, negative on error
+int silly_player_decode(silly_player_t *is, silly_pcm_callback callback, void *userdata)
+{
+	int size;
+
+	if (!is || !is->active) return -1;
+	if (!is->headless) return -2;
+	if (!callback) return -3;
+
+	while ((size = audio_decode_next(is)) > 0) {
+		const uint8_t *pcm = (uint8_t *)is->audio_buf + is->audio_buf_index;
+
+		is->audio_buf_index = is->audio_buf_size; //handed out, no copy
+		if (callback(userdata, pcm, size) != 0)
+			return 1;
+	}
+
+	return size;
+}
 
 //start fetching audio samples
 //@param[in] channels: SA_CH_LAYOUT_MONO / SA_CH_LAYOUT_STEREO
 //@param[in] samplerate: samplerate required
-int silly_audio_fetch_start(int channels, int samplerate)
+int silly_player_fetch_start(silly_player_t *is, int channels, int samplerate)
 {
-	if (is->active_fetch) return -1;
+	size_t capacity;
 
-	pthread_mutex_lock(&is->audio_fetch_buffer_mutex);
-	circlebuf_free(&is->audio_fetch_buffer);
-	pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
+	if (!is || is->active_fetch) return -1;
+
+	//what the memory budget leaves, if any
+	capacity = audio_ring_grant(is, AUDIO_FETCH_RING_SIZE, AUDIO_RING_MIN);
+	if (!capacity || audio_ring_init(&is->audio_fetch_ring, capacity) != 0)
+		return -2;
+	os_event_reset(is->audio_fetch_event);
 
 	is->out_channels_fetch = channels;
 	is->out_samplerate_fetch = samplerate;
 	is->in_channels_fetch = SA_CH_LAYOUT_INVAL;
 	is->in_samplerate_fetch = 0;
 	is->in_format_fetch = SA_SAMPLE_FMT_INVAL;
-	if (is->swr_ctx_fetch) {
-		swr_free(&is->swr_ctx_fetch);
-		is->swr_ctx_fetch = NULL;
-	}
-
-	da_free(audio_fetch_array);
+	resampler_free(&is->resampler_fetch);
 
-	is->active_fetch = true;
+	os_atomic_set_bool(&is->active_fetch, true); //the ring is ready: audio_callback() may feed it
 
 	return 0;
 }
 
+//wait until 'bytes' are in the fetch ring, woken by audio_callback() as data arrives
+//return 0 once they are, negative otherwise
+static int silly_player_fetch_wait(VideoState *is, size_t bytes, bool blocking)
+{
+	if (bytes > is->audio_fetch_ring.capacity) return -13;
+
+	for (;;) {
+		//seek/close (see audio_fetch_flush()): the resampler holds the end of the stale audio too
+		if (audio_ring_skip_stale(&is->audio_fetch_ring) && is->resampler_fetch) {
+			resampler_reset(is->resampler_fetch);
+			is->fetch_in_frames = 0;
+			is->fetch_out_frames = 0;
+		}
+		if (audio_ring_used(&is->audio_fetch_ring) >= bytes)
+			return 0;
+
+		if (!blocking) return -5;
+		if (is->exit_parse) return -6;
+		if (is->pause_on) return -7;
+		if (!is->active_fetch) return -8;
+
+		os_atomic_set_bool(&is->audio_fetch_waiting, true);
+		if (audio_ring_used(&is->audio_fetch_ring) < bytes)
+			os_event_timedwait(is->audio_fetch_event, 100); //the timeout covers pause/close
+		os_atomic_set_bool(&is->audio_fetch_waiting, false);
+	}
+}
+
+//bytes of input the next 'to_frames' frames fetched stand for, given what resampler_fetch took & handed out since it started
+static size_t silly_player_fetch_in_bytes(VideoState *is, int to_frames, int from_frame_bytes)
+{
+	int64_t from_frames = ((is->fetch_out_frames + to_frames) * is->audiospec.samplerate + is->out_samplerate_fetch - 1)
+		/ is->out_samplerate_fetch - is->fetch_in_frames;
+
+	return (size_t)max(from_frames, 0) * from_frame_bytes;
+}
+
 //fill sample_buffer with audio samples given the samplerate
 //@param[in] sample_buffer: buffer to be filled
 //@param[in] sample_buffer_size: size (# of floats) of buffer to be filled
 //@param[in] blocking
-int silly_audio_fetch(float *sample_buffer, int sample_buffer_size, bool blocking)
+int silly_player_fetch(silly_player_t *is, float *sample_buffer, int sample_buffer_size, bool blocking)
 {
 	memset(sample_buffer, 0, sample_buffer_size * sizeof(float));
-	return silly_audio_fetch_internal(sample_buffer, sample_buffer_size, blocking);
+	if (!is) return -1;
+	return silly_player_fetch_internal(is, sample_buffer, sample_buffer_size, blocking);
 }
-int silly_audio_fetch_internal(float *sample_buffer, int sample_buffer_size, bool blocking)
+static int silly_player_fetch_internal(VideoState *is, float *sample_buffer, int sample_buffer_size, bool blocking)
 {
-	if (!active) return -1;						//in-active
-	if (active && global_exit_parse) return -2;	//active & finished
+	if (!is->active) return -1;				//in-active
+	if (is->active && is->exit_parse) return -2;	//active & finished
 	if (!is->active_fetch) return -3;
-	if (pause_on) return -4;
+	if (is->pause_on) return -4;
 
 	int to_channels = is->out_channels_fetch == SA_CH_LAYOUT_MONO ? 1 : 2;
-	int to_samplerate = is->out_samplerate_fetch;
-	int to_sample_buffer_size = sample_buffer_size;	//# of floats
-
-	int from_channels = is->audiospec.channels == SA_CH_LAYOUT_MONO ? 1 : 2;
-	int from_samplerate = is->audiospec.samplerate;
-	float from_sample_buffer_size_f = //# of floats
-			(float)to_sample_buffer_size 
-			* ((float)from_samplerate / (float)to_samplerate)
-			* ((float)from_channels / (float)to_channels);
-
-	//ceilf()
-	int from_sample_buffer_size = (int)from_sample_buffer_size_f;
-	if (fabs(from_sample_buffer_size_f - from_sample_buffer_size) > 0.000001f)
-		++ from_sample_buffer_size;
-	//fetch left & right channels
-	if (from_sample_buffer_size & 1 != 0)
-		++ from_sample_buffer_size;
-
-	while(true) {
-		pthread_mutex_lock(&is->audio_fetch_buffer_mutex);
-		if (is->audio_fetch_buffer.size >= from_sample_buffer_size * sizeof(float)) {
-			pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
-			break;
-		}
-		pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
+	int to_frames = sample_buffer_size / to_channels;	//# of samples per channel
 
-		if (!blocking) {
-			return -5;
-		}
-
-		if (global_exit_parse) {
-			return -6;
-		}
-
-		if (pause_on) {
-			return -7;
-		}
-
-		if (!is->active_fetch) {
-			return -8;
-		}
-
-		os_sleep_ms(5);
-	}
-
-	if (!is->active_fetch) return -9;
+	int from_channels = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels);
+	int from_frame_bytes = from_channels * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+	size_t from_bytes;
 
-	//pop out to is->audio_fetch
-	da_resize(audio_fetch_array, from_sample_buffer_size * sizeof(float)); //is->audio_fetch.num: in bytes
-
-	pthread_mutex_lock(&is->audio_fetch_buffer_mutex);
-	if (is->audio_fetch_buffer.size < from_sample_buffer_size * sizeof(float)) {
-		pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
-		return -10;
-	}
-	circlebuf_pop_front(&is->audio_fetch_buffer, audio_fetch_array.array, from_sample_buffer_size * sizeof(float));
-	pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
+	const uint8_t *in;
+	uint8_t split[AUDIO_FRAME_BYTES_MAX];
+	uint8_t *out = (uint8_t *)sample_buffer;
+	size_t contiguous;
+	int ret;
 
-	//initialize 'is->swr_ctx_fetch'
-	if (is->swr_ctx_fetch) {
-		if (is->in_channels_fetch != (is->audiospec.channels == SA_CH_LAYOUT_MONO ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO)
+	//initialize 'is->resampler_fetch'
+	if (is->resampler_fetch) {
+		if (is->in_channels_fetch != sa_av_channel_layout(is->audiospec.channels)
 			|| is->in_samplerate_fetch != is->audiospec.samplerate
 			|| is->in_format_fetch != (is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT) ) {
-			swr_free(&is->swr_ctx_fetch);
-			is->swr_ctx_fetch = NULL;
+			resampler_free(&is->resampler_fetch);
 		}
 	}
 
-	if (!is->swr_ctx_fetch) {
-		is->swr_ctx_fetch = swr_alloc();
-		if (!is->swr_ctx_fetch) return -11;
-
-		is->in_channels_fetch = is->audiospec.channels == SA_CH_LAYOUT_MONO ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO;
+	if (!is->resampler_fetch) {
+		is->in_channels_fetch = sa_av_channel_layout(is->audiospec.channels);
 		is->in_samplerate_fetch = is->audiospec.samplerate;
 		is->in_format_fetch = is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
 
-		is->swr_ctx_fetch = swr_alloc_set_opts(is->swr_ctx_fetch,
+		sample_conv_setup(&is->conv_fetch,
+			is->in_format_fetch, is->in_channels_fetch, is->in_samplerate_fetch,
+			AV_SAMPLE_FMT_FLT, av_get_default_channel_layout(to_channels), is->out_samplerate_fetch);
+
+		is->resampler_fetch = resampler_open(is->resample_quality,
 			is->out_channels_fetch == SA_CH_LAYOUT_MONO ? AV_CH_LAYOUT_MONO : AV_CH_LAYOUT_STEREO,	//out_ch_layout
 			AV_SAMPLE_FMT_FLT,																	//out_sample_fmt
 			is->out_samplerate_fetch,																	//out_sample_rate
 			is->in_channels_fetch,		//in_ch_layout
 			is->in_format_fetch,		//in_sample_fmt
-			is->in_samplerate_fetch,	//in_sample_rate
-			0,		//log_offset
-			NULL	//log_ctx
+			is->in_samplerate_fetch		//in_sample_rate
 			);
-		swr_init(is->swr_ctx_fetch);
+		if (!is->resampler_fetch) return -11;
+		is->fetch_in_frames = 0;
+		is->fetch_out_frames = 0;
 	}
 
-	//is->audio_fetch ==> sample_buffer
-	if (swr_convert(is->swr_ctx_fetch,
-		(uint8_t **)&sample_buffer,				//out
-		to_sample_buffer_size / to_channels,		//out_count
-		(const uint8_t **)&audio_fetch_array.array,	//in
-		from_sample_buffer_size / from_channels	//in_count
-		) < 0) {
-		fprintf(stderr, "swr_convert: error while converting.\n");
-		return -12;
+	//exactly the input the output stands for since the resampler started: no rounding piles up inside it.
+	//waiting may start the resampler over (stale data skipped), the input is counted again after it then
+	for (;;) {
+		from_bytes = silly_player_fetch_in_bytes(is, to_frames, from_frame_bytes);
+		if ((ret = silly_player_fetch_wait(is, from_bytes, blocking)) != 0)
+			return ret;
+		if (!is->active_fetch) return -9;
+		if (silly_player_fetch_in_bytes(is, to_frames, from_frame_bytes) == from_bytes)
+			break;
 	}
+	is->fetch_in_frames += from_bytes / from_frame_bytes;
+	is->fetch_out_frames += to_frames;
+
+	//fetch ring ==> sample_buffer, converted straight out of the ring, piece by piece where the data
+	//wraps around (a frame split by the wrap is put together in 'split')
+	for (;;) {
+		contiguous = from_bytes ? min(audio_ring_peek_frames(&is->audio_fetch_ring, &in, from_frame_bytes, split), from_bytes) : 0;
+
+		if (is->conv_fetch.kind != SAMPLE_CONV_NONE) {
+			//nothing to resample (from_frames == to_frames): the kernels take the pieces one after the other
+			sample_conv_run(&is->conv_fetch, &out, &in, (int)(contiguous / from_frame_bytes));
+			out += contiguous / from_frame_bytes * to_channels * sizeof(float);
+		} else if (resampler_convert(is->resampler_fetch,
+			contiguous == from_bytes ? &out : NULL,		//out: the pieces before the last are only buffered inside
+			contiguous == from_bytes ? to_frames : 0,	//out_count
+			&in,										//in
+			(int)(contiguous / from_frame_bytes)		//in_count
+			) < 0) {
+			fprintf(stderr, "resampler_convert: error while converting.\n");
+			return -12;
+		}
+		audio_ring_read(&is->audio_fetch_ring, NULL, contiguous);
 
-	return 0;
+		from_bytes -= contiguous;
+		if (!from_bytes)
+			return 0;
+	}
 }
 
-//stop fetching audio samples
-void silly_audio_fetch_stop()
+//look at fetched audio samples in place: no copy, no conversion.
+//the samples are in the device format (see sa_obtained of silly_player_open()),
+//channels/samplerate given to silly_player_fetch_start() don't apply here
+//@param[out] data: points into the fetch ring, valid until silly_player_fetch_commit()
+//@param[in] blocking: wait for samples
+//return bytes available at *data (whole sample frames), negative on error (see silly_player_fetch())
+int silly_player_fetch_peek(silly_player_t *is, const uint8_t **data, bool blocking)
 {
-	if (!is->active_fetch) return;
+	size_t frame_bytes;
+	int ret;
+
+	if (!data) return -1;
+	*data = NULL;
+	if (!is || !is->active) return -1;
+	if (is->exit_parse) return -2;
+	if (!is->active_fetch) return -3;
+	if (is->pause_on) return -4;
 
-	is->active_fetch = false;
+	frame_bytes = SA_CH_LAYOUT_CHANNELS(is->audiospec.channels) * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+	if ((ret = silly_player_fetch_wait(is, frame_bytes, blocking)) != 0)
+		return ret;
 
-	pthread_mutex_lock(&is->audio_fetch_buffer_mutex);
-	circlebuf_free(&is->audio_fetch_buffer);
-	pthread_mutex_unlock(&is->audio_fetch_buffer_mutex);
+	//a frame split by the end of the ring comes alone, put together
+	return (int)audio_ring_peek_frames(&is->audio_fetch_ring, data, frame_bytes, is->fetch_split);
+}
+
+//hand samples seen through silly_player_fetch_peek() back to the ring
+//@param[in] size: bytes consumed, at most what silly_player_fetch_peek() returned
+void silly_player_fetch_commit(silly_player_t *is, int size)
+{
+	if (!is || !is->active_fetch || size <= 0) return;
+
+	audio_ring_read(&is->audio_fetch_ring, NULL, size);
+}
+
+//stop fetching audio samples
+void silly_player_fetch_stop(silly_player_t *is)
+{
+	struct silly_mixer *mixer;
+
+	if (!is || !is->active_fetch) return;
+
+	//make sure audio_callback() is not writing into the ring we're about to free:
+	//a voice is called back by its mixer's device
+	mixer = is->mixer;
+	if (mixer)
+		mixer_lock(mixer);
+	else if (is->audio_dev)
+		SDL_LockAudioDevice(is->audio_dev);
+	os_atomic_set_bool(&is->active_fetch, false);
+	audio_ring_free(&is->audio_fetch_ring);
+	if (mixer)
+		mixer_unlock(mixer);
+	else if (is->audio_dev)
+		SDL_UnlockAudioDevice(is->audio_dev);
 
 	is->out_channels_fetch = SA_CH_LAYOUT_INVAL;
 	is->out_samplerate_fetch = 0;
 	is->in_channels_fetch = SA_CH_LAYOUT_INVAL;
 	is->in_samplerate_fetch = 0;
 	is->in_format_fetch = SA_SAMPLE_FMT_INVAL;
-	if (is->swr_ctx_fetch) {
-		swr_free(&is->swr_ctx_fetch);
-		is->swr_ctx_fetch = NULL;
-	}
+	resampler_free(&is->resampler_fetch);
+}
+
+//get allocation counters, sample it twice while playing to check the steady state
+//@param[out] stats: counters filled
+void silly_player_allocstats(silly_player_t *is, silly_allocstats *stats)
+{
+	if (!stats) return;
 
-	da_free(audio_fetch_array);
+	stats->allocs = bnum_allocs();
+	stats->total_allocs = bnum_total_allocs();
+	stats->packets = is ? is->audioq.nb_put : 0;
+	stats->packets_copied = is ? is->audioq.nb_copied : 0;
+}
+
+//get the bytes held by the buffers of the player (codec, demuxer & resampler internals aside, also those
+//of the queued files opened ahead), any thread
+//@param[out] stats: bytes filled, all 0 without a player
+void silly_player_memstats(silly_player_t *is, silly_memstats *stats)
+{
+	if (!stats) return;
+
+	if (is)
+		audio_memstats(is, stats);
+	else
+		memset(stats, 0, sizeof(silly_memstats));
+}
+
+/** ************** single-instance API (kept for existing callers) ************** */
+
+//the 'silly_audio_*' functions below drive one default player instance
+
+//initialize silly audio
+int silly_audio_initialize()
+{
+	if (default_player) return 0;
+
+	default_player = silly_player_create();
+	if (!default_player)
+		return -1;
+
+	return 0;
+}
+
+//un-initialize silly audio
+void silly_audio_destroy()
+{
+	silly_player_destroy(default_player);
+	default_player = NULL;
+}
+
+int silly_audio_open(const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained, bool loop)
+{
+	return silly_player_open(default_player, filename, sa_desired, sa_obtained, loop);
+}
+
+void silly_audio_close()
+{
+	silly_player_close(default_player);
+}
+
+void silly_audio_pause()
+{
+	silly_player_pause(default_player);
+}
+
+void silly_audio_resume()
+{
+	silly_player_resume(default_player);
+}
+
+int silly_audio_seek(int sec)
+{
+	return silly_player_seek(default_player, sec);
+}
+
+double silly_audio_seek_latency()
+{
+	return silly_player_seek_latency(default_player);
+}
+
+double silly_audio_time()
+{
+	return silly_player_time(default_player);
+}
+
+void silly_audio_loop(bool enable)
+{
+	silly_player_loop(default_player, enable);
+}
+
+double silly_audio_duration()
+{
+	return silly_player_duration(default_player);
+}
+
+int silly_audio_fetch_start(int channels, int samplerate)
+{
+	return silly_player_fetch_start(default_player, channels, samplerate);
+}
+
+int silly_audio_fetch(float *sample_buffer, int sample_buffer_size, bool blocking)
+{
+	return silly_player_fetch(default_player, sample_buffer, sample_buffer_size, blocking);
+}
+
+int silly_audio_fetch_peek(const uint8_t **data, bool blocking)
+{
+	return silly_player_fetch_peek(default_player, data, blocking);
+}
+
+void silly_audio_fetch_commit(int size)
+{
+	silly_player_fetch_commit(default_player, size);
+}
+
+void silly_audio_fetch_stop()
+{
+	silly_player_fetch_stop(default_player);
+}
+
+silly_tap_t *silly_audio_tap_open(int channels, int samplerate, int buffer_ms)
+{
+	return silly_player_tap_open(default_player, channels, samplerate, buffer_ms);
+}
+
+void silly_audio_allocstats(silly_allocstats *stats)
+{
+	silly_player_allocstats(default_player, stats);
+}
+
+void silly_audio_memstats(silly_memstats *stats)
+{
+	silly_player_memstats(default_player, stats);
+}
+
+void silly_audio_set_latency(int ms)
+{
+	silly_player_set_latency(default_player, ms);
+}
+
+void silly_audio_set_resampler(int quality)
+{
+	silly_player_set_resampler(default_player, quality);
+}
+
+void silly_audio_set_mem_budget(int64_t bytes)
+{
+	silly_player_set_mem_budget(default_player, bytes);
+}
+
+long silly_audio_underruns()
+{
+	return silly_player_underruns(default_player);
+}
+
+int silly_audio_queue(const char *filename)
+{
+	return silly_player_queue(default_player, filename);
+}
+
+void silly_audio_queue_clear()
+{
+	silly_player_queue_clear(default_player);
+}
+
+int silly_audio_queued()
+{
+	return silly_player_queued(default_player);
+}
+
+long silly_audio_track()
+{
+	return silly_player_track(default_player);
+}
+
+void silly_audio_set_crossfade(int ms)
+{
+	silly_player_set_crossfade(default_player, ms);
+}
+
+void silly_audio_set_volume(float volume)
+{
+	silly_player_set_volume(default_player, volume);
+}
+
+void silly_audio_set_gain_db(float db)
+{
+	silly_player_set_gain_db(default_player, db);
+}
+
+float silly_audio_volume()
+{
+	return silly_player_volume(default_player);
+}
+
+int silly_audio_get_levels(silly_levels *levels)
+{
+	return silly_player_get_levels(default_player, levels);
+}
+
+int silly_audio_set_spectrum(int fft_size, int bands, int rate)
+{
+	return silly_player_set_spectrum(default_player, fft_size, bands, rate);
+}
+
+int silly_audio_get_spectrum(silly_spectrum *spectrum)
+{
+	return silly_player_get_spectrum(default_player, spectrum);
+}
+
+int silly_audio_set_tempo(float tempo)
+{
+	return silly_player_set_tempo(default_player, tempo);
+}
+
+float silly_audio_tempo()
+{
+	return silly_player_tempo(default_player);
 }
 
 //show silly_audiospec
@@ -685,6 +1349,15 @@ void silly_audio_printspec(const silly_audiospec *spec)
 	case SA_CH_LAYOUT_STEREO:
 		fprintf(stderr, "spec->channels=SA_CH_LAYOUT_STEREO\n");
 		break;
+	case SA_CH_LAYOUT_QUAD:
+		fprintf(stderr, "spec->channels=SA_CH_LAYOUT_QUAD\n");
+		break;
+	case SA_CH_LAYOUT_5POINT1:
+		fprintf(stderr, "spec->channels=SA_CH_LAYOUT_5POINT1\n");
+		break;
+	case SA_CH_LAYOUT_7POINT1:
+		fprintf(stderr, "spec->channels=SA_CH_LAYOUT_7POINT1\n");
+		break;
 	default:
 		fprintf(stderr, "spec->channels=SA_CH_LAYOUT_INVAL\n");
 		break;
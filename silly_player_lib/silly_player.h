@@ -71,6 +71,116 @@ typedef int64_t off64_t;
 extern "C" {
 #endif
 
+/* a player instance: one stream on its own audio device, instances are independent */
+typedef struct silly_player silly_player_t;
+
+/* a tap: reads the audio played by one player, see silly_player_tap_open() */
+typedef struct silly_tap silly_tap_t;
+
+/* a mixer: one audio device playing several players (voices) at once */
+typedef struct silly_mixer silly_mixer_t;
+
+/* a clip: a short file decoded once to PCM, see silly_clip_cache_get() */
+typedef struct silly_clip silly_clip_t;
+typedef struct silly_clip_cache silly_clip_cache_t;
+
+EXPORT silly_player_t *silly_player_create();
+EXPORT void silly_player_destroy(silly_player_t *player);
+
+EXPORT int silly_player_open(silly_player_t *player, const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained, bool loop);
+EXPORT void silly_player_close(silly_player_t *player);
+
+/* headless: no audio device, PCM is decoded as fast as the CPU allows */
+EXPORT int silly_player_open_headless(silly_player_t *player, const char *filename, const silly_audiospec *sa_desired, silly_audiospec *sa_obtained);
+EXPORT int silly_player_read(silly_player_t *player, uint8_t *buffer, int buffer_size);
+EXPORT int silly_player_decode(silly_player_t *player, silly_pcm_callback callback, void *userdata);
+
+EXPORT void silly_player_pause(silly_player_t *player);
+EXPORT void silly_player_resume(silly_player_t *player);
+
+EXPORT int silly_player_seek(silly_player_t *player, int sec);
+EXPORT double silly_player_seek_latency(silly_player_t *player);
+
+EXPORT void silly_player_loop(silly_player_t *player, bool enable);
+
+/* gapless playlist: queued files follow the current one with no gap */
+EXPORT int silly_player_queue(silly_player_t *player, const char *filename);
+EXPORT void silly_player_queue_clear(silly_player_t *player);
+EXPORT int silly_player_queued(silly_player_t *player);
+EXPORT long silly_player_track(silly_player_t *player);
+EXPORT void silly_player_set_crossfade(silly_player_t *player, int ms);
+
+EXPORT double silly_player_time(silly_player_t *player);
+EXPORT double silly_player_duration(silly_player_t *player);
+
+EXPORT int silly_player_fetch_start(silly_player_t *player, int channels, int samplerate);
+EXPORT int silly_player_fetch(silly_player_t *player, float *sample_buffer, int sample_buffer_size, bool blocking);
+EXPORT int silly_player_fetch_peek(silly_player_t *player, const uint8_t **data, bool blocking);
+EXPORT void silly_player_fetch_commit(silly_player_t *player, int size);
+EXPORT void silly_player_fetch_stop(silly_player_t *player);
+
+/* taps: any number of subscribers to the audio being played, each with its own format */
+EXPORT silly_tap_t *silly_player_tap_open(silly_player_t *player, int channels, int samplerate, int buffer_ms);
+EXPORT int silly_tap_read(silly_tap_t *tap, float *sample_buffer, int sample_buffer_size, bool blocking);
+EXPORT long silly_tap_dropped(silly_tap_t *tap);
+EXPORT void silly_tap_close(silly_tap_t *tap);
+
+/* memory: the buffers of the player. demuxers, decoders & resamplers (of the file open and of the
+   queued ones opened ahead or fading in) are libav's, outside the stats & the budget */
+EXPORT void silly_player_allocstats(silly_player_t *player, silly_allocstats *stats);
+EXPORT void silly_player_memstats(silly_player_t *player, silly_memstats *stats);
+
+EXPORT void silly_player_set_latency(silly_player_t *player, int ms);
+EXPORT void silly_player_set_resampler(silly_player_t *player, int quality);
+EXPORT void silly_player_set_mem_budget(silly_player_t *player, int64_t bytes);
+EXPORT long silly_player_underruns(silly_player_t *player);
+
+EXPORT void silly_player_set_volume(silly_player_t *player, float volume);
+EXPORT void silly_player_set_gain_db(silly_player_t *player, float db);
+EXPORT float silly_player_volume(silly_player_t *player);
+
+EXPORT int silly_player_get_levels(silly_player_t *player, silly_levels *levels);
+
+EXPORT int silly_player_set_spectrum(silly_player_t *player, int fft_size, int bands, int rate);
+EXPORT int silly_player_get_spectrum(silly_player_t *player, silly_spectrum *spectrum);
+
+EXPORT int silly_player_set_tempo(silly_player_t *player, float tempo);
+EXPORT float silly_player_tempo(silly_player_t *player);
+
+/* mixing: voices are players opened on a mixer instead of a device of their own */
+EXPORT silly_mixer_t *silly_mixer_create(const silly_audiospec *sa_desired, silly_audiospec *sa_obtained);
+EXPORT void silly_mixer_destroy(silly_mixer_t *mixer);
+EXPORT void silly_mixer_stats(silly_mixer_t *mixer, silly_mixerstats *stats);
+EXPORT int silly_player_open_voice(silly_player_t *player, silly_mixer_t *mixer, const char *filename, bool loop);
+EXPORT void silly_player_set_pan(silly_player_t *player, float pan);
+
+/* clips: short files decoded once and kept in memory, played by a mixer without decoding */
+EXPORT silly_clip_cache_t *silly_clip_cache_create(const silly_audiospec *spec, int64_t budget);
+EXPORT void silly_clip_cache_destroy(silly_clip_cache_t *cache);
+EXPORT silly_clip_t *silly_clip_cache_get(silly_clip_cache_t *cache, const char *filename);
+EXPORT void silly_clip_cache_stats(silly_clip_cache_t *cache, silly_clipcachestats *stats);
+EXPORT void silly_clip_release(silly_clip_t *clip);
+EXPORT double silly_clip_duration(silly_clip_t *clip);
+EXPORT int silly_mixer_play_clip(silly_mixer_t *mixer, silly_clip_t *clip, float volume, float pan);
+
+/* batch decoding: files are decoded concurrently by a pool of headless players */
+typedef struct silly_batch silly_batch_t;
+
+EXPORT silly_batch_t *silly_batch_create(const silly_batch_params *params);
+EXPORT long silly_batch_submit(silly_batch_t *batch, const char *filename, void *file_userdata);
+EXPORT void silly_batch_wait(silly_batch_t *batch);
+EXPORT void silly_batch_destroy(silly_batch_t *batch);
+EXPORT int silly_batch_decode(const char **filenames, int count, const silly_batch_params *params);
+
+/* waveform overview: min/max/RMS pyramid of a file, built once then memory-mapped from its cache file */
+typedef struct silly_waveform silly_waveform_t;
+
+EXPORT silly_waveform_t *silly_waveform_open(const char *filename, const char *cache_path, int threads);
+EXPORT void silly_waveform_close(silly_waveform_t *waveform);
+EXPORT void silly_waveform_get_info(silly_waveform_t *waveform, silly_waveform_info *info);
+EXPORT const silly_waveform_bucket *silly_waveform_level(silly_waveform_t *waveform, int level, int *buckets);
+
+/* single-instance API, drives one default player */
 EXPORT int silly_audio_initialize();
 
 EXPORT void silly_audio_destroy();
@@ -84,16 +194,44 @@ EXPORT void silly_audio_pause();
 EXPORT void silly_audio_resume();
 
 EXPORT int silly_audio_seek(int sec);
+EXPORT double silly_audio_seek_latency();
 
 EXPORT void silly_audio_loop(bool enable);
 
+EXPORT int silly_audio_queue(const char *filename);
+EXPORT void silly_audio_queue_clear();
+EXPORT int silly_audio_queued();
+EXPORT long silly_audio_track();
+EXPORT void silly_audio_set_crossfade(int ms);
+
 EXPORT double silly_audio_time();
 EXPORT double silly_audio_duration();
 
 EXPORT int silly_audio_fetch_start(int channels, int samplerate);
 EXPORT int silly_audio_fetch(float *sample_buffer, int sample_buffer_size, bool blocking);
+EXPORT int silly_audio_fetch_peek(const uint8_t **data, bool blocking);
+EXPORT void silly_audio_fetch_commit(int size);
 EXPORT void silly_audio_fetch_stop();
 
+EXPORT silly_tap_t *silly_audio_tap_open(int channels, int samplerate, int buffer_ms);
+
+EXPORT void silly_audio_allocstats(silly_allocstats *stats);
+EXPORT void silly_audio_memstats(silly_memstats *stats);
+
+EXPORT void silly_audio_set_latency(int ms);
+EXPORT void silly_audio_set_resampler(int quality);
+EXPORT void silly_audio_set_mem_budget(int64_t bytes);
+EXPORT long silly_audio_underruns();
+
+EXPORT void silly_audio_set_volume(float volume);
+EXPORT void silly_audio_set_gain_db(float db);
+EXPORT float silly_audio_volume();
+EXPORT int silly_audio_get_levels(silly_levels *levels);
+EXPORT int silly_audio_set_spectrum(int fft_size, int bands, int rate);
+EXPORT int silly_audio_get_spectrum(silly_spectrum *spectrum);
+EXPORT int silly_audio_set_tempo(float tempo);
+EXPORT float silly_audio_tempo();
+
 EXPORT void silly_audio_printspec(const silly_audiospec *spec);
 EXPORT void silly_audio_fix();
 
@@ -8,12 +8,25 @@
 #include <libswresample/swresample.h>
 
 #include "packet_queue.h"
+#include "audio_ring.h"
+#include "sample_conv.h"
+#include "resample.h"
+#include "meter.h"
+#include "spectrum.h"
+#include "stretch.h"
 #include "silly_player_params.h"
 #include "util/circlebuf.h"
+#include "util/darray.h"
 #include "util/threading.h"
 
-#define MAX_AUDIO_FRAME_SIZE 192000
+#define AUDIO_FRAME_FRAMES 4096 //frames of a decoded frame for codecs that don't tell (frame_size 0), it grows if needed
+#define AUDIO_FRAME_SLACK 256 //frames the resampler may hand out on top of a frame (what it held)
 #define SDL_AUDIO_BUFFER_SIZE 1024
+#define PCM_LATENCY_MS 100 //default: decoded PCM kept ahead of the device
+#define VOLUME_MAX 4.0f //+12 dB
+#define AUDIO_FETCH_RING_SIZE (512*1024) //bytes of played PCM kept for fetching (~1s of 48kHz stereo float)
+#define AUDIO_RING_MIN (16*1024) //smallest fetch / tap ring a memory budget may leave
+#define AUDIO_FRAME_BYTES_MAX (8*4) //largest device frame: 7.1 float
 
 //note: allocated once
 typedef struct VideoPicture{
@@ -25,20 +38,35 @@ typedef struct VideoPicture{
 	double pts;
 }VideoPicture;
 
-typedef struct VideoState{
-	AVFormatContext *pFormatCtx;
+//one player instance (silly_player_t in the public API), everything it touches lives here
+typedef struct silly_player{
+	AVFormatContext *pFormatCtx;	//parse thread (swapped at a playlist switch)
+	volatile long duration;			//of the track being decoded (in sec), see sa_publish_duration()
 	struct SwsContext *sws_ctx;
 	volatile bool loop;
 
+	volatile bool exit;			//tear down every thread of this instance
+	volatile bool exit_parse;	//parse thread has finished the stream (EOF without loop)
+	volatile bool active;		//opened
+	volatile bool pause_on;
+	bool headless;				//no audio device, PCM is pulled by silly_player_read()/silly_player_decode()
+	SDL_Thread *parse_tid;
+	SDL_AudioDeviceID audio_dev;	//this instance's own audio device
+	struct silly_mixer *mixer;		//voice of a mixer instead (no device, played by the mixer's callback)
+
 	/** ************** audio related ************** */
 	int audio_stream_index;
 	AVStream *audio_st;
 	AVCodecContext *audio_ctx;
 	uint32_t seek_pos_sec; //seek position in seconds
+	volatile bool seek_req;		//seek request, served in-band by parse thread
+	uint64_t seek_req_time;		//os_gettime_ns() of the last request
+	volatile long seek_serial;	//audioq serial of a seek whose first sample is not played yet (0: none)
+	double seek_latency;		//last seek: request -> first sample handed to the device (in ms)
 
 	struct silly_audiospec audiospec;	//תƵʽ
 
-	double current_clock;	//first pos decoded (in sec)	ǰѲʱ
+	double current_clock;	//pos being played (headless: decoded) (in sec)	ǰѲʱ
 	double audio_clock;		//next first pos to be decoded (in sec)	ǰѽʱ
 
 	//ע: Ƶжaudio packetaudioqһaudio packetܱΪaudio frameaudio buffer
@@ -50,33 +78,134 @@ typedef struct VideoState{
 	//(2) a single packet is picked out, waiting for decoding into one or more frames.
 	//one "audio packet" may be decoded into multiple "audio frames", that is,
 	//audio_pkt_data[0, ... , audio_pkt_size-1] is the remaining part waiting for decoding
+	AVPacket audio_pkt; //packet shell, reused for every packet taken from audioq
 	AVPacket *audio_pkt_ptr;
+	long audio_pkt_serial; //audioq serial the decoder is working on
+	bool audio_pkt_eof; //end of stream packet met: drain the codec (& the stretcher), then report the end
 	uint8_t *audio_pkt_data;
 	int audio_pkt_size;
 
 	//(3) copy frames into audio_buf[], which would be consumed by the audio device later.
 	//audio_buf[audio_index, ... , audio_buf_size-1] is a bunch of audio frame
 	AVFrame audio_frame;
-	uint8_t audio_buf[(MAX_AUDIO_FRAME_SIZE * 3) >> 1]; //why???
+	uint8_t *audio_buf; //one frame of the codec in the device format, allocated at open (see audio_buf_open())
+	size_t audio_buf_capacity; //bytes of audio_buf (and of out_buffer)
+	size_t audio_buf_want; //decoder: a frame did not fit, grow both to this before the next one
 	size_t audio_buf_index;
 	size_t audio_buf_size;
+	long audio_buf_serial; //audioq serial of the data in audio_buf
+	double audio_buf_clock; //pts of the data in audio_buf (in sec)
+	float audio_buf_tempo; //media seconds per second of the data in audio_buf (1: not stretched)
+
+	//(4) the decode thread cuts audio_buf into chunks of PCM in pcm_ring, running ahead
+	//of the device by pcm_target bytes. audio_callback() only copies out of the ring.
+	AudioRing pcm_ring;
+	size_t pcm_target;			//bytes the decode thread keeps queued (latency target)
+	size_t pcm_chunk_max;		//largest chunk payload in bytes
+	int pcm_latency_ms;			//latency target, applied at open
+	SDL_Thread *decode_tid;
+	os_event_t *pcm_room_event;	//decode thread sleeps on it while the ring is full
+	volatile bool pcm_decoder_waiting;
+	volatile bool pcm_drain_waiting;	//parse thread sleeps until pcm_ring is played out (end of stream)
+	volatile long pcm_eos_serial;	//decode thread: audioq serial of the end of stream whose last chunk is in pcm_ring
+	size_t pcm_chunk_left;		//callback: bytes left in the chunk being played
+	size_t pcm_stale_left;		//callback: bytes left of a stale chunk (seek), skipped as they are published
+	double pcm_chunk_clock;		//callback: pts of the next byte of that chunk (in sec)
+	float pcm_chunk_tempo;		//callback: media seconds per second of that chunk
+	long pcm_chunk_serial;		//callback: audioq serial of that chunk
+	volatile long underruns;	//callbacks that found the ring dry while the stream was running
+
+	//(5) software volume, applied by audio_callback() on the way out of pcm_ring
+	volatile float volume;		//gain asked for (a float store is atomic on every target we build for)
+	float volume_applied;		//callback: gain reached at the end of the last callback, ramps toward 'volume'
+	volatile float pan;			//voice of a mixer: -1.0 (left) .. 0.0 (center) .. 1.0 (right)
+	float pan_applied;			//mixer callback: pan reached at the end of the last callback
+
+	//(6) tempo change without pitch change (see stretch.c), by the decode thread after the conversion
+	volatile float tempo;		//asked for, STRETCH_TEMPO_MIN .. STRETCH_TEMPO_MAX
+	TimeStretch stretch;		//decoder, allocated on the first tempo != 1
+	bool stretch_active;		//decoder: the output goes through 'stretch' (until it's drained at tempo 1)
+	long stretch_serial;		//decoder: audioq serial of what 'stretch' holds
 
-	SwrContext *swr_ctx; //to convert audio frame
-	uint8_t *out_buffer; //to contain the conversion result
+	//(7) level meters & spectrum, measured by the decoder on audio_buf (see meter.c, spectrum.c)
+	LevelMeter meter;
+	SpectrumAnalyzer spectrum;
+	volatile long spectrum_request;	//SPECTRUM_REQUEST() asked for, kept across open/close
+
+	//(8) playback clock: what the device is playing, published by audio_callback() (see audio_clock_publish())
+	volatile long clock_seq;		//odd while being published, readers copy until it's even & unchanged
+	double clock_base;				//media time heard at 'clock_time' (in sec)
+	uint64_t clock_time;			//os_gettime_ns() it was published at, 0: nothing yet
+	double clock_span;				//media time the device plays from there (then it holds: underrun, end)
+	float clock_speed;				//media seconds per second (tempo), 0 while paused
+	bool clock_pending;				//callback: the block written last, heard from the next callback on
+	double clock_pending_base;
+	double clock_pending_span;
+	float clock_pending_speed;
+
+	int resample_quality; //SA_RESAMPLE_*, applied at open (the fetcher: at its next start)
+	int64_t mem_budget; //bytes the buffers below may hold, 0: no cap; applied at open (fetcher & taps: as they start)
+	Resampler *resampler; //to convert audio frame
+	uint8_t *out_buffer; //to contain the conversion result, audio_buf_capacity bytes
+	SampleConv audio_conv; //used instead of resampler when there is nothing to resample
+	bool audio_conv_held; //decoder: the resampler holds the rest of a frame bigger than audio_buf, it goes first
 
 	/** ************** audio fetching related ************** */
-	struct circlebuf audio_fetch_buffer;		//ring buffer to hold audio frames decoded, providing for callback
-	pthread_mutex_t audio_fetch_buffer_mutex;
+	AudioRing audio_fetch_ring;			//PCM handed to the device (device format), audio_callback() -> fetcher
+	os_event_t *audio_fetch_event;		//signaled by audio_callback() while the fetcher waits for data
+	volatile bool audio_fetch_waiting;
 
 	int out_channels_fetch;
 	int out_samplerate_fetch;
 	int in_channels_fetch;
 	int in_samplerate_fetch;
 	int in_format_fetch;
-	SwrContext *swr_ctx_fetch;
+	Resampler *resampler_fetch;
+	SampleConv conv_fetch; //used instead of resampler_fetch when there is nothing to resample
+	int64_t fetch_in_frames;			//taken from the ring since resampler_fetch started
+	int64_t fetch_out_frames;			//handed out since then
+	uint8_t fetch_split[AUDIO_FRAME_BYTES_MAX];	//a frame split by the end of the fetch ring, put together (see silly_player_fetch_peek())
 
 	volatile bool active_fetch;
 
+	/** ************** taps (fan-out fetching, see tap.c) ************** */
+	AudioRing tap_source;			//PCM handed to the device (device format), audio_callback() -> tap thread
+	os_event_t *tap_event;			//signaled by audio_callback() while the tap thread waits for data
+	volatile bool tap_waiting;
+	volatile long tap_count;		//open taps, audio_callback() only feeds tap_source while there are some
+	volatile long tap_bytes;		//bytes of tap_source & the rings of the taps (see silly_player_memstats())
+	bool tap_active;				//tap thread running, tap_source allocated
+	volatile bool tap_exit;
+	pthread_t tap_thread;
+	pthread_mutex_t tap_mutex;		//guards tap_groups (never taken by audio_callback())
+	struct tap_group *tap_groups;	//one per distinct output format
+
+	/** ************** playlist (gapless, see playlist.c) ************** */
+	pthread_mutex_t playlist_mutex;		//guards playlist & track_switch
+	DARRAY(char *) playlist;			//queued files, not opened yet
+	struct PlaylistTrack *track_next;	//parse thread: the next queued file, opened ahead of time
+	volatile bool track_next_drop;		//the queue was cleared, track_next goes too
+	struct PlaylistTrack *track_switch;	//parse thread -> decoder: being read, decoded from its end marker on
+	volatile bool track_switch_pending;
+	long track_decoded;					//decoder: tracks switched to since open
+	volatile long track_played;			//track being played (0: the file opened)
+
+	//crossfade: the next track decoded & mixed in by the decoder before the end of the current one
+	volatile int crossfade_ms;			//0: gapless
+	struct PlaylistTrack *fade_track;	//parse thread -> decoder: offered to fade in (owned by the parse thread)
+	volatile bool fade_offered;			//fade_track may be mixed in, until the decoder switches to it
+	volatile bool fade_switched;		//decoder -> parse thread: switched, read on from fade_track's demuxer
+	int fade_state;						//decoder: FADE_*
+	int fade_pos;						//frames of the curve done
+	int fade_frames;					//length of the curve
+	bool fade_eof;						//fade_track read up to its end
+	long fade_serial;					//audioq serial of the switch
+	double fade_clock;					//pts of the front of fade_pcm
+	struct circlebuf fade_pcm;			//fade_track decoded ahead of the mix, in the output format
+	AVFrame *fade_frame;
+	uint8_t *fade_buf;					//scratch, grows with the blocks mixed
+	size_t fade_buf_capacity;
+
 	/** ************** video related ************** */
 	int video_stream_index;
 	AVStream *video_st;
@@ -102,4 +231,40 @@ typedef struct VideoState{
 	SDL_cond *pictq_cond;
 
 	char filename[1024];
-}VideoState;
\ No newline at end of file
+}VideoState;
+
+/** SA_CH_LAYOUT_* -> AV_CH_LAYOUT_* (0 if invalid) */
+static inline int64_t sa_av_channel_layout(int layout)
+{
+	switch (layout) {
+	case SA_CH_LAYOUT_MONO: return AV_CH_LAYOUT_MONO;
+	case SA_CH_LAYOUT_STEREO: return AV_CH_LAYOUT_STEREO;
+	case SA_CH_LAYOUT_QUAD: return AV_CH_LAYOUT_QUAD;
+	case SA_CH_LAYOUT_5POINT1: return AV_CH_LAYOUT_5POINT1;
+	case SA_CH_LAYOUT_7POINT1: return AV_CH_LAYOUT_7POINT1;
+	default: return 0;
+	}
+}
+
+/** the supported layout nearest to 'channels' channels (SA_CH_LAYOUT_SOURCE) */
+static inline int sa_layout_for_channels(int channels)
+{
+	if (channels <= 1) return SA_CH_LAYOUT_MONO;
+	if (channels == 2 || channels == 3) return SA_CH_LAYOUT_STEREO; //2.1 / 3.0: no device has them, fold into stereo
+	if (channels == 4 || channels == 5) return SA_CH_LAYOUT_QUAD;
+	if (channels <= 7) return SA_CH_LAYOUT_5POINT1;
+	return SA_CH_LAYOUT_7POINT1;
+}
+
+//pFormatCtx was opened: publish its duration for silly_player_duration(), which never touches the demuxer.
+//a queued track publishes its own once the decoder takes it over (see playlist_take_decoder())
+static inline void sa_publish_duration(struct silly_player *is)
+{
+	os_atomic_set_long(&is->duration, (long)(is->pFormatCtx->duration / AV_TIME_BASE));
+}
+
+/** process-wide setup shared by all instances (refcounted, thread-safe) */
+int silly_global_init();
+void silly_global_uninit();
+int silly_global_audio_init();		//before opening an audio device
+void silly_global_audio_uninit();	//after closing it
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -7,19 +9,158 @@ extern "C" {
 #define SA_CH_LAYOUT_INVAL	0x00000000	//invalid channel layout
 #define SA_CH_LAYOUT_MONO	0x00000001	//1 channel
 #define SA_CH_LAYOUT_STEREO	0x00000002	//2 channels
+#define SA_CH_LAYOUT_QUAD	0x00000004	//4 channels: FL FR BL BR
+#define SA_CH_LAYOUT_5POINT1	0x00000006	//6 channels: FL FR FC LFE SL SR
+#define SA_CH_LAYOUT_7POINT1	0x00000008	//8 channels: FL FR FC LFE BL BR SL SR
+#define SA_CH_LAYOUT_SOURCE	0x000000ff	//desired only: the layout above nearest to the file's (5.1 file -> 5.1 device)
+
+//number of channels of a layout (the layouts are their channel counts), 0 if invalid
+#define SA_CH_LAYOUT_CHANNELS(layout)	((layout) > SA_CH_LAYOUT_INVAL && (layout) <= SA_CH_LAYOUT_7POINT1 ? (layout) : 0)
 
 #define SA_SAMPLE_FMT_INVAL	0x00000000	//invalid audio format
 #define SA_SAMPLE_FMT_S16	0x00000001	//signed 16 bits
 #define SA_SAMPLE_FMT_FLT	0x00000002	//float
 
+//resampler of a player, see silly_player_set_resampler()
+#define SA_RESAMPLE_DEFAULT	0	//swresample's defaults
+#define SA_RESAMPLE_FAST	1	//swresample, short cubic filter: previews
+#define SA_RESAMPLE_HIGH	2	//swresample, long kaiser filter
+#define SA_RESAMPLE_SPEEX	3	//the speex resampler
+
 typedef struct silly_audiospec
 {
-	int channels;	//number of channels: SA_CH_LAYOUT_MONO, SA_CH_LAYOUT_STEREO
+	int channels;	//channel layout: SA_CH_LAYOUT_MONO, SA_CH_LAYOUT_STEREO ... SA_CH_LAYOUT_7POINT1 (SA_CH_LAYOUT_SOURCE)
 	int format;		//audio data format: SA_SAMPLE_FMT_S16, SA_SAMPLE_FMT_FLT
 	int samplerate;	//samples per second
 	int samples;	//audio buffer size in samples (power of 2)
 }silly_audiospec;
 
+typedef struct silly_allocstats
+{
+	long allocs;			//live allocations made through bmalloc (bnum_allocs)
+	long total_allocs;		//bmalloc/brealloc calls since the process started
+	long packets;			//packets moved from the demuxer to the decoder
+	long packets_copied;	//packets whose payload had to be copied (not refcounted)
+}silly_allocstats;
+
+//bytes held by the buffers of one player, see silly_player_memstats()
+typedef struct silly_memstats
+{
+	int64_t budget;			//cap set by silly_player_set_mem_budget(), 0: none
+	int64_t total;			//all of the below
+	int64_t decode;			//decoded frame, conversion output & crossfade buffers
+	int64_t stretch;		//time-stretch windows & input
+	int64_t analysis;		//level meter scratch & spectrum analyzer (FFT tables & buffers)
+	int64_t pcm_ring;		//decoded PCM queued ahead of the device
+	int64_t fetch;			//fetch ring
+	int64_t taps;			//tap thread ring & the rings of the open taps
+	int64_t packets;		//compressed packets queued for the decoder & the slots of the queue
+}silly_memstats;
+
+//mixer: cost of the device callbacks, see silly_mixer_stats()
+typedef struct silly_mixerstats
+{
+	int voices;				//voices playing on the mixer
+	long callbacks;			//device callbacks since the last silly_mixer_stats()
+	double callback_avg_ms;	//time spent in one (mixing only, the voices decode on their own threads)
+	double callback_max_ms;
+	double buffer_ms;		//duration of one device buffer: the time a callback may take at most
+}silly_mixerstats;
+
+//clip cache: see silly_clip_cache_stats()
+typedef struct silly_clipcachestats
+{
+	int clips;				//clips cached
+	int64_t bytes;			//PCM they take
+	int64_t budget;			//bytes kept at most
+	long hits;				//silly_clip_cache_get() served from memory
+	long misses;			//... that decoded the file (first use, evicted or changed on disk)
+	long evictions;			//clips dropped for room or for a newer file
+}silly_clipcachestats;
+
+//level meters: see silly_player_get_levels(). measured by the decoder before the volume,
+//one block of 100 ms at a time (the device plays it up to the latency target later)
+#define SILLY_LEVELS_FLOOR -120.0f	//dB / LUFS reported for silence
+
+typedef struct silly_levels
+{
+	int channels;			//1 or 2, the rest of peak[] & rms[] is 0
+	float peak[2];			//sample peak of the last block, dBFS
+	float rms[2];			//RMS of the last block, dBFS
+	float momentary;		//EBU R128 momentary loudness (last 400 ms), LUFS
+	float short_term;		//EBU R128 short-term loudness (last 3 s), LUFS
+	double clock;			//media time at the end of the last block (in sec)
+	long blocks;			//blocks measured since open, 0: nothing yet
+}silly_levels;
+
+//spectrum analyzer: see silly_player_set_spectrum(). computed by the decoder before the volume,
+//like the level meters
+#define SILLY_SPECTRUM_MAX_BANDS 128
+
+typedef struct silly_spectrum
+{
+	int bands;				//as asked for, the rest of the arrays is 0
+	int fft_size;
+	float frequency[SILLY_SPECTRUM_MAX_BANDS];	//center of each band (Hz), log spaced 20 Hz .. 20 kHz
+	float magnitude[SILLY_SPECTRUM_MAX_BANDS];	//power of each band, dBFS (a full-scale sine reads 0)
+	double clock;			//media time at the end of the frames analyzed (in sec)
+	long frames;			//spectra computed since it was set up, 0: nothing yet
+}silly_spectrum;
+
+//waveform overview: see silly_waveform_open()
+#define SILLY_WAVEFORM_LEVELS 3			//256, 1024 & 4096 frames a bucket
+
+//one bucket of the mono downmix, full scale is 32767
+typedef struct silly_waveform_bucket
+{
+	int16_t min;
+	int16_t max;
+	int16_t rms;
+}silly_waveform_bucket;
+
+typedef struct silly_waveform_info
+{
+	int samplerate;
+	int64_t frames;			//length of the file
+	int levels;				//SILLY_WAVEFORM_LEVELS
+	int frames_per_bucket[SILLY_WAVEFORM_LEVELS];
+	int buckets[SILLY_WAVEFORM_LEVELS];
+	int cached;				//1: served from a cache file made before
+	int segments;			//built: parts of the file decoded in parallel (0 if cached)
+	double build_time;		//built: seconds it took (0 if cached)
+}silly_waveform_info;
+
+//headless decoding: receives 'size' bytes of interleaved PCM, return non-zero to stop
+typedef int (*silly_pcm_callback)(void *userdata, const uint8_t *pcm, int size);
+
+//batch decoding: one file, filled in while it is decoded
+typedef struct silly_batch_result
+{
+	const char *filename;
+	void *file_userdata;	//as passed to silly_batch_submit()
+	long index;				//submission order
+	int status;				//0: decoded to the end, 1: stopped by on_pcm, negative: error
+	silly_audiospec spec;	//format of the PCM handed to on_pcm
+	int64_t bytes;			//PCM bytes decoded so far
+	double duration;		//media seconds decoded (when done)
+	double decode_time;		//wall seconds spent (when done)
+}silly_batch_result;
+
+//called on a worker thread for every decoded frame, return non-zero to stop this file
+typedef int (*silly_batch_pcm_callback)(void *userdata, const silly_batch_result *file, const uint8_t *pcm, int size);
+//called on a worker thread when a file is done, calls are serialized
+typedef void (*silly_batch_result_callback)(void *userdata, const silly_batch_result *result);
+
+typedef struct silly_batch_params
+{
+	int workers;			//worker threads (0: one per CPU)
+	int max_inflight;		//files queued or decoding at once, silly_batch_submit() blocks beyond (0: 2 x workers)
+	silly_audiospec spec;	//output format (samples UNUSED)
+	silly_batch_pcm_callback on_pcm;			//optional
+	silly_batch_result_callback on_result;	//optional
+	void *userdata;			//passed to on_pcm & on_result
+}silly_batch_params;
+
 #ifdef __cplusplus
 };
 #endif
\ No newline at end of file
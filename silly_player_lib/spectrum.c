@@ -0,0 +1,216 @@
+#include <math.h>
+#include <string.h>
+
+#include "c99defs.h"
+#include "spectrum.h"
+
+#include "util/bmem.h"
+#include "util/threading.h"
+
+//spectrum analyzer computed by the decoder on the PCM it hands out anyway, the same way as the level
+//meters (meter.c): visualizers no longer fetch the stream, resample it and run their own FFT.
+//the mono downmix of the last 'fft size' frames is transformed every 1 / rate seconds (fft.c),
+//the bins are summed into bands spaced logarithmically from 20 Hz to 20 kHz (or Nyquist).
+#define SPECTRUM_LOW_HZ 20.0
+#define SPECTRUM_HIGH_HZ 20000.0
+#define SPECTRUM_SCRATCH_FRAMES 1024
+
+void spectrum_init(SpectrumAnalyzer *sa, int samplerate, int channels, bool s16)
+{
+	memset(sa, 0, sizeof(*sa));
+	sa->kernels = sample_kernels();
+	sa->samplerate = samplerate;
+	sa->channels = channels;
+	sa->s16 = s16;
+}
+
+static void spectrum_release(SpectrumAnalyzer *sa)
+{
+	fft_free(&sa->fft);
+	bfree(sa->history);
+	bfree(sa->frame);
+	bfree(sa->power);
+	bfree(sa->scratch);
+	bfree(sa->mono);
+	sa->history = NULL;
+	sa->frame = NULL;
+	sa->power = NULL;
+	sa->scratch = NULL;
+	sa->mono = NULL;
+	sa->config = 0;
+}
+
+void spectrum_free(SpectrumAnalyzer *sa)
+{
+	spectrum_release(sa);
+	memset(sa, 0, sizeof(*sa));
+}
+
+//start over (seek): silence before what comes next
+static void spectrum_reset(SpectrumAnalyzer *sa)
+{
+	memset(sa->history, 0, sizeof(float) * sa->fft.size);
+	sa->history_pos = 0;
+	sa->since = 0;
+}
+
+//bins of every band: log spaced edges, a band narrower than a bin takes the bin nearest its center
+static void spectrum_bands(SpectrumAnalyzer *sa)
+{
+	double nyquist = sa->samplerate / 2.0;
+	double high = min(SPECTRUM_HIGH_HZ, nyquist);
+	double bin_hz = (double)sa->samplerate / sa->fft.size;
+	double lo, hi;
+	int b;
+
+	for (b = 0; b < sa->bands; ++b) {
+		lo = SPECTRUM_LOW_HZ * pow(high / SPECTRUM_LOW_HZ, (double)b / sa->bands);
+		hi = SPECTRUM_LOW_HZ * pow(high / SPECTRUM_LOW_HZ, (double)(b + 1) / sa->bands);
+		sa->band_freq[b] = (float)sqrt(lo * hi);
+		sa->band_lo[b] = (int)ceil(lo / bin_hz);
+		sa->band_hi[b] = (int)ceil(hi / bin_hz) - 1;
+		if (sa->band_hi[b] < sa->band_lo[b])
+			sa->band_lo[b] = sa->band_hi[b] = (int)floor(sa->band_freq[b] / bin_hz + 0.5);
+		sa->band_hi[b] = min(sa->band_hi[b], sa->fft.half);
+		sa->band_lo[b] = min(sa->band_lo[b], sa->band_hi[b]);
+	}
+}
+
+//apply a new request (decoder), everything measured so far is dropped
+static void spectrum_configure(SpectrumAnalyzer *sa, long request)
+{
+	int bits = (int)(request & 0xf);
+	int bands = (int)((request >> 4) & 0xff);
+	int rate = (int)((request >> 12) & 0x7f);
+
+	spectrum_release(sa);
+	sa->config = request; //not asked again if it fails
+
+	os_atomic_inc_long(&sa->seq);
+	memset(&sa->spectrum, 0, sizeof(sa->spectrum));
+	os_atomic_inc_long(&sa->seq);
+
+	//mono & stereo only, a surround device has no spectrum
+	if (!request || sa->samplerate <= 0 || sa->channels < 1 || sa->channels > 2
+		|| rate <= 0 || bands <= 0 || bands > SILLY_SPECTRUM_MAX_BANDS)
+		return;
+	if (fft_init(&sa->fft, 1 << bits) != 0)
+		return;
+
+	sa->bands = bands;
+	sa->hop = max(sa->samplerate / rate, 1);
+	//Hann: a full-scale sine on a bin reads size / 4, its two neighbours half that
+	sa->norm = 1.5f * (sa->fft.size / 4.0f) * (sa->fft.size / 4.0f);
+	spectrum_bands(sa);
+
+	sa->history = bmalloc(sizeof(float) * sa->fft.size);
+	sa->frame = bmalloc(sizeof(float) * sa->fft.size);
+	sa->power = bmalloc(sizeof(float) * (sa->fft.half + 1));
+	sa->scratch = bmalloc(sizeof(float) * SPECTRUM_SCRATCH_FRAMES * sa->channels);
+	sa->mono = bmalloc(sizeof(float) * SPECTRUM_SCRATCH_FRAMES);
+	spectrum_reset(sa);
+}
+
+//transform the history & publish the bands
+static void spectrum_publish(SpectrumAnalyzer *sa, double clock)
+{
+	int size = sa->fft.size, older = size - sa->history_pos;
+	int b, k;
+
+	memcpy(sa->frame, sa->history + sa->history_pos, sizeof(float) * older);
+	memcpy(sa->frame + older, sa->history, sizeof(float) * sa->history_pos);
+	fft_power(&sa->fft, sa->frame, sa->power);
+
+	os_atomic_inc_long(&sa->seq);
+	sa->spectrum.bands = sa->bands;
+	sa->spectrum.fft_size = size;
+	for (b = 0; b < sa->bands; ++b) {
+		double power = 0.0, db;
+		for (k = sa->band_lo[b]; k <= sa->band_hi[b]; ++k)
+			power += sa->power[k];
+		db = power > 0.0 ? 10.0 * log10(power / sa->norm) : SILLY_LEVELS_FLOOR;
+		sa->spectrum.frequency[b] = sa->band_freq[b];
+		sa->spectrum.magnitude[b] = db < SILLY_LEVELS_FLOOR ? SILLY_LEVELS_FLOOR : (float)db;
+	}
+	sa->spectrum.clock = clock;
+	++sa->spectrum.frames;
+	os_atomic_inc_long(&sa->seq);
+}
+
+//'frames' mono frames into the history ring
+static void spectrum_push(SpectrumAnalyzer *sa, const float *mono, int frames)
+{
+	int n;
+
+	while (frames > 0) {
+		n = min(frames, sa->fft.size - sa->history_pos);
+		memcpy(sa->history + sa->history_pos, mono, sizeof(float) * n);
+		sa->history_pos = (sa->history_pos + n) % sa->fft.size;
+		mono += n;
+		frames -= n;
+	}
+}
+
+void spectrum_update(SpectrumAnalyzer *sa, long request, const uint8_t *pcm, int size, long serial, double clock, float tempo)
+{
+	int frame_bytes = sa->channels * (sa->s16 ? 2 : 4);
+	int frames = size / frame_bytes;
+	int done = 0, n;
+	const float *src;
+
+	if (request != sa->config)
+		spectrum_configure(sa, request);
+	if (!sa->history)
+		return;
+	if (serial != sa->serial) {
+		spectrum_reset(sa);
+		sa->serial = serial;
+	}
+
+	while (done < frames) {
+		n = min(min(frames - done, SPECTRUM_SCRATCH_FRAMES), sa->hop - sa->since);
+		src = (const float *)(pcm + (size_t)done * frame_bytes);
+		if (sa->s16) {
+			sa->kernels->s16_to_flt(sa->scratch, (const int16_t *)(pcm + (size_t)done * frame_bytes), n * sa->channels);
+			src = sa->scratch;
+		}
+		if (sa->channels == 2) {
+			sa->kernels->stereo_to_mono_flt(sa->mono, src, n, 0.5f);
+			src = sa->mono;
+		}
+
+		spectrum_push(sa, src, n);
+		done += n;
+		sa->since += n;
+		if (sa->since >= sa->hop) {
+			spectrum_publish(sa, clock + (double)done * tempo / sa->samplerate);
+			sa->since = 0;
+		}
+	}
+}
+
+bool spectrum_read(SpectrumAnalyzer *sa, silly_spectrum *spectrum)
+{
+	long seq;
+
+	do {
+		while ((seq = os_atomic_load_long(&sa->seq)) & 1)
+			; //being written
+		*spectrum = sa->spectrum;
+		os_atomic_thread_fence_acquire();
+	} while (os_atomic_load_long(&sa->seq) != seq);
+
+	return spectrum->frames > 0;
+}
+
+size_t spectrum_bytes_for(int fft_size, int channels)
+{
+	//history & frame: fft size, power: half + 1, scratch & mono: SPECTRUM_SCRATCH_FRAMES
+	return fft_bytes(fft_size) + sizeof(float) * ((size_t)2 * fft_size + fft_size / 2 + 1
+		+ (size_t)SPECTRUM_SCRATCH_FRAMES * (channels + 1));
+}
+
+size_t spectrum_bytes(const SpectrumAnalyzer *sa)
+{
+	return sa->history ? spectrum_bytes_for(sa->fft.size, sa->channels) : 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "c99defs.h"
+#include "fft.h"
+#include "sample_conv.h"
+#include "silly_player_params.h"
+
+#define SPECTRUM_RATE_MAX 100		//spectra per second
+
+//what silly_player_set_spectrum() asked for, in one long so the decoder reads it at once:
+//log2(fft size) | bands << 4 | rate << 12, 0: off
+#define SPECTRUM_REQUEST(bits, bands, rate) ((long)(bits) | ((long)(bands) << 4) | ((long)(rate) << 12))
+#define SPECTRUM_REQUEST_FFT_SIZE(request) (1 << ((request) & 0xf))
+
+//band magnitudes of the decoded PCM, see spectrum.c
+typedef struct SpectrumAnalyzer{
+	const SampleKernels *kernels;
+	int samplerate;
+	int channels;
+	bool s16;
+
+	long config;				//request applied (SPECTRUM_REQUEST), 0: off
+	RealFFT fft;
+	int bands;
+	int band_lo[SILLY_SPECTRUM_MAX_BANDS];	//first & last FFT bin of each band
+	int band_hi[SILLY_SPECTRUM_MAX_BANDS];
+	float band_freq[SILLY_SPECTRUM_MAX_BANDS];
+	float norm;					//bin power of a full-scale sine, spread by the window
+	int hop;					//frames between two spectra
+	int since;					//frames since the last one
+
+	float *history;				//mono downmix of the last 'fft size' frames, a ring
+	int history_pos;			//oldest frame
+	float *frame;				//history in order, what the FFT reads
+	float *power;				//FFT bins
+	float *scratch;				//a piece of the PCM converted (interleaved) ...
+	float *mono;				//... then downmixed
+	long serial;				//audioq serial analyzed: a seek starts over
+
+	//lock-free snapshot, like LevelMeter
+	volatile long seq;
+	silly_spectrum spectrum;
+}SpectrumAnalyzer;
+
+void spectrum_init(SpectrumAnalyzer *sa, int samplerate, int channels, bool s16);
+void spectrum_free(SpectrumAnalyzer *sa);
+
+/** decoder: analyze 'size' bytes of PCM of audioq serial 'serial' starting at media time 'clock' (time-stretched by 'tempo').
+ *  'request': SPECTRUM_REQUEST() wanted, applied here when it changes */
+void spectrum_update(SpectrumAnalyzer *sa, long request, const uint8_t *pcm, int size, long serial, double clock, float tempo);
+
+/** any thread: copy the last spectrum, false if there is none */
+bool spectrum_read(SpectrumAnalyzer *sa, silly_spectrum *spectrum);
+
+/** bytes allocated, 0 while off */
+size_t spectrum_bytes(const SpectrumAnalyzer *sa);
+
+/** bytes an analyzer of 'fft_size' on 'channels' takes (FFT tables & buffers) */
+size_t spectrum_bytes_for(int fft_size, int channels);
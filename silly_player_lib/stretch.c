@@ -0,0 +1,275 @@
+#include <math.h>
+#include <string.h>
+
+#include "c99defs.h"
+#include "stretch.h"
+
+#include "util/bmem.h"
+
+//WSOLA (waveform similarity overlap-add): the output is made of Hann windowed segments of the
+//input, overlapped by half. segment k nominally starts 'hop * tempo * k' frames into the input;
+//the search moves it by up to 'seek' frames to where it best lines up (normalized cross-correlation
+//of the mono downmix) with the natural continuation of segment k - 1, so the periods of the signal
+//join without phase jumps: the tempo changes, the pitch doesn't.
+//the search is the only real cost: a coarse pass every STRETCH_COARSE frames, then a fine one
+//around the best candidate, both on the dot product kernel of sample_conv.c.
+#define STRETCH_WINDOW_MS 30
+#define STRETCH_SEEK_MS 10
+#define STRETCH_COARSE 4
+#define STRETCH_CLOCK_JUMP 0.1 //input pts off by more than this (next track): anchor again
+#define STRETCH_PI 3.14159265358979
+
+int stretch_init(TimeStretch *st, int samplerate, int channels, bool s16)
+{
+	int i, ch;
+
+	memset(st, 0, sizeof(*st));
+	if (samplerate <= 0 || channels < 1 || channels > 2)
+		return -1;
+
+	st->kernels = sample_kernels();
+	st->samplerate = samplerate;
+	st->channels = channels;
+	st->s16 = s16;
+	st->hop = samplerate * STRETCH_WINDOW_MS / 2000;
+	st->window = st->hop * 2;
+	st->seek = samplerate * STRETCH_SEEK_MS / 1000;
+
+	//periodic Hann: two of them overlapped by half sum to 1
+	st->hann = bmalloc(sizeof(float) * st->window * channels);
+	for (i = 0; i < st->window; ++i) {
+		float w = (float)(0.5 - 0.5 * cos(2.0 * STRETCH_PI * i / st->window));
+		for (ch = 0; ch < channels; ++ch)
+			st->hann[i * channels + ch] = w;
+	}
+	st->ola = bmalloc(sizeof(float) * st->window * channels);
+	st->out = bmalloc(sizeof(float) * st->hop * channels);
+	st->energy = bmalloc(sizeof(double) * (2 * st->seek + 1));
+
+	stretch_reset(st);
+	return 0;
+}
+
+void stretch_free(TimeStretch *st)
+{
+	bfree(st->hann);
+	bfree(st->ola);
+	bfree(st->out);
+	bfree(st->energy);
+	bfree(st->in);
+	bfree(st->mono);
+	memset(st, 0, sizeof(*st));
+}
+
+//drop everything buffered (seek)
+void stretch_reset(TimeStretch *st)
+{
+	st->in_frames = 0;
+	st->in_clock = 0.0;
+	st->in_pos = 0.0;
+	st->prev = 0;
+	st->started = false;
+	st->draining = false;
+	st->drain_end = 0;
+	st->out_frames = 0;
+	st->out_read = 0;
+	if (st->ola)
+		memset(st->ola, 0, sizeof(float) * st->window * st->channels);
+}
+
+static void stretch_reserve(TimeStretch *st, int frames)
+{
+	if (frames <= st->in_capacity)
+		return;
+
+	st->in_capacity = max(frames, st->in_capacity * 2);
+	st->in = brealloc(st->in, sizeof(float) * st->in_capacity * st->channels);
+	st->mono = brealloc(st->mono, sizeof(float) * st->in_capacity);
+}
+
+void stretch_write(TimeStretch *st, const uint8_t *pcm, int size, double clock)
+{
+	int frames = size / (st->channels * (st->s16 ? 2 : 4));
+	double expected = st->in_clock + (double)st->in_frames / st->samplerate;
+	float *dst;
+
+	if (frames <= 0)
+		return;
+
+	if (!st->in_frames)
+		st->in_clock = clock;
+	else if (fabs(clock - expected) > STRETCH_CLOCK_JUMP)
+		st->in_clock = clock - (double)st->in_frames / st->samplerate;
+
+	stretch_reserve(st, st->in_frames + frames);
+	dst = st->in + (size_t)st->in_frames * st->channels;
+	if (st->s16)
+		st->kernels->s16_to_flt(dst, (const int16_t *)pcm, frames * st->channels);
+	else
+		memcpy(dst, pcm, sizeof(float) * frames * st->channels);
+
+	if (st->channels == 2)
+		st->kernels->stereo_to_mono_flt(st->mono + st->in_frames, dst, frames, 0.5f);
+	else
+		memcpy(st->mono + st->in_frames, dst, sizeof(float) * frames);
+	st->in_frames += frames;
+}
+
+//how well the candidate at 'k' continues the last segment: correlation, signed, squared & normalized
+static inline double stretch_score(TimeStretch *st, const float *target, int k, int lo)
+{
+	double c = st->kernels->dot_flt(st->mono + k, target, st->hop);
+	return (c > 0.0 ? c * c : -c * c) / (st->energy[k - lo] + 1e-9);
+}
+
+//start of the segment around 'p' that best continues the last one
+static int stretch_search(TimeStretch *st, int p)
+{
+	const float *target = st->mono + st->prev + st->hop;
+	const float *m = st->mono;
+	int lo = max(p - st->seek, 0);
+	int hi = p + st->seek;
+	int best = p, from, to, k;
+	double e = 0.0, score, best_score;
+
+	//energy of every candidate, sliding
+	for (k = 0; k < st->hop; ++k)
+		e += (double)m[lo + k] * m[lo + k];
+	for (k = lo; k <= hi; ++k) {
+		st->energy[k - lo] = e > 0.0 ? e : 0.0;
+		e += (double)m[k + st->hop] * m[k + st->hop] - (double)m[k] * m[k];
+	}
+
+	//the nominal position wins ties (silence)
+	best_score = stretch_score(st, target, p, lo);
+	for (k = lo; k <= hi; k += STRETCH_COARSE) {
+		if ((score = stretch_score(st, target, k, lo)) > best_score) {
+			best_score = score;
+			best = k;
+		}
+	}
+
+	from = max(best - STRETCH_COARSE + 1, lo);
+	to = min(best + STRETCH_COARSE - 1, hi);
+	for (k = from; k <= to; ++k) {
+		if ((score = stretch_score(st, target, k, lo)) > best_score) {
+			best_score = score;
+			best = k;
+		}
+	}
+	return best;
+}
+
+//one output hop: find the next segment & overlap-add it, 'hop' frames are finished.
+//return false if more input is needed
+static bool stretch_hop(TimeStretch *st, float tempo)
+{
+	int ch = st->channels;
+	int p = (int)(st->in_pos + 0.5);
+	int best, drop;
+	const float *seg;
+
+	if (st->draining && p >= st->drain_end)
+		return false;
+	if (max(p + st->seek, st->prev + st->hop) + st->window > st->in_frames)
+		return false;
+
+	tempo = tempo < STRETCH_TEMPO_MIN ? STRETCH_TEMPO_MIN : (tempo > STRETCH_TEMPO_MAX ? STRETCH_TEMPO_MAX : tempo);
+
+	best = st->started ? stretch_search(st, p) : p;
+	seg = st->in + (size_t)best * ch;
+	if (!st->started) {
+		//nothing to overlap with: the first half goes out as it is, no fade in
+		memcpy(st->ola, seg, sizeof(float) * st->hop * ch);
+		st->kernels->window_add_flt(st->ola + st->hop * ch, seg + st->hop * ch, st->hann + st->hop * ch, st->hop * ch);
+	} else {
+		st->kernels->window_add_flt(st->ola, seg, st->hann, st->window * ch);
+	}
+
+	memcpy(st->out, st->ola, sizeof(float) * st->hop * ch);
+	memmove(st->ola, st->ola + st->hop * ch, sizeof(float) * st->hop * ch);
+	memset(st->ola + st->hop * ch, 0, sizeof(float) * st->hop * ch);
+	st->out_frames = st->hop;
+	st->out_read = 0;
+	st->out_clock = st->in_clock + (double)p / st->samplerate;
+	st->out_tempo = tempo;
+
+	st->prev = best;
+	st->started = true;
+	st->in_pos += st->hop * tempo;
+
+	//drop the input neither the next search nor the next target reaches
+	drop = min(st->prev + st->hop, (int)st->in_pos - st->seek);
+	if (drop > 0) {
+		memmove(st->in, st->in + (size_t)drop * ch, sizeof(float) * (st->in_frames - drop) * ch);
+		memmove(st->mono, st->mono + drop, sizeof(float) * (st->in_frames - drop));
+		st->in_frames -= drop;
+		st->in_pos -= drop;
+		st->prev -= drop;
+		st->drain_end -= drop;
+		st->in_clock += (double)drop / st->samplerate;
+	}
+	return true;
+}
+
+int stretch_read(TimeStretch *st, uint8_t *pcm, int size, float tempo, double *clock)
+{
+	int frame_bytes = st->channels * (st->s16 ? 2 : 4);
+	int frames;
+
+	if (st->out_read >= st->out_frames && !stretch_hop(st, tempo))
+		return 0;
+
+	frames = min(st->out_frames - st->out_read, size / frame_bytes);
+	if (st->s16)
+		st->kernels->flt_to_s16((int16_t *)pcm, st->out + (size_t)st->out_read * st->channels, frames * st->channels);
+	else
+		memcpy(pcm, st->out + (size_t)st->out_read * st->channels, sizeof(float) * frames * st->channels);
+
+	//output runs 'tempo' times faster than the media
+	*clock = st->out_clock + (double)st->out_read * st->out_tempo / st->samplerate;
+	st->out_read += frames;
+	return frames * frame_bytes;
+}
+
+bool stretch_drain(TimeStretch *st)
+{
+	int pad;
+
+	if (!st->draining) {
+		if (!st->in_frames)
+			return false;
+
+		//silence after the end, so the last segments can be cut
+		st->draining = true;
+		st->drain_end = st->in_frames;
+		pad = st->window + 2 * st->seek + st->hop;
+		stretch_reserve(st, st->in_frames + pad);
+		memset(st->in + (size_t)st->in_frames * st->channels, 0, sizeof(float) * pad * st->channels);
+		memset(st->mono + st->in_frames, 0, sizeof(float) * pad);
+		st->in_frames += pad;
+	}
+	return st->out_read < st->out_frames || (int)(st->in_pos + 0.5) < st->drain_end;
+}
+
+size_t stretch_bytes(const TimeStretch *st)
+{
+	if (!st->hann)
+		return 0;
+
+	//hann & ola: a window, out: a hop, in & mono: what was reserved
+	return sizeof(float) * ((size_t)2 * st->window * st->channels + (size_t)st->hop * st->channels
+		+ (size_t)st->in_capacity * (st->channels + 1))
+		+ sizeof(double) * (2 * st->seek + 1);
+}
+
+size_t stretch_bytes_for(int samplerate, int channels)
+{
+	int hop = samplerate * STRETCH_WINDOW_MS / 2000;
+	int window = hop * 2, seek = samplerate * STRETCH_SEEK_MS / 1000;
+	int in = window + 2 * seek + hop;
+
+	//like stretch_bytes() with 'in' reserved
+	return sizeof(float) * ((size_t)2 * window * channels + (size_t)hop * channels + (size_t)in * (channels + 1))
+		+ sizeof(double) * (2 * seek + 1);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "c99defs.h"
+#include "sample_conv.h"
+
+#define STRETCH_TEMPO_MIN 0.5f
+#define STRETCH_TEMPO_MAX 2.0f
+
+//tempo change without pitch change (WSOLA) of interleaved mono/stereo PCM, see stretch.c
+typedef struct TimeStretch{
+	const SampleKernels *kernels;
+	int samplerate;
+	int channels;
+	bool s16;			//PCM in & out is s16, float otherwise (always processed as float)
+
+	int window;			//segment length (frames)
+	int hop;			//output hop: window / 2
+	int seek;			//search radius around the nominal position (frames)
+	float *hann;		//window, interleaved like the PCM
+	float *ola;			//overlap-add of the last two segments, 'window' frames
+	double *energy;		//search scratch: energy of every candidate
+
+	float *in;			//input not consumed yet (float)
+	float *mono;		//the same downmixed: what the search correlates
+	int in_frames;
+	int in_capacity;
+	double in_clock;	//pts of in[0] (in sec)
+	double in_pos;		//nominal position of the next segment (frames into 'in')
+	int prev;			//start of the last segment taken (may be before in[0], only its second half is kept)
+	bool started;		//a segment was taken since the reset
+	bool draining;		//end of stream: silence appended to 'in'
+	int drain_end;		//draining: frames of real input in 'in'
+
+	float *out;			//finished output, 'hop' frames at most
+	int out_frames;
+	int out_read;
+	double out_clock;	//pts of out[0]
+	float out_tempo;	//tempo out[] was made at
+}TimeStretch;
+
+int stretch_init(TimeStretch *st, int samplerate, int channels, bool s16);
+void stretch_free(TimeStretch *st);
+void stretch_reset(TimeStretch *st);
+
+/** append 'size' bytes of PCM starting at pts 'clock' */
+void stretch_write(TimeStretch *st, const uint8_t *pcm, int size, double clock);
+
+/** take up to 'size' bytes of stretched PCM, 0 if more input is needed. 'clock': pts of the first byte */
+int stretch_read(TimeStretch *st, uint8_t *pcm, int size, float tempo, double *clock);
+
+/** no more input (end of stream): flush what's left through stretch_read(), false once all is out */
+bool stretch_drain(TimeStretch *st);
+
+/** bytes allocated, 0 before stretch_init() */
+size_t stretch_bytes(const TimeStretch *st);
+
+/** bytes a stretcher for that format takes running: its windows & the input one hop needs at least */
+size_t stretch_bytes_for(int samplerate, int channels);
@@ -0,0 +1,403 @@
+#include "c99defs.h"
+
+#include <SDL.h>
+
+#include "audio.h"
+#include "tap.h"
+#include "resample.h"
+#include "sample_conv.h"
+#include "silly_player_internal.h"
+#include "silly_player.h"
+
+#include "util/bmem.h"
+#include "util/darray.h"
+#include "util/platform.h"
+
+#define TAP_BUFFER_MS 1000 //default audio a tap holds before new samples are dropped
+
+//one subscriber: float PCM in the format of its group, tap thread -> subscriber
+struct silly_tap {
+	VideoState *player;
+	struct tap_group *group;
+	struct silly_tap *next;		//in the group
+
+	AudioRing ring;
+	os_event_t *event;			//signaled by the tap thread while the subscriber waits for data
+	volatile bool waiting;
+	volatile long dropped;		//samples (per channel) that did not fit in the ring
+};
+
+//subscribers asking for the same format share one conversion
+struct tap_group {
+	int channels;				//SA_CH_LAYOUT_*
+	int samplerate;
+
+	//device format 'resampler' was built for
+	int64_t in_channel_layout;
+	int in_format;
+	int in_samplerate;
+	Resampler *resampler;		//NULL while 'conv' does it (nothing to resample)
+	SampleConv conv;
+	DARRAY(float) out;			//conversion result, handed to every tap of the group
+
+	struct silly_tap *taps;
+	struct tap_group *next;
+};
+
+static inline int tap_channels(int layout)
+{
+	return SA_CH_LAYOUT_CHANNELS(layout);
+}
+
+//create the locks, the tap thread is only started by the first tap
+int tap_init(VideoState *is)
+{
+	pthread_mutex_init_value(&is->tap_mutex);
+	if (pthread_mutex_init(&is->tap_mutex, NULL) != 0)
+		return -1;
+	if (os_event_init(&is->tap_event, OS_EVENT_TYPE_AUTO) != 0) {
+		pthread_mutex_destroy(&is->tap_mutex);
+		return -1;
+	}
+	return 0;
+}
+
+//hand 'size' bytes to a tap, never waits: what doesn't fit is dropped
+static void tap_push(struct silly_tap *tap, const uint8_t *data, size_t size, size_t frame_bytes)
+{
+	size_t room = audio_ring_avail(&tap->ring);
+
+	room -= room % frame_bytes;
+	if (size > room) {
+		os_atomic_add_long(&tap->dropped, (long)((size - room) / frame_bytes));
+		size = room;
+	}
+	if (size)
+		audio_ring_write(&tap->ring, data, size);
+
+	if (os_atomic_load_bool(&tap->waiting))
+		os_event_signal(tap->event);
+}
+
+//convert 'in_frames' frames of device PCM once, then fan the result out to every tap of the group.
+//the device PCM is the only conversion before: the decoder converts to the device format at the rate
+//of the file (sample_conv.c kernels) unless the device took another rate, so this is the one resampling
+//stage, and it streams (its phase carries over from one block to the next: nothing drifts)
+static int tap_group_convert(VideoState *is, struct tap_group *group, const uint8_t *in, int in_frames)
+{
+	int64_t in_channel_layout = sa_av_channel_layout(is->audiospec.channels);
+	int in_format = is->audiospec.format == SA_SAMPLE_FMT_S16 ? AV_SAMPLE_FMT_S16 : AV_SAMPLE_FMT_FLT;
+	int in_samplerate = is->audiospec.samplerate;
+	size_t frame_bytes = tap_channels(group->channels) * sizeof(float);
+	const uint8_t *out;
+	uint8_t *out_buf;
+	int out_frames;
+	struct silly_tap *tap;
+
+	if (group->in_channel_layout != in_channel_layout
+		|| group->in_format != in_format
+		|| group->in_samplerate != in_samplerate) {
+		resampler_free(&group->resampler);
+		group->in_channel_layout = in_channel_layout;
+		group->in_format = in_format;
+		group->in_samplerate = in_samplerate;
+
+		if (!sample_conv_setup(&group->conv,
+				in_format, in_channel_layout, in_samplerate,
+				AV_SAMPLE_FMT_FLT, sa_av_channel_layout(group->channels), group->samplerate)) {
+			group->resampler = resampler_open(is->resample_quality,
+				sa_av_channel_layout(group->channels),	//out_ch_layout
+				AV_SAMPLE_FMT_FLT,		//out_sample_fmt
+				group->samplerate,		//out_sample_rate
+				in_channel_layout,		//in_ch_layout
+				in_format,				//in_sample_fmt
+				in_samplerate			//in_sample_rate
+				);
+			if (!group->resampler) {
+				fprintf(stderr, "tap: could not create the converter.\n");
+				group->in_samplerate = 0; //try again next time
+				return -1;
+			}
+		}
+	}
+
+	if (group->conv.kind == SAMPLE_CONV_COPY) {
+		out = in; //the device plays what the group wants, no conversion at all
+		out_frames = in_frames;
+	} else if (group->resampler) {
+		out_frames = resampler_out_frames(group->resampler, in_frames);
+		da_resize(group->out, (size_t)out_frames * tap_channels(group->channels));
+		out_buf = (uint8_t *)group->out.array;
+		out_frames = resampler_convert(group->resampler, &out_buf, out_frames, &in, in_frames);
+		if (out_frames < 0) {
+			fprintf(stderr, "resampler_convert: error while converting.\n");
+			return -2;
+		}
+		out = out_buf;
+	} else {
+		da_resize(group->out, (size_t)in_frames * tap_channels(group->channels));
+		out_buf = (uint8_t *)group->out.array;
+		sample_conv_run(&group->conv, &out_buf, &in, in_frames);
+		out = out_buf;
+		out_frames = in_frames;
+	}
+
+	for (tap = group->taps; tap; tap = tap->next)
+		tap_push(tap, out, (size_t)out_frames * frame_bytes, frame_bytes);
+
+	return 0;
+}
+
+//the stream jumped (seek/close): drop what is converted but not read yet
+static void tap_flush(VideoState *is)
+{
+	struct tap_group *group;
+	struct silly_tap *tap;
+
+	pthread_mutex_lock(&is->tap_mutex);
+	for (group = is->tap_groups; group; group = group->next) {
+		if (group->resampler)
+			resampler_reset(group->resampler); //drop the samples buffered inside
+		for (tap = group->taps; tap; tap = tap->next)
+			audio_ring_discard(&tap->ring);
+	}
+	pthread_mutex_unlock(&is->tap_mutex);
+}
+
+//reads what audio_callback() played and converts it for the taps.
+//all the work is done here so that the callback only pays for one ring write,
+//whatever the number of taps and however slow they are.
+static void *tap_thread(void *arg)
+{
+	VideoState *is = (VideoState *)arg;
+	struct tap_group *group;
+	const uint8_t *in;
+	uint8_t split[AUDIO_FRAME_BYTES_MAX];
+	size_t size, frame_bytes;
+
+	os_set_thread_name("silly_audio_tap");
+
+	while (!is->tap_exit) {
+		if (audio_ring_skip_stale(&is->tap_source))
+			tap_flush(is);
+
+		frame_bytes = tap_channels(is->audiospec.channels) * (is->audiospec.format == SA_SAMPLE_FMT_S16 ? 2 : 4);
+		size = audio_ring_peek_frames(&is->tap_source, &in, frame_bytes, split);
+		if (size == 0) {
+			os_atomic_set_bool(&is->tap_waiting, true);
+			if (audio_ring_used(&is->tap_source) < frame_bytes)
+				os_event_timedwait(is->tap_event, 100);
+			os_atomic_set_bool(&is->tap_waiting, false);
+			continue;
+		}
+
+		pthread_mutex_lock(&is->tap_mutex);
+		for (group = is->tap_groups; group; group = group->next)
+			tap_group_convert(is, group, in, (int)(size / frame_bytes));
+		pthread_mutex_unlock(&is->tap_mutex);
+
+		audio_ring_read(&is->tap_source, NULL, size);
+	}
+
+	return NULL;
+}
+
+//start the tap thread (under tap_mutex)
+static int tap_start(VideoState *is)
+{
+	size_t capacity;
+
+	if (is->tap_active)
+		return 0;
+
+	capacity = audio_ring_grant(is, AUDIO_FETCH_RING_SIZE, AUDIO_RING_MIN);
+	if (!capacity || audio_ring_init(&is->tap_source, capacity) != 0)
+		return -1;
+	os_event_reset(is->tap_event);
+	is->tap_exit = false;
+	if (pthread_create(&is->tap_thread, NULL, tap_thread, is) != 0) {
+		fprintf(stderr, "tap: could not create the tap thread.\n");
+		audio_ring_free(&is->tap_source);
+		return -2;
+	}
+	os_atomic_add_long(&is->tap_bytes, (long)is->tap_source.capacity);
+	is->tap_active = true;
+	return 0;
+}
+
+static void tap_group_free(struct tap_group *group)
+{
+	resampler_free(&group->resampler);
+	da_free(group->out);
+	bfree(group);
+}
+
+static void tap_destroy(struct silly_tap *tap)
+{
+	os_atomic_add_long(&tap->player->tap_bytes, -(long)tap->ring.capacity);
+	audio_ring_free(&tap->ring);
+	os_event_destroy(tap->event);
+	bfree(tap);
+}
+
+//stop the tap thread and free the taps left open (the device is closed already)
+void tap_free(VideoState *is)
+{
+	struct tap_group *group;
+	struct silly_tap *tap;
+
+	if (is->tap_active) {
+		is->tap_exit = true;
+		os_event_signal(is->tap_event);
+		pthread_join(is->tap_thread, NULL);
+		is->tap_active = false;
+		os_atomic_add_long(&is->tap_bytes, -(long)is->tap_source.capacity);
+		audio_ring_free(&is->tap_source);
+	}
+
+	while ((group = is->tap_groups)) {
+		is->tap_groups = group->next;
+		while ((tap = group->taps)) {
+			group->taps = tap->next;
+			fprintf(stderr, "tap: still open while the player is destroyed.\n");
+			tap_destroy(tap);
+		}
+		tap_group_free(group);
+	}
+	is->tap_count = 0;
+
+	os_event_destroy(is->tap_event);
+	pthread_mutex_destroy(&is->tap_mutex);
+}
+
+//subscribe to the audio being played. each tap has its own ring, so any number of them
+//can read at their own pace; taps asking for the same format share one conversion.
+//@param[in] channels: SA_CH_LAYOUT_MONO / SA_CH_LAYOUT_STEREO
+//@param[in] samplerate: samplerate required
+//@param[in] buffer_ms: audio the tap holds before new samples are dropped (<= 0: 1 sec)
+//return the tap, NULL on error
+silly_tap_t *silly_player_tap_open(silly_player_t *is, int channels, int samplerate, int buffer_ms)
+{
+	struct silly_tap *tap;
+	struct tap_group *group;
+	size_t capacity;
+
+	if (!is || samplerate <= 0) return NULL;
+	if (channels != SA_CH_LAYOUT_MONO && channels != SA_CH_LAYOUT_STEREO) return NULL;
+	if (buffer_ms <= 0) buffer_ms = TAP_BUFFER_MS;
+
+	tap = bzalloc(sizeof(struct silly_tap));
+	tap->player = is;
+	capacity = (size_t)samplerate * buffer_ms / 1000 * tap_channels(channels) * sizeof(float);
+	capacity = audio_ring_grant(is, capacity, min(capacity, AUDIO_RING_MIN)); //a memory budget shortens it
+	if (!capacity || audio_ring_init(&tap->ring, capacity) != 0
+		|| os_event_init(&tap->event, OS_EVENT_TYPE_AUTO) != 0) {
+		audio_ring_free(&tap->ring);
+		bfree(tap);
+		return NULL;
+	}
+	os_atomic_add_long(&is->tap_bytes, (long)tap->ring.capacity);
+
+	pthread_mutex_lock(&is->tap_mutex);
+	if (tap_start(is) != 0) {
+		pthread_mutex_unlock(&is->tap_mutex);
+		tap_destroy(tap);
+		return NULL;
+	}
+
+	for (group = is->tap_groups; group; group = group->next) {
+		if (group->channels == channels && group->samplerate == samplerate)
+			break;
+	}
+	if (!group) {
+		group = bzalloc(sizeof(struct tap_group));
+		group->channels = channels;
+		group->samplerate = samplerate;
+		group->next = is->tap_groups;
+		is->tap_groups = group;
+	}
+
+	tap->group = group;
+	tap->next = group->taps;
+	group->taps = tap;
+	os_atomic_inc_long(&is->tap_count); //audio_callback() starts feeding the tap thread
+	pthread_mutex_unlock(&is->tap_mutex);
+
+	return tap;
+}
+
+//fill sample_buffer with audio samples in the format of the tap
+//@param[in] sample_buffer: buffer to be filled
+//@param[in] sample_buffer_size: size (# of floats) of buffer to be filled
+//@param[in] blocking: wait until the buffer can be filled
+//return 0 on success, negative on error (see silly_player_fetch())
+int silly_tap_read(silly_tap_t *tap, float *sample_buffer, int sample_buffer_size, bool blocking)
+{
+	VideoState *is;
+	size_t bytes;
+
+	if (!tap || !sample_buffer) return -1;
+	memset(sample_buffer, 0, sample_buffer_size * sizeof(float));
+
+	is = tap->player;
+	bytes = (size_t)(sample_buffer_size - sample_buffer_size % tap_channels(tap->group->channels)) * sizeof(float);
+	if (bytes > tap->ring.capacity) return -13;
+
+	for (;;) {
+		audio_ring_skip_stale(&tap->ring); //seek/close: see tap_flush()
+		if (audio_ring_used(&tap->ring) >= bytes)
+			break;
+
+		if (!blocking) return -5;
+		if (!is->active || is->exit_parse) return -6;
+		if (is->pause_on) return -7;
+
+		os_atomic_set_bool(&tap->waiting, true);
+		if (audio_ring_used(&tap->ring) < bytes)
+			os_event_timedwait(tap->event, 100); //the timeout covers pause/close
+		os_atomic_set_bool(&tap->waiting, false);
+	}
+
+	audio_ring_read(&tap->ring, sample_buffer, bytes);
+	return 0;
+}
+
+//samples (per channel) dropped so far because the tap was not read fast enough
+long silly_tap_dropped(silly_tap_t *tap)
+{
+	return tap ? os_atomic_load_long(&tap->dropped) : 0;
+}
+
+//unsubscribe, the tap must not be read concurrently
+void silly_tap_close(silly_tap_t *tap)
+{
+	VideoState *is;
+	struct tap_group *group, **pgroup;
+	struct silly_tap **ptap;
+
+	if (!tap) return;
+
+	is = tap->player;
+	group = tap->group;
+
+	pthread_mutex_lock(&is->tap_mutex);
+	for (ptap = &group->taps; *ptap; ptap = &(*ptap)->next) {
+		if (*ptap == tap) {
+			*ptap = tap->next;
+			break;
+		}
+	}
+	if (!group->taps) { //last one of its format
+		for (pgroup = &is->tap_groups; *pgroup; pgroup = &(*pgroup)->next) {
+			if (*pgroup == group) {
+				*pgroup = group->next;
+				break;
+			}
+		}
+		tap_group_free(group);
+	}
+	os_atomic_dec_long(&is->tap_count);
+	pthread_mutex_unlock(&is->tap_mutex);
+
+	tap_destroy(tap);
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include "silly_player_internal.h"
+
+int tap_init(VideoState *is);
+void tap_free(VideoState *is);
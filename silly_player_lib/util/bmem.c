@@ -89,6 +89,7 @@ static void a_free(void *ptr)
 
 static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
 static long num_allocs = 0;
+static long num_total_allocs = 0;
 
 void base_set_allocator(struct base_allocator *defs)
 {
@@ -107,6 +108,7 @@ void *bmalloc(size_t size)
 	}
 
 	os_atomic_inc_long(&num_allocs);
+	os_atomic_inc_long(&num_total_allocs);
 	return ptr;
 }
 
@@ -114,6 +116,7 @@ void *brealloc(void *ptr, size_t size)
 {
 	if (!ptr)
 		os_atomic_inc_long(&num_allocs);
+	os_atomic_inc_long(&num_total_allocs);
 
 	ptr = alloc.realloc(ptr, size);
 	if (!ptr && !size)
@@ -139,6 +142,11 @@ long bnum_allocs(void)
 	return num_allocs;
 }
 
+long bnum_total_allocs(void)
+{
+	return num_total_allocs;
+}
+
 int base_get_alignment(void)
 {
 	return ALIGNMENT;
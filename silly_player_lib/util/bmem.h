@@ -40,6 +40,7 @@ EXPORT void bfree(void *ptr);
 EXPORT int base_get_alignment(void);
 
 EXPORT long bnum_allocs(void);
+EXPORT long bnum_total_allocs(void);
 
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
@@ -18,6 +18,8 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <sys/statvfs.h>
 #include <dirent.h>
 #include <stdlib.h>
@@ -346,6 +348,47 @@ int64_t os_get_free_space(const char *path)
 	return ret;
 }
 
+struct os_mmap {
+	void *addr;
+	size_t size;
+};
+
+os_mmap_t *os_mmap_open(const char *path, const uint8_t **data, size_t *size)
+{
+	struct os_mmap *map;
+	struct stat st;
+	void *addr;
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1)
+		return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); /* the mapping keeps the file */
+	if (addr == MAP_FAILED)
+		return NULL;
+
+	map = bmalloc(sizeof(struct os_mmap));
+	map->addr = addr;
+	map->size = (size_t)st.st_size;
+	*data = addr;
+	*size = map->size;
+	return map;
+}
+
+void os_mmap_close(os_mmap_t *map)
+{
+	if (!map)
+		return;
+
+	munmap(map->addr, map->size);
+	bfree(map);
+}
+
 struct posix_glob_info {
 	struct os_glob_info base;
 	glob_t gl;
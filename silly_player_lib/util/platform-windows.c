@@ -419,6 +419,63 @@ int64_t os_get_free_space(const char *path)
 	return -1;
 }
 
+struct os_mmap {
+	HANDLE file;
+	HANDLE mapping;
+	void *view;
+};
+
+os_mmap_t *os_mmap_open(const char *path, const uint8_t **data, size_t *size)
+{
+	struct os_mmap *map = bzalloc(sizeof(struct os_mmap));
+	LARGE_INTEGER file_size;
+	wchar_t *w_path;
+
+	if (!os_utf8_to_wcs_ptr(path, 0, &w_path))
+		goto fail;
+	map->file = CreateFileW(w_path, GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(w_path);
+	if (map->file == INVALID_HANDLE_VALUE) {
+		map->file = NULL;
+		goto fail;
+	}
+
+	if (!GetFileSizeEx(map->file, &file_size) || file_size.QuadPart <= 0 ||
+	    (uint64_t)file_size.QuadPart > (uint64_t)SIZE_MAX)
+		goto fail;
+
+	map->mapping = CreateFileMappingW(map->file, NULL, PAGE_READONLY,
+			0, 0, NULL);
+	if (!map->mapping)
+		goto fail;
+	map->view = MapViewOfFile(map->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!map->view)
+		goto fail;
+
+	*data = map->view;
+	*size = (size_t)file_size.QuadPart;
+	return map;
+
+fail:
+	os_mmap_close(map);
+	return NULL;
+}
+
+void os_mmap_close(os_mmap_t *map)
+{
+	if (!map)
+		return;
+
+	if (map->view)
+		UnmapViewOfFile(map->view);
+	if (map->mapping)
+		CloseHandle(map->mapping);
+	if (map->file)
+		CloseHandle(map->file);
+	bfree(map);
+}
+
 static void make_globent(struct os_globent *ent, WIN32_FIND_DATA *wfd,
 		const char *pattern)
 {
@@ -62,6 +62,14 @@ EXPORT bool os_quick_write_mbs_file(const char *path, const char *str,
 EXPORT int64_t os_get_file_size(const char *path);
 EXPORT int64_t os_get_free_space(const char *path);
 
+/* read-only mapping of a whole file, NULL on failure (or if it's empty) */
+struct os_mmap;
+typedef struct os_mmap os_mmap_t;
+
+EXPORT os_mmap_t *os_mmap_open(const char *path, const uint8_t **data,
+		size_t *size);
+EXPORT void os_mmap_close(os_mmap_t *map);
+
 EXPORT size_t os_mbs_to_wcs(const char *str, size_t str_len, wchar_t *dst,
 		size_t dst_size);
 EXPORT size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst,
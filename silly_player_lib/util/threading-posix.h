@@ -26,6 +26,11 @@ static inline long os_atomic_dec_long(volatile long *val)
 	return __sync_sub_and_fetch(val, 1);
 }
 
+static inline long os_atomic_add_long(volatile long *val, long n)
+{
+	return __sync_add_and_fetch(val, n);
+}
+
 static inline long os_atomic_set_long(volatile long *ptr, long val)
 {
 	return __sync_lock_test_and_set(ptr, val);
@@ -36,6 +41,11 @@ static inline long os_atomic_load_long(const volatile long *ptr)
 	return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
 }
 
+static inline void os_atomic_thread_fence_acquire(void)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+}
+
 static inline bool os_atomic_compare_swap_long(volatile long *val,
 		long old_val, long new_val)
 {
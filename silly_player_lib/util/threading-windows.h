@@ -28,6 +28,11 @@ static inline long os_atomic_dec_long(volatile long *val)
 	return _InterlockedDecrement(val);
 }
 
+static inline long os_atomic_add_long(volatile long *val, long n)
+{
+	return _InterlockedExchangeAdd(val, n) + n;
+}
+
 static inline long os_atomic_set_long(volatile long *ptr, long val)
 {
 	return (long)_InterlockedExchange((volatile long*)ptr, (long)val);
@@ -38,6 +43,12 @@ static inline long os_atomic_load_long(const volatile long *ptr)
 	return (long)_InterlockedOr((volatile long*)ptr, 0);
 }
 
+static inline void os_atomic_thread_fence_acquire(void)
+{
+	volatile long fence = 0;
+	_InterlockedOr(&fence, 0); /* interlocked ops are full barriers */
+}
+
 static inline bool os_atomic_compare_swap_long(volatile long *val,
 		long old_val, long new_val)
 {
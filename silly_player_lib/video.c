@@ -12,8 +12,6 @@
 
 #include "video.h"
 
-extern int global_exit;
-
 static SDL_Window *sdlWin;
 static SDL_mutex *sdlWinMutex;
 
@@ -60,12 +58,12 @@ static int queue_picture(VideoState *is, AVFrame *pFrame, double pts){
 
     //wait for finishing displaying the last frame
     SDL_LockMutex(is->pictq_mutex);
-    while(is->pictq_size >= 1 && !global_exit){
+    while(is->pictq_size >= 1 && !is->exit){
         SDL_CondWait(is->pictq_cond, is->pictq_mutex);
     }
     SDL_UnlockMutex(is->pictq_mutex);
 
-    if(global_exit) return -1;
+    if(is->exit) return -1;
 
     //allocate space for "YUV image" on demand
     vp = &is->pictq;
@@ -81,7 +79,7 @@ static int queue_picture(VideoState *is, AVFrame *pFrame, double pts){
         vp->allocated = 1;
     }
 
-    if(global_exit) return -1;
+    if(is->exit) return -1;
 
     //conversion: video frame --> YUV image
     if(vp->pFrameYUV){
@@ -111,9 +109,9 @@ int video_thread(void *arg)
 
     for(;;)
     {
-        if(packet_queue_get(&is->videoq, packet, 1) < 0)
+        if(packet_queue_get(&is->videoq, packet, 1, NULL) < 0)
             break; //means quitting getting packets
-        if(global_exit)
+        if(is->exit)
             break;
         pts = 0;
 
@@ -0,0 +1,489 @@
+#include <math.h>
+#include <sys/stat.h>
+
+#include "c99defs.h"
+
+#include <SDL.h>
+
+#include "silly_player.h"
+
+#include "util/array-serializer.h"
+#include "util/bmem.h"
+#include "util/crc32.h"
+#include "util/darray.h"
+#include "util/dstr.h"
+#include "util/file-serializer.h"
+#include "util/platform.h"
+#include "util/threading.h"
+
+//waveform overview of a whole file: min, max & RMS of its mono downmix for buckets of 256, 1024 &
+//4096 frames. built once by headless players decoding parts of the file in parallel (each seeks to
+//its part, buffers are placed by their pts), then saved next to the file and memory-mapped on the
+//next open: a long file is drawn without decoding it again.
+//cache file, little-endian:
+//	u32 magic, u32 version, i64 source size, i64 source mtime, u32 samplerate, u32 levels, i64 frames,
+//	levels x { u32 frames per bucket, u32 buckets }, u32 crc32 (of everything else),
+//	then the buckets of every level (3 x i16 each).
+#define WAVEFORM_MAGIC 0x46575053 //"SPWF"
+#define WAVEFORM_VERSION 1
+#define WAVEFORM_BUCKET_FRAMES 256
+#define WAVEFORM_LEVEL_FACTOR 4
+#define WAVEFORM_MIN_SEGMENT 30.0 //sec: shorter parts cost more in seeking than they save
+#define WAVEFORM_HEADER_SIZE (40 + 8 * SILLY_WAVEFORM_LEVELS + 4)
+#define WAVEFORM_CRC_OFFSET (WAVEFORM_HEADER_SIZE - 4)
+
+struct silly_waveform {
+	silly_waveform_info info;
+	const silly_waveform_bucket *level[SILLY_WAVEFORM_LEVELS];
+
+	os_mmap_t *map;			//cache file mapped...
+	uint8_t *data;			//... or our own copy of it (could not be written / mapped)
+};
+
+//a bucket being measured
+struct waveform_acc {
+	float min, max;
+	double sum;				//of squares
+	int count;				//frames
+};
+
+//one part of the file, decoded by its own player
+struct waveform_segment {
+	silly_player_t *player;
+	const char *filename;
+	int sec;				//seeked to
+	int64_t begin;			//first frame measured, a multiple of WAVEFORM_BUCKET_FRAMES
+	int64_t end;			//frame after the last, -1: to the end of the file
+	int64_t next;			//next frame expected
+	int samplerate;
+	int status;
+	DARRAY(struct waveform_acc) acc; //buckets from 'begin'
+	pthread_t thread;
+	bool thread_created;
+};
+
+static inline void waveform_acc_merge(struct waveform_acc *dst, const struct waveform_acc *src)
+{
+	if (!src->count)
+		return;
+	if (!dst->count) {
+		*dst = *src;
+		return;
+	}
+	dst->min = min(dst->min, src->min);
+	dst->max = max(dst->max, src->max);
+	dst->sum += src->sum;
+	dst->count += src->count;
+}
+
+static int waveform_on_pcm(void *userdata, const uint8_t *pcm, int size)
+{
+	struct waveform_segment *seg = (struct waveform_segment *)userdata;
+	const float *samples = (const float *)pcm;
+	int frames = size / (int)sizeof(float);
+	int64_t frame = (int64_t)floor(silly_player_time(seg->player) * seg->samplerate + 0.5);
+	struct waveform_acc *acc;
+	size_t bucket;
+	int i;
+
+	//before the seek landed / before our part (seeks land on a keyframe, maybe early)
+	if (frame + frames <= seg->next || frame + frames <= seg->begin)
+		return 0;
+
+	for (i = 0; i < frames; ++i, ++frame) {
+		if (frame < seg->next || frame < seg->begin)
+			continue;
+		if (seg->end >= 0 && frame >= seg->end)
+			return 1; //the next part takes it from here
+
+		bucket = (size_t)((frame - seg->begin) / WAVEFORM_BUCKET_FRAMES);
+		if (bucket >= seg->acc.num) {
+			size_t old = seg->acc.num;
+			da_resize(seg->acc, bucket + 1);
+			memset(seg->acc.array + old, 0, sizeof(struct waveform_acc) * (seg->acc.num - old));
+		}
+
+		acc = seg->acc.array + bucket;
+		if (!acc->count) {
+			acc->min = samples[i];
+			acc->max = samples[i];
+		} else {
+			acc->min = min(acc->min, samples[i]);
+			acc->max = max(acc->max, samples[i]);
+		}
+		acc->sum += (double)samples[i] * samples[i];
+		++acc->count;
+		seg->next = frame + 1;
+	}
+	return 0;
+}
+
+static void *waveform_segment_thread(void *arg)
+{
+	struct waveform_segment *seg = (struct waveform_segment *)arg;
+	silly_audiospec desired, obtained;
+
+	os_set_thread_name("silly_waveform_segment");
+
+	desired.channels = SA_CH_LAYOUT_MONO;
+	desired.format = SA_SAMPLE_FMT_FLT;
+	desired.samplerate = seg->samplerate;
+	desired.samples = 0;
+
+	//segment 0 arrives opened (the probe)
+	if (!seg->player) {
+		seg->player = silly_player_create();
+		if (!seg->player) {
+			seg->status = -1;
+			return NULL;
+		}
+		if ((seg->status = silly_player_open_headless(seg->player, seg->filename, &desired, &obtained)) != 0)
+			return NULL;
+	}
+
+	if (seg->sec > 0 && (seg->status = silly_player_seek(seg->player, seg->sec)) != 0)
+		return NULL;
+
+	seg->status = silly_player_decode(seg->player, waveform_on_pcm, seg);
+	if (seg->status == 1)
+		seg->status = 0;
+	silly_player_close(seg->player);
+	return NULL;
+}
+
+static inline int16_t waveform_s16(double v)
+{
+	v = v * 32767.0;
+	v = v < -32767.0 ? -32767.0 : (v > 32767.0 ? 32767.0 : v);
+	return (int16_t)floor(v + 0.5);
+}
+
+static inline silly_waveform_bucket waveform_bucket(const struct waveform_acc *acc)
+{
+	silly_waveform_bucket b = { 0, 0, 0 };
+
+	if (acc->count) {
+		b.min = waveform_s16(acc->min);
+		b.max = waveform_s16(acc->max);
+		b.rms = waveform_s16(sqrt(acc->sum / acc->count));
+	}
+	return b;
+}
+
+//serialize the pyramid of 'acc' (level 0 buckets) in the cache file format
+static void waveform_write(struct serializer *s, struct waveform_acc *acc, size_t buckets,
+	const struct stat *source, int samplerate, int64_t frames)
+{
+	size_t count[SILLY_WAVEFORM_LEVELS];
+	size_t i, j, n;
+	int level;
+
+	count[0] = buckets;
+	for (level = 1; level < SILLY_WAVEFORM_LEVELS; ++level)
+		count[level] = (count[level - 1] + WAVEFORM_LEVEL_FACTOR - 1) / WAVEFORM_LEVEL_FACTOR;
+
+	s_wl32(s, WAVEFORM_MAGIC);
+	s_wl32(s, WAVEFORM_VERSION);
+	s_wl64(s, (uint64_t)source->st_size);
+	s_wl64(s, (uint64_t)source->st_mtime);
+	s_wl32(s, (uint32_t)samplerate);
+	s_wl32(s, SILLY_WAVEFORM_LEVELS);
+	s_wl64(s, (uint64_t)frames);
+	for (level = 0, n = WAVEFORM_BUCKET_FRAMES; level < SILLY_WAVEFORM_LEVELS; ++level, n *= WAVEFORM_LEVEL_FACTOR) {
+		s_wl32(s, (uint32_t)n);
+		s_wl32(s, (uint32_t)count[level]);
+	}
+	s_wl32(s, 0); //crc: patched once everything is written
+
+	//every level is made of the one below, merged in place
+	for (level = 0; level < SILLY_WAVEFORM_LEVELS; ++level) {
+		if (level > 0) {
+			for (i = 0; i < count[level]; ++i) {
+				struct waveform_acc merged = acc[i * WAVEFORM_LEVEL_FACTOR];
+				for (j = 1; j < WAVEFORM_LEVEL_FACTOR && i * WAVEFORM_LEVEL_FACTOR + j < count[level - 1]; ++j)
+					waveform_acc_merge(&merged, &acc[i * WAVEFORM_LEVEL_FACTOR + j]);
+				acc[i] = merged;
+			}
+		}
+		for (i = 0; i < count[level]; ++i) {
+			silly_waveform_bucket b = waveform_bucket(&acc[i]);
+			s_wl16(s, (uint16_t)b.min);
+			s_wl16(s, (uint16_t)b.max);
+			s_wl16(s, (uint16_t)b.rms);
+		}
+	}
+}
+
+static inline uint32_t waveform_rl32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline int64_t waveform_rl64(const uint8_t *p)
+{
+	return (int64_t)((uint64_t)waveform_rl32(p) | ((uint64_t)waveform_rl32(p + 4) << 32));
+}
+
+//check a cache file & point the levels into it
+//return 0 if it is good (and made of this very source), negative otherwise
+static int waveform_parse(silly_waveform_t *wf, const uint8_t *data, size_t size, const struct stat *source)
+{
+	size_t offset = WAVEFORM_HEADER_SIZE;
+	uint32_t crc;
+	int level;
+
+	if (size < WAVEFORM_HEADER_SIZE)
+		return -1;
+	if (waveform_rl32(data) != WAVEFORM_MAGIC || waveform_rl32(data + 4) != WAVEFORM_VERSION)
+		return -2;
+	if (waveform_rl64(data + 8) != (int64_t)source->st_size || waveform_rl64(data + 16) != (int64_t)source->st_mtime)
+		return -3; //the file changed since
+	if (waveform_rl32(data + 28) != SILLY_WAVEFORM_LEVELS)
+		return -4;
+
+	wf->info.samplerate = (int)waveform_rl32(data + 24);
+	wf->info.frames = waveform_rl64(data + 32);
+	wf->info.levels = SILLY_WAVEFORM_LEVELS;
+	for (level = 0; level < SILLY_WAVEFORM_LEVELS; ++level) {
+		wf->info.frames_per_bucket[level] = (int)waveform_rl32(data + 40 + 8 * level);
+		wf->info.buckets[level] = (int)waveform_rl32(data + 44 + 8 * level);
+		if (wf->info.frames_per_bucket[level] != WAVEFORM_BUCKET_FRAMES << (2 * level)
+			|| wf->info.buckets[level] < 0 || (size - offset) / sizeof(silly_waveform_bucket) < (size_t)wf->info.buckets[level])
+			return -5;
+		wf->level[level] = (const silly_waveform_bucket *)(data + offset);
+		offset += sizeof(silly_waveform_bucket) * wf->info.buckets[level];
+	}
+	if (offset != size)
+		return -5;
+
+	crc = calc_crc32(0, data, WAVEFORM_CRC_OFFSET);
+	crc = calc_crc32(crc, data + WAVEFORM_HEADER_SIZE, size - WAVEFORM_HEADER_SIZE);
+	if (crc != waveform_rl32(data + WAVEFORM_CRC_OFFSET))
+		return -6;
+
+	return 0;
+}
+
+//map the cache file, false if there is none or it doesn't fit the source
+static bool waveform_load(silly_waveform_t *wf, const char *cache_path, const struct stat *source)
+{
+	const uint8_t *data;
+	size_t size;
+
+	wf->map = os_mmap_open(cache_path, &data, &size);
+	if (!wf->map)
+		return false;
+
+	if (waveform_parse(wf, data, size, source) != 0) {
+		os_mmap_close(wf->map);
+		wf->map = NULL;
+		return false;
+	}
+	wf->info.cached = 1;
+	return true;
+}
+
+//decode the file in parallel parts, then save the pyramid to 'cache_path' & map it
+static int waveform_build(silly_waveform_t *wf, const char *filename, const char *cache_path,
+	const struct stat *source, int threads)
+{
+	struct waveform_segment *segs = NULL;
+	silly_player_t *probe;
+	silly_audiospec desired, obtained;
+	struct array_output_data out;
+	struct serializer s;
+	DARRAY(struct waveform_acc) acc;
+	uint64_t start = os_gettime_ns();
+	int64_t frames = 0, first;
+	double duration;
+	size_t i, j;
+	int nb_segs, samplerate, ret = 0;
+	uint32_t crc;
+
+	//the probe tells the samplerate & duration, then decodes the first part
+	probe = silly_player_create();
+	if (!probe)
+		return -1;
+	desired.channels = SA_CH_LAYOUT_MONO;
+	desired.format = SA_SAMPLE_FMT_FLT;
+	desired.samplerate = 0; //as decoded
+	desired.samples = 0;
+	if (silly_player_open_headless(probe, filename, &desired, &obtained) != 0) {
+		silly_player_destroy(probe);
+		return -2;
+	}
+	samplerate = obtained.samplerate;
+	duration = silly_player_duration(probe);
+
+	nb_segs = duration > 0.0 ? (int)min((double)threads, duration / WAVEFORM_MIN_SEGMENT) : 1;
+	if (nb_segs < 1)
+		nb_segs = 1;
+
+	//parts start on a whole second (what silly_player_seek() takes) rounded up to a bucket
+	segs = bzalloc(sizeof(struct waveform_segment) * nb_segs);
+	for (i = 0; i < (size_t)nb_segs; ++i) {
+		segs[i].filename = filename;
+		segs[i].samplerate = samplerate;
+		segs[i].sec = (int)(duration * i / nb_segs);
+		segs[i].begin = ((int64_t)segs[i].sec * samplerate + WAVEFORM_BUCKET_FRAMES - 1)
+			/ WAVEFORM_BUCKET_FRAMES * WAVEFORM_BUCKET_FRAMES;
+		segs[i].next = segs[i].begin;
+		segs[i].end = -1;
+		da_init(segs[i].acc);
+		if (i > 0)
+			segs[i - 1].end = segs[i].begin;
+	}
+	segs[0].player = probe;
+
+	for (i = 1; i < (size_t)nb_segs; ++i) {
+		if (pthread_create(&segs[i].thread, NULL, waveform_segment_thread, &segs[i]) == 0)
+			segs[i].thread_created = true;
+		else
+			segs[i].status = -3;
+	}
+	waveform_segment_thread(&segs[0]);
+	for (i = 1; i < (size_t)nb_segs; ++i) {
+		if (segs[i].thread_created)
+			pthread_join(segs[i].thread, NULL);
+	}
+
+	//all of them or nothing: a hole in the overview would look like silence
+	for (i = 0; i < (size_t)nb_segs; ++i) {
+		if (segs[i].status < 0) {
+			fprintf(stderr, "silly_waveform: part %d of %s failed (%d).\n", (int)i, filename, segs[i].status);
+			ret = -4;
+		}
+		frames = max(frames, segs[i].next);
+	}
+
+	da_init(acc);
+	if (ret == 0 && frames > 0) {
+		da_resize(acc, (size_t)((frames + WAVEFORM_BUCKET_FRAMES - 1) / WAVEFORM_BUCKET_FRAMES));
+		memset(acc.array, 0, sizeof(struct waveform_acc) * acc.num);
+		for (i = 0; i < (size_t)nb_segs; ++i) {
+			first = segs[i].begin / WAVEFORM_BUCKET_FRAMES;
+			for (j = 0; j < segs[i].acc.num && first + j < acc.num; ++j)
+				waveform_acc_merge(&acc.array[first + j], &segs[i].acc.array[j]);
+		}
+	} else if (ret == 0) {
+		ret = -5; //nothing decoded
+	}
+
+	for (i = 0; i < (size_t)nb_segs; ++i) {
+		silly_player_destroy(segs[i].player);
+		da_free(segs[i].acc);
+	}
+	bfree(segs);
+
+	if (ret != 0) {
+		da_free(acc);
+		return ret;
+	}
+
+	array_output_serializer_init(&s, &out);
+	waveform_write(&s, acc.array, acc.num, source, samplerate, frames);
+	da_free(acc);
+
+	crc = calc_crc32(0, out.bytes.array, WAVEFORM_CRC_OFFSET);
+	crc = calc_crc32(crc, out.bytes.array + WAVEFORM_HEADER_SIZE, out.bytes.num - WAVEFORM_HEADER_SIZE);
+	out.bytes.array[WAVEFORM_CRC_OFFSET] = (uint8_t)crc;
+	out.bytes.array[WAVEFORM_CRC_OFFSET + 1] = (uint8_t)(crc >> 8);
+	out.bytes.array[WAVEFORM_CRC_OFFSET + 2] = (uint8_t)(crc >> 16);
+	out.bytes.array[WAVEFORM_CRC_OFFSET + 3] = (uint8_t)(crc >> 24);
+
+	//written aside then renamed: a reader never maps half a file
+	if (file_output_serializer_init_safe(&s, cache_path, "tmp")) {
+		bool written = s_write(&s, out.bytes.array, out.bytes.num) == out.bytes.num;
+		file_output_serializer_free(&s);
+		if (written && waveform_load(wf, cache_path, source)) {
+			wf->info.cached = 0;
+			array_output_serializer_free(&out);
+			goto done;
+		}
+	}
+
+	//no cache (read-only directory...): serve our copy
+	fprintf(stderr, "silly_waveform: could not write %s, the overview is not cached.\n", cache_path);
+	wf->data = out.bytes.array; //taken over, freed by silly_waveform_close()
+	if (waveform_parse(wf, wf->data, out.bytes.num, source) != 0)
+		return -6;
+
+done:
+	wf->info.segments = nb_segs;
+	wf->info.build_time = (double)(os_gettime_ns() - start) / 1000000000.0;
+	return 0;
+}
+
+//get the waveform overview of a file: mapped from its cache file if that is up to date,
+//otherwise decoded (in parallel parts) and cached
+//@param[in] filename: audio file
+//@param[in] cache_path: cache file, NULL: filename + ".waveform"
+//@param[in] threads: parts decoded at once when building, <= 0: one per CPU
+//return the overview, NULL on error
+silly_waveform_t *silly_waveform_open(const char *filename, const char *cache_path, int threads)
+{
+	silly_waveform_t *wf;
+	struct dstr path = { 0 };
+	struct stat source;
+	int ret;
+
+	if (!filename)
+		return NULL;
+	if (os_stat(filename, &source) != 0) {
+		fprintf(stderr, "silly_waveform: %s not found.\n", filename);
+		return NULL;
+	}
+
+	if (cache_path) {
+		dstr_copy(&path, cache_path);
+	} else {
+		dstr_copy(&path, filename);
+		dstr_cat(&path, ".waveform");
+	}
+
+	wf = bzalloc(sizeof(silly_waveform_t));
+	if (!waveform_load(wf, path.array, &source)) {
+		memset(wf, 0, sizeof(silly_waveform_t));
+		ret = waveform_build(wf, filename, path.array, &source, threads > 0 ? threads : SDL_GetCPUCount());
+		if (ret != 0) {
+			fprintf(stderr, "silly_waveform: could not build the overview of %s (%d).\n", filename, ret);
+			silly_waveform_close(wf);
+			wf = NULL;
+		}
+	}
+
+	dstr_free(&path);
+	return wf;
+}
+
+void silly_waveform_close(silly_waveform_t *wf)
+{
+	if (!wf)
+		return;
+
+	os_mmap_close(wf->map);
+	bfree(wf->data);
+	bfree(wf);
+}
+
+void silly_waveform_get_info(silly_waveform_t *wf, silly_waveform_info *info)
+{
+	if (!wf || !info)
+		return;
+
+	*info = wf->info;
+}
+
+//get the buckets of one level
+//@param[in] level: 0 (finest) .. SILLY_WAVEFORM_LEVELS - 1
+//@param[out] buckets: number of buckets
+//return the buckets (valid until silly_waveform_close()), NULL on error
+const silly_waveform_bucket *silly_waveform_level(silly_waveform_t *wf, int level, int *buckets)
+{
+	if (!wf || level < 0 || level >= SILLY_WAVEFORM_LEVELS)
+		return NULL;
+
+	if (buckets)
+		*buckets = wf->info.buckets[level];
+	return wf->level[level];
+}